@@ -0,0 +1,297 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+// Encodes the tiles of a synthetic Bayer frame with the lossless JPEG encoder the way the DNG
+// writer does (two fake channels per tile), once with optimal Huffman tables per tile and once
+// with tables sampled from a few tiles, and reports throughput per core. Every tile is decoded
+// again and compared to its source.
+//
+// Then decodes the whole frame stored as a single strip (as many cameras and phones write it),
+// with and without restart markers, on one thread and on all of them.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dnghost.h"
+#include "threadpool.h"
+
+#include "dng_exceptions.h"
+#include "dng_lossless_jpeg.h"
+#include "dng_memory.h"
+#include "dng_memory_stream.h"
+#include "dng_tag_codes.h"
+
+
+// -----------------------------------------------------------------------------------------
+// 14-bit RGGB frame: smooth gradients, a Bayer pattern and pseudo-random noise of given amplitude
+
+static std::vector<uint16> makeFrame(uint32 width, uint32 height, uint32 noise) {
+    std::vector<uint16> frame(static_cast<size_t>(width) * height);
+    uint32 random = 1;
+
+    for (uint32 row = 0; row < height; row++)
+        for (uint32 col = 0; col < width; col++) {
+            random = random * 1103515245 + 12345;
+            int32 value = 2000 + static_cast<int32>(1500.0 * std::sin(col * 0.003) * std::cos(row * 0.002))
+                        + static_cast<int32>(((row & 1) + (col & 1)) * 400) + static_cast<int32>((random >> 16) % (noise + 1));
+            frame[static_cast<size_t>(row) * width + col] = static_cast<uint16>(std::min(std::max(value, 0), 16383));
+        }
+    return frame;
+}
+
+
+class TileSpooler : public dng_spooler {
+public:
+    std::vector<uint8> data;
+    void Spool(const void *block, uint32 count) {
+        data.insert(data.end(), static_cast<const uint8*>(block), static_cast<const uint8*>(block) + count);
+    }
+};
+
+
+struct Frame {
+    std::vector<uint16> pixels;
+    uint32 width, height, tileSize;
+
+    uint32 tilesAcross() const {return width / tileSize;}
+    uint32 tiles() const {return tilesAcross() * (height / tileSize);}
+    const uint16* tile(uint32 index) const {
+        return &pixels[(static_cast<size_t>(index / tilesAcross()) * width + index % tilesAcross()) * tileSize];
+    }
+};
+
+
+// Encodes all tiles on the given number of threads, returns seconds and compressed bytes
+static double encodeFrame(const Frame &frame, unsigned int threads, const dng_lossless_jpeg_tables *tables,
+                          uint64 &compressedBytes, bool &roundTrip) {
+    std::atomic<uint32> nextTile(0);
+    std::atomic<uint64> bytes(0);
+    std::atomic<bool> identical(true);
+
+    auto worker = [&]() {
+        for (uint32 index = nextTile++; index < frame.tiles(); index = nextTile++) {
+            dng_memory_stream stream(gDefaultDNGMemoryAllocator);
+            EncodeLosslessJPEG(frame.tile(index), frame.tileSize, frame.tileSize / 2, 2, 14, frame.width, 2, stream, tables);
+            stream.Flush();
+            bytes += stream.Length();
+
+            if (roundTrip) {
+                TileSpooler spooler;
+                uint32 tileBytes = frame.tileSize * frame.tileSize * 2;
+                stream.SetReadPosition(0);
+                DecodeLosslessJPEG(stream, spooler, tileBytes, tileBytes, false, stream.Length());
+                for (uint32 row = 0; row < frame.tileSize; row++)
+                    if (memcmp(&spooler.data[row * frame.tileSize * 2], frame.tile(index) + static_cast<size_t>(row) * frame.width,
+                               frame.tileSize * 2) != 0) identical = false;
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned int thread = 1; thread < threads; thread++) pool.push_back(std::thread(worker));
+    worker();
+    for (std::thread &thread : pool) thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    compressedBytes = bytes;
+    roundTrip = roundTrip && identical;
+    return seconds;
+}
+
+
+// Encodes the frame as one strip. With restart markers, each interval is encoded on its own
+// with the same tables and the pieces are joined under a single header carrying a DRI marker
+static std::vector<uint8> encodeStrip(const Frame &frame, uint32 restartRows, const dng_lossless_jpeg_tables &tables) {
+    std::vector<uint8> strip;
+    uint32 cols = frame.width / 2;
+
+    for (uint32 row = 0, interval = 0; row < frame.height; row += (restartRows ? restartRows : frame.height), interval++) {
+        uint32 rows = restartRows ? std::min(restartRows, frame.height - row) : frame.height;
+        dng_memory_stream stream(gDefaultDNGMemoryAllocator);
+        EncodeLosslessJPEG(&frame.pixels[static_cast<size_t>(row) * frame.width], rows, cols, 2, 14, frame.width, 2, stream, &tables);
+        stream.Flush();
+
+        std::vector<uint8> data(static_cast<size_t>(stream.Length()));
+        stream.SetReadPosition(0);
+        stream.Get(data.data(), static_cast<uint32>(data.size()));
+
+        // Entropy coded data starts after the SOS segment and ends before the EOI marker
+        size_t sos = 2;
+        while (data[sos + 1] != M_SOS) sos += 2 + ((data[sos + 2] << 8) | data[sos + 3]);
+        size_t entropy = sos + 2 + ((data[sos + 2] << 8) | data[sos + 3]);
+
+        if (interval == 0) {
+            strip.insert(strip.end(), data.begin(), data.begin() + sos);
+            strip[7] = static_cast<uint8>(frame.height >> 8);      // SOF3 height
+            strip[8] = static_cast<uint8>(frame.height);
+            if (restartRows) {
+                uint32 restartInterval = restartRows * cols;
+                const uint8 dri[] = {0xFF, M_DRI, 0, 4, static_cast<uint8>(restartInterval >> 8), static_cast<uint8>(restartInterval)};
+                strip.insert(strip.end(), dri, dri + sizeof(dri));
+            }
+            strip.insert(strip.end(), data.begin() + sos, data.begin() + entropy);
+        }
+        else {
+            strip.push_back(0xFF);
+            strip.push_back(static_cast<uint8>(M_RST0 + ((interval - 1) & 7)));
+        }
+        strip.insert(strip.end(), data.begin() + entropy, data.end() - 2);
+    }
+
+    strip.push_back(0xFF);
+    strip.push_back(M_EOI);
+    return strip;
+}
+
+
+// Decodes the strip, returns seconds
+static double decodeStrip(const Frame &frame, const std::vector<uint8> &strip, DngHost *host, bool &identical) {
+    TileSpooler spooler;
+    uint32 decodedSize = static_cast<uint32>(frame.pixels.size() * 2);
+    spooler.data.reserve(decodedSize);
+
+    auto start = std::chrono::steady_clock::now();
+    dng_stream stream(strip.data(), static_cast<uint32>(strip.size()));
+    DecodeLosslessJPEG(stream, spooler, decodedSize, decodedSize, false, strip.size(), host);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    identical = (spooler.data.size() == decodedSize) && (memcmp(spooler.data.data(), frame.pixels.data(), decodedSize) == 0);
+    return seconds;
+}
+
+
+// -----------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv []) {
+    unsigned int megapixels = 24, tileSize = 256, sampleTiles = 8, noise = 64, repeat = 3, restartRows = 16;
+    unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (int index = 1; index < argc; index++) {
+        std::string option(argv[index]);
+        if ((option == "-mp") && (index + 1 < argc))          megapixels = std::max(atoi(argv[++index]), 1);
+        else if ((option == "-tile") && (index + 1 < argc))   tileSize = std::max(atoi(argv[++index]) & ~15, 16);
+        else if ((option == "-sample") && (index + 1 < argc)) sampleTiles = std::max(atoi(argv[++index]), 1);
+        else if ((option == "-noise") && (index + 1 < argc))  noise = std::max(atoi(argv[++index]), 0);
+        else if ((option == "-repeat") && (index + 1 < argc)) repeat = std::max(atoi(argv[++index]), 1);
+        else if ((option == "-threads") && (index + 1 < argc)) threads = std::max(atoi(argv[++index]), 1);
+        else if ((option == "-restart") && (index + 1 < argc)) restartRows = std::max(atoi(argv[++index]), 1);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [-mp <n>] [-tile <pixels>] [-sample <tiles>] [-noise <DN>] [-repeat <n>]"
+                      << " [-threads <n>] [-restart <rows>]\n"
+                         "Lossless JPEG encoding of a synthetic 14-bit Bayer frame (default: 24 MP, 256x256 tiles,\n"
+                         "Huffman tables sampled from 8 tiles, noise of 64 DN, one thread per CPU), and decoding of\n"
+                         "the frame as a single strip (default: restart markers every 16 rows).\n";
+            return 1;
+        }
+    }
+
+    ThreadPool::setGlobalThreads(threads);
+
+    Frame frame;
+    frame.tileSize = tileSize;
+    frame.height = static_cast<uint32>(std::sqrt(megapixels * 1e6 / 1.5)) / tileSize * tileSize;
+    frame.width = static_cast<uint32>(frame.height * 1.5) / tileSize * tileSize;
+    frame.pixels = makeFrame(frame.width, frame.height, noise);
+
+    dng_lossless_jpeg_tables tables;
+    for (uint32 sample = 0; sample < std::min(sampleTiles, frame.tiles()); sample++) {
+        uint32 index = static_cast<uint32>((static_cast<uint64>(sample) * frame.tiles() + frame.tiles() / 2) / sampleTiles);
+        tables.AddSample(frame.tile(index), tileSize, tileSize / 2, 2, 14, frame.width, 2);
+    }
+    tables.Freeze();
+
+    double rawMB = frame.pixels.size() * 2 / 1e6;
+    std::cout << frame.width << "x" << frame.height << " frame, " << frame.tiles() << " tiles of " << tileSize << "x" << tileSize
+              << ", " << threads << " thread(s), best of " << repeat << "\n\n"
+              << "  Huffman tables          output      ratio       MB/s   MB/s/core  round trip\n";
+
+    bool allIdentical = true;
+    for (int mode = 0; mode < 2; mode++) {
+        const dng_lossless_jpeg_tables *modeTables = (mode == 0) ? NULL : &tables;
+        double best = 0.0;
+        uint64 bytes = 0;
+        bool identical = true;
+
+        try {
+            for (unsigned int run = 0; run < repeat; run++) {
+                bool check = (run == 0);
+                double seconds = encodeFrame(frame, threads, modeTables, bytes, check);
+                if (run == 0) identical = check;
+                if ((run == 0) || (seconds < best)) best = seconds;
+            }
+        }
+        catch (const dng_exception &except) {
+            std::cerr << "DNG SDK error " << except.ErrorCode() << "\n";
+            return 1;
+        }
+        allIdentical = allIdentical && identical;
+
+        std::string label = (mode == 0) ? "optimal per tile" : "sampled, " + std::to_string(sampleTiles) + " tiles";
+        std::cout << std::fixed << std::setprecision(1) << "  " << std::left << std::setw(20) << label << std::right
+                  << std::setw(8) << bytes / 1e6 << " MB" << std::setprecision(2) << std::setw(9) << rawMB / (bytes / 1e6) << ":1"
+                  << std::setprecision(0) << std::setw(11) << rawMB / best << std::setw(12) << rawMB / best / threads
+                  << "  " << (identical ? "identical" : "DIFFERENT") << std::endl;
+    }
+
+    // The restart interval is a 16-bit count of pixels
+    restartRows = std::min(restartRows, 65535 / (frame.width / 2));
+
+    std::cout << "\n  Single strip decode        threads       MB/s   MB/s/core  output\n";
+
+    DngHost host;
+    for (int mode = 0; mode < 3; mode++) {
+        uint32 modeRestartRows = (mode == 0) ? 0 : restartRows;
+        unsigned int modeThreads = (mode == 2) ? threads : 1;
+        if ((mode == 2) && (threads == 1)) break;
+
+        double best = 0.0;
+        bool identical = true;
+
+        try {
+            std::vector<uint8> strip = encodeStrip(frame, modeRestartRows, tables);
+            for (unsigned int run = 0; run < repeat; run++) {
+                bool check;
+                double seconds = decodeStrip(frame, strip, (mode == 2) ? &host : NULL, check);
+                identical = identical && check;
+                if ((run == 0) || (seconds < best)) best = seconds;
+            }
+        }
+        catch (const dng_exception &except) {
+            std::cerr << "DNG SDK error " << except.ErrorCode() << "\n";
+            return 1;
+        }
+        allIdentical = allIdentical && identical;
+
+        std::string label = (mode == 0) ? "no restart markers" : "restart every " + std::to_string(restartRows) + " rows";
+        std::cout << std::fixed << "  " << std::left << std::setw(24) << label << std::right << std::setw(9) << modeThreads
+                  << std::setprecision(0) << std::setw(11) << rawMB / best << std::setw(12) << rawMB / best / modeThreads
+                  << "  " << (identical ? "identical" : "DIFFERENT") << std::endl;
+    }
+
+    return allIdentical ? 0 : 1;
+}
@@ -0,0 +1,550 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+// Runs raw2dng's conversion pipeline on synthetic Bayer, X-Trans and linear RGB negatives and
+// times every stage on its own. Results are written as JSON, one record per sensor and size,
+// so runs with different thread counts or SDK versions can be compared by script.
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "dnghost.h"
+#include "threadpool.h"
+#include "simdsuite.h"
+#include "poolallocator.h"
+#include "tilepolicy.h"
+
+#include "dng_camera_profile.h"
+#include "dng_exif.h"
+#include "dng_hue_sat_map.h"
+#include "dng_ifd.h"
+#include "dng_image.h"
+#include "dng_image_writer.h"
+#include "dng_memory_stream.h"
+#include "dng_mosaic_info.h"
+#include "dng_negative.h"
+#include "dng_preview.h"
+#include "dng_render.h"
+#include "dng_resample.h"
+#include "dng_simple_image.h"
+#include "dng_tag_codes.h"
+#include "dng_tag_types.h"
+#include "dng_tag_values.h"
+#include "dng_xmp.h"
+#include "dng_xmp_sdk.h"
+
+const uint32 previewSize = 1024;   // as in RawConverter
+
+enum Sensor { sensorBayer, sensorXTrans, sensorLinear };
+
+static const char* sensorName(Sensor sensor) {
+    switch (sensor) {
+        case sensorBayer:  return "bayer";
+        case sensorXTrans: return "xtrans";
+        default:           return "rgb";
+    }
+}
+
+// Stages in pipeline order - every run goes through all of them, each stage timed on its own
+enum Stage { stageStage1, stageLinearize, stageDemosaic, stageRender, stageResample, stagePreviewJpeg,
+             stageWriteLjpeg, stageWriteDeflate, stageDigest, stageXmp, stageCount };
+
+static const char* stageNames[stageCount] = {
+    "stage1", "linearize", "demosaic", "render", "resample", "preview_jpeg",
+    "write_ljpeg", "write_deflate", "md5", "xmp"
+};
+
+
+// -----------------------------------------------------------------------------------------
+// Synthetic sensor data: a smooth gradient with pixel noise on top, in the 14-bit range of
+// a typical raw file. Mosaic sensors get one plane, the linear sensor three
+
+const uint32 blackLevel = 512, whiteLevel = 16383;
+
+class SyntheticSensor {
+public:
+    SyntheticSensor(Sensor sensor, uint32 width, uint32 height)
+        : m_sensor(sensor), m_width(width), m_height(height), m_planes((sensor == sensorLinear) ? 3 : 1),
+          m_data(static_cast<size_t>(width) * height * m_planes) {
+        uint32 seed = 1;
+        for (uint32 plane = 0; plane < m_planes; plane++)
+            for (uint32 row = 0; row < height; row++) {
+                uint16 *pixel = &m_data[(static_cast<size_t>(plane) * height + row) * width];
+                for (uint32 col = 0; col < width; col++) {
+                    seed = seed * 1103515245 + 12345;
+                    uint32 gradient = col * 9000 / width + row * 4000 / height + plane * 1500;
+                    pixel[col] = static_cast<uint16>(std::min(blackLevel + gradient + ((seed >> 16) & 0xFF), whiteLevel));
+                }
+            }
+    }
+
+    Sensor sensor() const {return m_sensor;}
+    uint32 width() const {return m_width;}
+    uint32 height() const {return m_height;}
+    uint32 planes() const {return m_planes;}
+    const uint16* plane(uint32 plane) const {return &m_data[static_cast<size_t>(plane) * m_height * m_width];}
+
+private:
+    Sensor m_sensor;
+    uint32 m_width, m_height, m_planes;
+    std::vector<uint16> m_data;
+};
+
+
+static void fillMap(dng_hue_sat_map &map, uint32 hues, uint32 sats, uint32 vals) {
+    map.SetDivisions(hues, sats, vals);
+
+    dng_hue_sat_map::HSBModify *deltas = map.GetDeltas();
+    for (uint32 entry = 0; entry < map.DeltasCount(); entry++) {
+        deltas[entry].fHueShift = static_cast<real32>(entry % 13) - 6.0f;
+        deltas[entry].fSatScale = 0.9f + (entry % 7) * 0.03f;
+        deltas[entry].fValScale = 0.95f + (entry % 5) * 0.02f;
+    }
+    map.AssignNewUniqueRuntimeFingerprint();
+}
+
+
+// Negative with metadata set up the way NegativeProcessor does it, but no image yet
+static dng_negative* makeNegative(dng_host &host, const SyntheticSensor &sensor) {
+    AutoPtr<dng_negative> negative(host.Make_dng_negative());
+
+    negative->SetModelName("Synthetic");
+    negative->SetLocalName("Synthetic");
+    negative->SetColorChannels(3);
+    negative->SetColorKeys(colorKeyRed, colorKeyGreen, colorKeyBlue);
+    if (sensor.sensor() == sensorBayer) negative->SetBayerMosaic(1);
+    else if (sensor.sensor() == sensorXTrans) negative->SetFujiMosaic6x6(0);
+
+    negative->SetWhiteLevel(whiteLevel);
+    negative->SetBlackLevel(blackLevel);
+    negative->SetActiveArea(dng_rect(sensor.height(), sensor.width()));
+    negative->SetDefaultCropOrigin(8, 8);
+    negative->SetDefaultCropSize(sensor.width() - 16, sensor.height() - 16);
+    negative->SetBaselineExposure(0.35);
+
+    dng_vector neutral(3);
+    neutral[0] = 0.5; neutral[1] = 1.0; neutral[2] = 0.6;
+    negative->SetCameraNeutral(neutral);
+
+    AutoPtr<dng_camera_profile> profile(new dng_camera_profile);
+    profile->SetName("Synthetic");
+    profile->SetColorMatrix1(dng_matrix_3by3(0.7, -0.1, -0.05, -0.3, 1.1, 0.2, -0.05, 0.2, 0.6));
+    profile->SetCalibrationIlluminant1(lsD65);
+
+    dng_hue_sat_map hueSatMap;
+    fillMap(hueSatMap, 90, 30, 1);
+    profile->SetHueSatDeltas1(hueSatMap);
+    negative->AddProfile(profile);
+
+    dng_exif *exif = negative->GetExif();
+    exif->fMake.Set_ASCII("Synthetic");
+    exif->fModel.Set_ASCII("Synthetic");
+    exif->fSoftware.Set_ASCII("raw2dng_bench");
+    exif->fExposureTime = dng_urational(1, 125);
+    exif->fFNumber = dng_urational(56, 10);
+    exif->fISOSpeedRatings[0] = 200;
+    exif->fFocalLength = dng_urational(35, 1);
+    exif->fImageDescription.Set_ASCII("Synthetic sensor data");
+    negative->SynchronizeMetadata();
+
+    return negative.Release();
+}
+
+
+// -----------------------------------------------------------------------------------------
+// Pipeline stages
+
+static void buildStage1(dng_host &host, dng_negative &negative, const SyntheticSensor &sensor) {
+    // copy the sensor data into a stage 1 image, like a decoder handing over its buffer
+    AutoPtr<dng_image> image(new dng_simple_image(dng_rect(sensor.height(), sensor.width()), sensor.planes(),
+                                                  ttShort, host.Allocator()));
+    dng_pixel_buffer buffer;
+    static_cast<dng_simple_image*>(image.Get())->GetPixelBuffer(buffer);
+
+    for (uint32 plane = 0; plane < sensor.planes(); plane++)
+        for (uint32 row = 0; row < sensor.height(); row++)
+            memcpy(buffer.DirtyPixel_uint16(row, 0, plane), sensor.plane(plane) + static_cast<size_t>(row) * sensor.width(),
+                   sensor.width() * sizeof(uint16));
+
+    negative.SetStage1Image(image);
+}
+
+
+static dng_image* resample(dng_host &host, const dng_image &image, uint32 maxSize) {
+    dng_point size(image.Size());
+    real64 scale = std::min(1.0, static_cast<real64>(maxSize) / std::max(size.h, size.v));
+    dng_rect bounds(std::max(1, Round_int32(size.v * scale)), std::max(1, Round_int32(size.h * scale)));
+
+    AutoPtr<dng_image> result(host.Make_dng_image(bounds, image.Planes(), image.PixelType()));
+    ResampleImage(host, image, *result, image.Bounds(), bounds, dng_resample_bicubic::Get());
+    return result.Release();
+}
+
+
+// Writes just the raw IFD's tiles the way WriteDNG sets them up and returns the bytes written
+static uint64 writeRawTiles(dng_host &host, const dng_negative &negative, uint32 compression,
+                            const TilePolicy &policy = TilePolicy(), dng_ifd *layout = NULL) {
+    const dng_image &rawImage = negative.RawImage();
+    const dng_mosaic_info *mosaicInfo = negative.GetMosaicInfo();
+    bool isCFA = (mosaicInfo != NULL) && mosaicInfo->IsColorFilterArray();
+
+    dng_ifd info;
+    info.fNewSubFileType = sfMainImage;
+    info.fImageWidth = rawImage.Width();
+    info.fImageLength = rawImage.Height();
+    info.fSamplesPerPixel = rawImage.Planes();
+    info.fBitsPerSample[0] = 16;
+    info.fPhotometricInterpretation = isCFA ? piCFA : piLinearRaw;
+    info.fCompression = compression;
+
+    uint32 fakeChannels = 1;
+    if (compression == ccJPEG) {
+        if (isCFA && (mosaicInfo->fCFAPatternSize.h == 4)) fakeChannels = 4;
+        else if (isCFA && (mosaicInfo->fCFAPatternSize.h == 2)) fakeChannels = 2;
+        while ((fakeChannels * info.fSamplesPerPixel > 4) && (fakeChannels > 1)) fakeChannels >>= 1;
+    }
+    else {
+        info.fPredictor = cpHorizontalDifference;
+        if (isCFA && (mosaicInfo->fCFAPatternSize.h == 2)) info.fPredictor = cpHorizontalDifferenceX2;
+        else if (isCFA && (mosaicInfo->fCFAPatternSize.h == 4)) info.fPredictor = cpHorizontalDifferenceX4;
+    }
+
+    TilePolicyWriter writer(policy);
+    writer.FindRawTileSize(host, info);
+    if (layout != NULL) *layout = info;
+
+    dng_tiff_directory rawIFD;
+    dng_basic_tag_set rawBasic(rawIFD, info);
+
+    dng_memory_stream stream(host.Allocator());
+    writer.WriteImage(host, info, rawBasic, stream, rawImage, fakeChannels);
+    stream.Flush();
+    return stream.Length();
+}
+
+
+// -----------------------------------------------------------------------------------------
+
+struct BenchResult {
+    Sensor sensor;
+    uint32 width, height;
+    double bestMs[stageCount];
+    uint64 ljpegBytes, deflateBytes, previewJpegBytes, xmpBytes;
+    std::string digest;
+};
+
+
+static std::string hexDigest(const dng_fingerprint &fingerprint) {
+    std::ostringstream hex;
+    for (uint32 byte = 0; byte < 16; byte++)
+        hex << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned int>(fingerprint.data[byte]);
+    return hex.str();
+}
+
+
+static BenchResult runPipeline(const SyntheticSensor &sensor, int repeat, dng_memory_allocator *allocator) {
+    BenchResult result;
+    result.sensor = sensor.sensor();
+    result.width = sensor.width();
+    result.height = sensor.height();
+    std::fill(result.bestMs, result.bestMs + stageCount, 0.0);
+
+    for (int run = 0; run < repeat; run++) {
+        DngHost host(allocator);
+        host.SetSaveDNGVersion(dngVersion_SaveDefault);   // keeps stage 1 as the raw image, as in RawConverter
+        host.SetSaveLinearDNG(false);
+        AutoPtr<dng_negative> negative(makeNegative(host, sensor));
+        AutoPtr<dng_image> rendered, preview;
+        dng_jpeg_preview jpegPreview;
+        AutoPtr<dng_memory_block> xmpBlock;
+        double ms[stageCount];
+
+        auto start = std::chrono::steady_clock::now();
+        auto lap = [&](Stage stage) {
+            auto now = std::chrono::steady_clock::now();
+            ms[stage] = std::chrono::duration<double, std::milli>(now - start).count();
+            start = now;
+        };
+
+        buildStage1(host, *negative, sensor);                         lap(stageStage1);
+        negative->BuildStage2Image(host);                              lap(stageLinearize);
+        negative->BuildStage3Image(host);                              lap(stageDemosaic);
+        {
+            dng_render render(host, *negative);
+            rendered.Reset(render.Render());
+        }                                                              lap(stageRender);
+        preview.Reset(resample(host, *rendered, previewSize));         lap(stageResample);
+        {
+            dng_image_writer writer;
+            writer.EncodeJPEGPreview(host, *preview, jpegPreview, 5);
+        }                                                              lap(stagePreviewJpeg);
+        result.ljpegBytes = writeRawTiles(host, *negative, ccJPEG);    lap(stageWriteLjpeg);
+        result.deflateBytes = writeRawTiles(host, *negative, ccDeflate); lap(stageWriteDeflate);
+        negative->ClearRawImageDigest();
+        negative->FindNewRawImageDigest(host);                         lap(stageDigest);
+        {
+            AutoPtr<dng_metadata> metadata(negative->Metadata().Clone(host.Allocator()));
+            dng_image_writer writer;
+            writer.CleanUpMetadata(host, *metadata, kMetadataSubset_All, "image/dng");
+            xmpBlock.Reset(metadata->GetXMP()->Serialize(true));
+        }                                                              lap(stageXmp);
+
+        result.previewJpegBytes = jpegPreview.fCompressedData->LogicalSize();
+        result.xmpBytes = xmpBlock->LogicalSize();
+        result.digest = hexDigest(negative->NewRawImageDigest());
+
+        for (int stage = 0; stage < stageCount; stage++)
+            if ((run == 0) || (ms[stage] < result.bestMs[stage])) result.bestMs[stage] = ms[stage];
+    }
+    return result;
+}
+
+
+// -----------------------------------------------------------------------------------------
+// Tile sweep: raw tile writing only, with square tiles of several sizes and each TilePolicy target
+
+static const uint32 sweepSides[] = {128, 192, 256, 384, 512, 768, 1024, 1536};
+
+struct SweepPoint {
+    std::string compression, policy;
+    uint32 tileWidth, tileHeight, tiles;
+    double bestMs;
+    uint64 bytes;
+};
+
+struct SweepResult {
+    Sensor sensor;
+    uint32 width, height;
+    std::vector<SweepPoint> points;
+};
+
+
+static SweepResult runSweep(const SyntheticSensor &sensor, int repeat, dng_memory_allocator *allocator) {
+    SweepResult result;
+    result.sensor = sensor.sensor();
+    result.width = sensor.width();
+    result.height = sensor.height();
+
+    DngHost host(allocator);
+    AutoPtr<dng_negative> negative(makeNegative(host, sensor));
+    buildStage1(host, *negative, sensor);
+
+    std::vector<TilePolicy> policies;
+    for (uint32 side : sweepSides) policies.push_back(TilePolicy(dng_point(side, side)));
+    for (TilePolicy::Target target : {TilePolicy::targetDefault, TilePolicy::targetFastest, TilePolicy::targetSmallest,
+                                      TilePolicy::targetBalanced})
+        policies.push_back(TilePolicy(target));
+
+    for (uint32 compression : {static_cast<uint32>(ccJPEG), static_cast<uint32>(ccDeflate)})
+        for (const TilePolicy &policy : policies) {
+            SweepPoint point;
+            point.compression = (compression == ccJPEG) ? "ljpeg" : "deflate";
+            point.policy = policy.name();
+            point.bestMs = 0.0;
+
+            for (int run = 0; run < repeat; run++) {
+                dng_ifd layout;
+                auto start = std::chrono::steady_clock::now();
+                point.bytes = writeRawTiles(host, *negative, compression, policy, &layout);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if ((run == 0) || (ms < point.bestMs)) point.bestMs = ms;
+
+                point.tileWidth = layout.fTileWidth;
+                point.tileHeight = layout.fTileLength;
+                point.tiles = layout.TilesAcross() * layout.TilesDown();
+            }
+            result.points.push_back(point);
+        }
+    return result;
+}
+
+
+static void writeJsonHeader(std::ostream &out, const char *mode, unsigned int threads, int repeat,
+                            const std::string &allocator) {
+    out << std::fixed << std::setprecision(2)
+        << "{\n"
+        << "  \"benchmark\": \"raw2dng_bench\",\n"
+        << "  \"mode\": \"" << mode << "\",\n"
+        << "  \"simd\": \"" << SimdSuite::name(SimdSuite::installed()) << "\",\n"
+        << "  \"threads\": " << threads << ",\n"
+        << "  \"repeat\": " << repeat << ",\n"
+        << "  \"allocator\": \"" << allocator << "\",\n"
+        << "  \"results\": [";
+}
+
+
+static void writeSweepJson(std::ostream &out, const std::vector<SweepResult> &results, unsigned int threads, int repeat,
+                           const std::string &allocator) {
+    writeJsonHeader(out, "tile_sweep", threads, repeat, allocator);
+
+    for (size_t index = 0; index < results.size(); index++) {
+        const SweepResult &result = results[index];
+        out << ((index == 0) ? "\n" : ",\n")
+            << "    {\n"
+            << "      \"sensor\": \"" << sensorName(result.sensor) << "\",\n"
+            << "      \"width\": " << result.width << ",\n"
+            << "      \"height\": " << result.height << ",\n"
+            << "      \"megapixels\": " << result.width * static_cast<double>(result.height) / 1e6 << ",\n"
+            << "      \"tiles\": [";
+        for (size_t point = 0; point < result.points.size(); point++) {
+            const SweepPoint &sweep = result.points[point];
+            out << ((point == 0) ? "\n" : ",\n")
+                << "        { \"compression\": \"" << sweep.compression << "\", \"policy\": \"" << sweep.policy
+                << "\", \"tile_width\": " << sweep.tileWidth << ", \"tile_height\": " << sweep.tileHeight
+                << ", \"tiles\": " << sweep.tiles << ", \"ms\": " << sweep.bestMs << ", \"bytes\": " << sweep.bytes << " }";
+        }
+        out << "\n      ]\n"
+            << "    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+
+static void writeJson(std::ostream &out, const std::vector<BenchResult> &results, unsigned int threads, int repeat,
+                      const std::string &allocator) {
+    writeJsonHeader(out, "pipeline", threads, repeat, allocator);
+
+    for (size_t index = 0; index < results.size(); index++) {
+        const BenchResult &result = results[index];
+        double totalMs = 0.0;
+        for (int stage = 0; stage < stageCount; stage++) totalMs += result.bestMs[stage];
+
+        out << ((index == 0) ? "\n" : ",\n")
+            << "    {\n"
+            << "      \"sensor\": \"" << sensorName(result.sensor) << "\",\n"
+            << "      \"width\": " << result.width << ",\n"
+            << "      \"height\": " << result.height << ",\n"
+            << "      \"megapixels\": " << result.width * static_cast<double>(result.height) / 1e6 << ",\n"
+            << "      \"stages_ms\": {";
+        for (int stage = 0; stage < stageCount; stage++)
+            out << ((stage == 0) ? " " : ", ") << "\"" << stageNames[stage] << "\": " << result.bestMs[stage];
+        out << " },\n"
+            << "      \"total_ms\": " << totalMs << ",\n"
+            << "      \"bytes\": { \"ljpeg\": " << result.ljpegBytes << ", \"deflate\": " << result.deflateBytes
+            << ", \"preview_jpeg\": " << result.previewJpegBytes << ", \"xmp\": " << result.xmpBytes << " },\n"
+            << "      \"raw_digest\": \"" << result.digest << "\"\n"
+            << "    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+
+// -----------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv []) {
+    std::vector<unsigned int> sizes;
+    std::vector<Sensor> sensors;
+    int repeat = 3;
+    unsigned int threads = 0;
+    std::string jsonFile;
+    bool pooled = false, sweep = false;
+    PoolAllocator::LargePages largePages = PoolAllocator::largePagesOff;
+    SimdLevel simdLevel = SimdSuite::supported();
+
+    for (int index = 1; index < argc; index++) {
+        std::string option(argv[index]);
+        if ((option == "-frames") && (index + 1 < argc)) {
+            std::stringstream list(argv[++index]);
+            for (std::string size; std::getline(list, size, ',');) sizes.push_back(std::max(atoi(size.c_str()), 1));
+        }
+        else if ((option == "-sensors") && (index + 1 < argc)) {
+            std::stringstream list(argv[++index]);
+            for (std::string name; std::getline(list, name, ',');) {
+                if (name == "bayer") sensors.push_back(sensorBayer);
+                else if (name == "xtrans") sensors.push_back(sensorXTrans);
+                else if (name == "rgb") sensors.push_back(sensorLinear);
+                else { std::cerr << "Unknown sensor '" << name << "'\n"; return 1; }
+            }
+        }
+        else if ((option == "-repeat") && (index + 1 < argc))  repeat = std::max(atoi(argv[++index]), 1);
+        else if ((option == "-threads") && (index + 1 < argc)) threads = std::max(atoi(argv[++index]), 0);
+        else if ((option == "-o") && (index + 1 < argc))       jsonFile = argv[++index];
+        else if (option == "-pool") pooled = true;
+        else if (option == "-sweep") sweep = true;
+        else if ((option == "-hugepages") && (index + 1 < argc) && PoolAllocator::parse(argv[++index], largePages)) pooled = true;
+        else if ((option == "-simd") && (index + 1 < argc) && SimdSuite::parse(argv[++index], simdLevel)) continue;
+        else {
+            std::cerr << "Usage: " << argv[0] << " [-frames <MP>[,<MP>...]] [-sensors bayer|xtrans|rgb[,...]] [-repeat <n>]"
+                      << " [-threads <n>] [-simd scalar|sse4.1|avx2|avx512] [-pool] [-hugepages transparent|explicit]"
+                      << " [-sweep] [-o <file.json>]\n"
+                         "Times each stage of the conversion pipeline on synthetic negatives (default: 24 MP,\n"
+                         "all sensors, best of 3) and writes the results as JSON to stdout or <file.json>.\n"
+                         "-pool takes all memory from one PoolAllocator, as raw2dng does, instead of malloc;\n"
+                         "-hugepages does the same with large blocks backed by 2 MB pages.\n"
+                         "-sweep only writes the raw tiles instead, with a range of tile sizes and each\n"
+                         "tile policy target, and reports time and size of each.\n";
+            return 1;
+        }
+    }
+    if (sizes.empty()) sizes = {24};
+    if (sensors.empty()) sensors = {sensorBayer, sensorXTrans, sensorLinear};
+
+    SimdSuite::install(simdLevel);
+    ThreadPool::setGlobalThreads(threads);
+    dng_xmp_sdk::InitializeSDK();
+
+    PoolAllocator pool(PoolAllocator::defaultCacheLimit, largePages);
+    std::vector<BenchResult> results;
+    std::vector<SweepResult> sweepResults;
+    try {
+        for (unsigned int megapixels : sizes)
+            for (Sensor sensor : sensors) {
+                // 3:2 frames, multiple of the 6x6 X-Trans cell
+                uint32 height = static_cast<uint32>(std::sqrt(megapixels * 1e6 / 1.5) / 6 + 0.5) * 6;
+                uint32 width = static_cast<uint32>(height * 1.5 / 6 + 0.5) * 6;
+
+                std::cerr << "  " << sensorName(sensor) << " " << width << "x" << height << "..." << std::flush;
+                SyntheticSensor data(sensor, width, height);
+                if (sweep) {
+                    sweepResults.push_back(runSweep(data, repeat, pooled ? &pool : NULL));
+                    std::cerr << " " << sweepResults.back().points.size() << " tile layouts" << std::endl;
+                    continue;
+                }
+                results.push_back(runPipeline(data, repeat, pooled ? &pool : NULL));
+                std::cerr << std::fixed << std::setprecision(0) << " "
+                          << results.back().bestMs[stageDemosaic] << " ms demosaic, "
+                          << results.back().bestMs[stageWriteLjpeg] << " ms ljpeg write" << std::endl;
+            }
+    }
+    catch (const dng_exception &e) {
+        std::cerr << "\nDNG SDK error " << e.ErrorCode() << std::endl;
+        return 1;
+    }
+
+    threads = DngHost().PerformAreaTaskThreads();
+    std::string allocator = !pooled ? "malloc" : (largePages == PoolAllocator::largePagesOff) ? "pool"
+                          : std::string("pool+") + PoolAllocator::name(largePages) + "-hugepages";
+    std::ofstream file;
+    if (!jsonFile.empty()) file.open(jsonFile.c_str());
+    std::ostream &out = jsonFile.empty() ? std::cout : file;
+
+    if (sweep) writeSweepJson(out, sweepResults, threads, repeat, allocator);
+    else       writeJson(out, results, threads, repeat, allocator);
+    if (!out) { std::cerr << "Could not write " << jsonFile << std::endl; return 1; }
+
+    dng_xmp_sdk::TerminateSDK();
+    return 0;
+}
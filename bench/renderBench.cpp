@@ -0,0 +1,196 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+// Renders synthetic full-size frames with the fused BaselineRender16 pass and with the SDK's
+// step-by-step path, and compares time and output of the two.
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "dnghost.h"
+#include "threadpool.h"
+#include "simdsuite.h"
+
+#include "dng_camera_profile.h"
+#include "dng_hue_sat_map.h"
+#include "dng_image.h"
+#include "dng_negative.h"
+#include "dng_render.h"
+#include "dng_simple_image.h"
+#include "dng_tag_types.h"
+#include "dng_tag_values.h"
+#include "dng_xmp_sdk.h"
+
+
+// -----------------------------------------------------------------------------------------
+// Synthetic linear raw frame with a profile like Adobe's: a 90x30 hue/sat map and a
+// 36x8x16 look table in sRGB encoding
+
+static void fillMap(dng_hue_sat_map &map, uint32 hues, uint32 sats, uint32 vals) {
+    map.SetDivisions(hues, sats, vals);
+
+    dng_hue_sat_map::HSBModify *deltas = map.GetDeltas();
+    for (uint32 entry = 0; entry < map.DeltasCount(); entry++) {
+        deltas[entry].fHueShift = static_cast<real32>(entry % 13) - 6.0f;
+        deltas[entry].fSatScale = 0.9f + (entry % 7) * 0.03f;
+        deltas[entry].fValScale = 0.95f + (entry % 5) * 0.02f;
+    }
+    map.AssignNewUniqueRuntimeFingerprint();
+}
+
+
+static dng_negative* makeNegative(dng_host &host, uint32 width, uint32 height) {
+    AutoPtr<dng_negative> negative(host.Make_dng_negative());
+
+    negative->SetModelName("Synthetic");
+    negative->SetLocalName("Synthetic");
+    negative->SetColorChannels(3);
+    negative->SetColorKeys(colorKeyRed, colorKeyGreen, colorKeyBlue);
+    negative->SetWhiteLevel(4095);
+    negative->SetBlackLevel(64);
+    negative->SetDefaultCropSize(width, height);
+    negative->SetDefaultCropOrigin(0, 0);
+
+    dng_vector neutral(3);
+    neutral[0] = 0.5; neutral[1] = 1.0; neutral[2] = 0.6;
+    negative->SetCameraNeutral(neutral);
+
+    AutoPtr<dng_camera_profile> profile(new dng_camera_profile);
+    profile->SetName("Synthetic");
+    profile->SetColorMatrix1(dng_matrix_3by3(0.7, -0.1, -0.05, -0.3, 1.1, 0.2, -0.05, 0.2, 0.6));
+    profile->SetCalibrationIlluminant1(lsD65);
+
+    dng_hue_sat_map hueSatMap, lookTable;
+    fillMap(hueSatMap, 90, 30, 1);
+    fillMap(lookTable, 36, 8, 16);
+    profile->SetHueSatDeltas1(hueSatMap);
+    profile->SetLookTable(lookTable);
+    profile->SetLookTableEncoding(encoding_sRGB);
+    negative->AddProfile(profile);
+
+    AutoPtr<dng_image> image(new dng_simple_image(dng_rect(height, width), 3, ttShort, host.Allocator()));
+    dng_pixel_buffer buffer;
+    static_cast<dng_simple_image*>(image.Get())->GetPixelBuffer(buffer);
+
+    for (uint32 plane = 0; plane < 3; plane++)
+        for (uint32 row = 0; row < height; row++) {
+            uint16 *pixel = buffer.DirtyPixel_uint16(row, 0, plane);
+            for (uint32 col = 0; col < width; col++) {
+                uint32 noise = ((row * 7 + col * 13 + plane * 5) ^ (row * col >> 5)) & 0xFF;
+                pixel[col] = static_cast<uint16>(64 + ((col * 3000 / width + row * 1000 / height + noise + plane * 300) % 4000));
+            }
+        }
+
+    negative->SetStage1Image(image);
+    negative->SynchronizeMetadata();
+    negative->BuildStage2Image(host);
+    negative->BuildStage3Image(host);
+    return negative.Release();
+}
+
+
+static dng_image* render(dng_host &host, const dng_negative &negative, uint32 pixelType, bool fused, double &bestMs, int repeat) {
+    AutoPtr<dng_image> image;
+    bestMs = 0.0;
+
+    for (int run = 0; run < repeat; run++) {
+        dng_render render(host, negative);
+        render.SetFinalPixelType(pixelType);
+        render.SetFusedRender(fused);
+
+        auto start = std::chrono::steady_clock::now();
+        image.Reset(render.Render());
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if ((run == 0) || (ms < bestMs)) bestMs = ms;
+    }
+    return image.Release();
+}
+
+
+// -----------------------------------------------------------------------------------------
+
+int main(int argc, const char* argv []) {
+    std::vector<unsigned int> frames;
+    int repeat = 3;
+    uint32 pixelType = ttByte;
+    unsigned int threads = 0;
+    SimdLevel simdLevel = SimdSuite::supported();
+
+    for (int index = 1; index < argc; index++) {
+        std::string option(argv[index]);
+        if ((option == "-frames") && (index + 1 < argc)) {
+            std::stringstream sizes(argv[++index]);
+            for (std::string size; std::getline(sizes, size, ',');) frames.push_back(std::max(atoi(size.c_str()), 1));
+        }
+        else if ((option == "-repeat") && (index + 1 < argc))  repeat = std::max(atoi(argv[++index]), 1);
+        else if ((option == "-threads") && (index + 1 < argc)) threads = std::max(atoi(argv[++index]), 0);
+        else if (option == "-16bit") pixelType = ttShort;
+        else if ((option == "-simd") && (index + 1 < argc) && SimdSuite::parse(argv[++index], simdLevel)) continue;
+        else {
+            std::cerr << "Usage: " << argv[0] << " [-frames <MP>[,<MP>...]] [-repeat <n>] [-threads <n>] [-16bit]"
+                      << " [-simd scalar|sse4.1|avx2|avx512]\n"
+                         "Renders synthetic frames (default: 24, 42 and 61 MP) with and without the fused pass.\n";
+            return 1;
+        }
+    }
+    if (frames.empty()) frames = {24, 42, 61};
+
+    SimdSuite::install(simdLevel);
+    ThreadPool::setGlobalThreads(threads);
+    dng_xmp_sdk::InitializeSDK();
+
+    std::cout << "SIMD level " << SimdSuite::name(SimdSuite::installed()) << ", "
+              << ((pixelType == ttByte) ? 8 : 16) << "-bit output, best of " << repeat << "\n\n"
+              << "  frame   size          step-by-step     fused   speedup  output\n";
+
+    bool allSame = true;
+    for (unsigned int megapixels : frames) {
+        // 3:2 frames
+        uint32 height = static_cast<uint32>(std::sqrt(megapixels * 1e6 / 1.5) + 0.5) & ~1u;
+        uint32 width = static_cast<uint32>(height * 1.5 + 0.5) & ~1u;
+
+        DngHost host;
+        AutoPtr<dng_negative> negative(makeNegative(host, width, height));
+
+        double stepMs, fusedMs;
+        AutoPtr<dng_image> stepImage(render(host, *negative, pixelType, false, stepMs, repeat));
+        AutoPtr<dng_image> fusedImage(render(host, *negative, pixelType, true, fusedMs, repeat));
+
+        bool same = fusedImage->EqualArea(*stepImage, stepImage->Bounds(), 0, stepImage->Planes());
+        allSame = allSame && same;
+
+        std::ostringstream size;
+        size << width << "x" << height;
+        std::cout << std::fixed << std::setprecision(0)
+                  << "  " << std::setw(2) << megapixels << " MP   " << std::left << std::setw(12) << size.str() << std::right
+                  << std::setw(10) << stepMs << " ms" << std::setw(7) << fusedMs << " ms"
+                  << std::setprecision(2) << std::setw(8) << stepMs / fusedMs << "x  "
+                  << (same ? "identical" : "DIFFERENT") << std::endl;
+    }
+
+    dng_xmp_sdk::TerminateSDK();
+    return allSame ? 0 : 1;
+}
@@ -48,7 +48,8 @@ find_path(LIBRAW_INCLUDE_DIR NAMES libraw/libraw.h
           ${PC_LIBRAW_INCLUDE_DIRS}
         )
 
-find_library(LIBRAW_LIBRARY NAMES libraw raw
+# prefer the thread-safe build, raw2dng runs several LibRaw instances concurrently in batch mode
+find_library(LIBRAW_LIBRARY NAMES raw_r libraw_r libraw raw
              HINTS
              ${PC_LIBRAW_LIBDIR}
              ${PC_LIBRAW_LIBRARY_DIRS}
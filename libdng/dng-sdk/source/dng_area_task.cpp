@@ -282,6 +282,60 @@ void dng_area_task::ProcessOnThread (uint32 threadIndex,
 
 /*****************************************************************************/
 
+void dng_area_task::ProcessOnThread (uint32 threadIndex,
+									 const dng_rect &area,
+									 const dng_point &tileSize,
+									 std::atomic<uint32> &nextTile,
+									 dng_abort_sniffer *sniffer,
+                                     dng_area_task_progress *progress)
+	{
+
+	uint32 tilesAcross = (area.W () + tileSize.h - 1) / tileSize.h;
+	uint32 tilesDown   = (area.H () + tileSize.v - 1) / tileSize.v;
+
+	uint32 tileCount = tilesAcross * tilesDown;
+
+	try
+		{
+
+		for (uint32 tileIndex = nextTile++;
+			 tileIndex < tileCount;
+			 tileIndex = nextTile++)
+			{
+
+			uint32 rowIndex = tileIndex / tilesAcross;
+			uint32 colIndex = tileIndex - rowIndex * tilesAcross;
+
+			dng_rect tile (area.t + rowIndex * tileSize.v,
+						   area.l + colIndex * tileSize.h,
+						   area.t + (rowIndex + 1) * tileSize.v,
+						   area.l + (colIndex + 1) * tileSize.h);
+
+			ProcessOnThread (threadIndex,
+							 tile & area,
+							 tileSize,
+							 sniffer,
+							 progress);
+
+			}
+
+		}
+
+	catch (...)
+		{
+
+		// Don't let the other resources start any more tiles.
+
+		nextTile = tileCount;
+
+		throw;
+
+		}
+
+	}
+
+/*****************************************************************************/
+
 dng_base_tile_iterator * dng_area_task::MakeTileIterator (uint32 /* threadIndex */,
 														  const dng_rect &tile,
 														  const dng_rect &area) const
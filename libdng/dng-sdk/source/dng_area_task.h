@@ -24,6 +24,8 @@
 #include "dng_types.h"
 #include "dng_uncopyable.h"
 
+#include <atomic>
+
 /*****************************************************************************/
 
 class dng_area_task_progress: private dng_uncopyable
@@ -230,6 +232,27 @@ class dng_area_task
 							  dng_abort_sniffer *sniffer,
                               dng_area_task_progress *progress);
 
+		/// Handle tiles of an area that is shared by several resources. Instead
+		/// of working on a fixed partition, each call keeps taking the next
+		/// unprocessed tile (left to right, top down) from the shared counter
+		/// until the whole area is done, so resources that get cheap tiles
+		/// simply take more of them.
+		///
+		/// \param threadIndex 0 to threadCount - 1 index indicating which thread this is.
+		/// \param area Complete area processed by all resources.
+		/// \param tileSize size of tiles to use for processing.
+		/// \param nextTile Index of the next unprocessed tile, shared by all resources
+		/// working on area. Must be zero before the first resource starts.
+		/// \param sniffer dng_abort_sniffer to use to check for user cancellation and progress updates.
+		/// \param progress optional pointer to progress reporting object.
+
+		void ProcessOnThread (uint32 threadIndex,
+							  const dng_rect &area,
+							  const dng_point &tileSize,
+							  std::atomic<uint32> &nextTile,
+							  dng_abort_sniffer *sniffer,
+                              dng_area_task_progress *progress);
+
 		/// Factory method to make a tile iterator. This iterator will be used
 		/// by a thread to process tiles in an area in a specific order. The
 		/// default implementation uses a forward iterator that visits tiles
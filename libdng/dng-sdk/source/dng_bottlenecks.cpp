@@ -60,7 +60,8 @@ dng_suite gDNGSuite =
 	RefVignette16,
 	RefVignette32,
 	RefMapArea16,
-	RefBaselineMapPoly32
+	RefBaselineMapPoly32,
+	RefBaselineRender16
 	};
 
 /*****************************************************************************/
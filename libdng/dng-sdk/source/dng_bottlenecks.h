@@ -575,6 +575,45 @@ typedef void (BaselineMapPoly32Proc)
 
 /*****************************************************************************/
 
+/// \brief Everything dng_render_task applies to three-plane 16-bit data on its way to
+/// three-plane 8- or 16-bit output, for the fused BaselineRender16 routine. The
+/// optional steps (zero offset ramp, hue/sat map and look table, and the encoding
+/// tables of the latter two) are NULL when absent.
+
+struct dng_baseline_render_params
+	{
+	uint32 fSrcPixelRange;
+	const dng_1d_table *fZeroOffsetRamp;
+	const dng_vector *fCameraWhite;
+	const dng_matrix *fCameraToRGB;
+	const dng_hue_sat_map *fHueSatMap;
+	const dng_1d_table *fHueSatMapEncode;
+	const dng_1d_table *fHueSatMapDecode;
+	const dng_1d_table *fExposureRamp;
+	const dng_hue_sat_map *fLookTable;
+	const dng_1d_table *fLookTableEncode;
+	const dng_1d_table *fLookTableDecode;
+	const dng_1d_table *fToneCurve;
+	const dng_matrix *fRGBtoFinal;
+	const dng_1d_table *fEncodeGamma;
+	uint32 fDstPixelType;
+	};
+
+/// Renders one row: dPtrR/G/B point to uint8 data for a ttByte fDstPixelType and to
+/// uint16 data for ttShort.
+
+typedef void (BaselineRender16Proc)
+			 (const uint16 *sPtrA,
+			  const uint16 *sPtrB,
+			  const uint16 *sPtrC,
+			  void *dPtrR,
+			  void *dPtrG,
+			  void *dPtrB,
+			  uint32 count,
+			  const dng_baseline_render_params &params);
+
+/*****************************************************************************/
+
 struct dng_suite	
 	{
 	ZeroBytesProc			*ZeroBytes;
@@ -624,6 +663,7 @@ struct dng_suite
 	Vignette32Proc			*Vignette32;
 	MapArea16Proc			*MapArea16;
 	BaselineMapPoly32Proc   *BaselineMapPoly32;
+	BaselineRender16Proc	*BaselineRender16;
 	};
 
 /*****************************************************************************/
@@ -1747,6 +1787,29 @@ inline void DoBaselineMapPoly32 (real32 *dPtr,
 
 /*****************************************************************************/
 
+inline void DoBaselineRender16 (const uint16 *sPtrA,
+								const uint16 *sPtrB,
+								const uint16 *sPtrC,
+								void *dPtrR,
+								void *dPtrG,
+								void *dPtrB,
+								uint32 count,
+								const dng_baseline_render_params &params)
+	{
+	
+	(gDNGSuite.BaselineRender16) (sPtrA,
+								  sPtrB,
+								  sPtrC,
+								  dPtrR,
+								  dPtrG,
+								  dPtrB,
+								  count,
+								  params);
+	
+	}
+
+/*****************************************************************************/
+
 #endif
 	
 /*****************************************************************************/
@@ -47,6 +47,7 @@ class dng_jpeg_preview;
 class dng_linearization_info;
 class dng_local_string;
 class dng_look_table;
+class dng_lossless_jpeg_tables;
 class dng_matrix;
 class dng_matrix_3by3;
 class dng_matrix_4by3;
@@ -70,6 +70,9 @@ void dng_filter_task::Start (uint32 threadCount,
 											  fDstPlanes, 
 											  padSIMDBytes);
 						   
+	fSrcBuffer.Reset (new AutoPtr<dng_memory_block> [threadCount]);
+	fDstBuffer.Reset (new AutoPtr<dng_memory_block> [threadCount]);
+	
 	for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
 		{
 		
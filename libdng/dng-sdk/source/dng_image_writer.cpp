@@ -2741,6 +2741,10 @@ tag_dng_noise_profile::tag_dng_noise_profile (const dng_noise_profile &profile)
 /*****************************************************************************/
 
 dng_image_writer::dng_image_writer ()
+
+	:	fLosslessJPEGSampleTiles (0)
+	,	fLosslessJPEGTables		 (NULL)
+	
 	{
 	
 	}
@@ -3946,6 +3950,23 @@ void dng_image_writer::WriteData (dng_host &host,
 				
 				}
 				
+			if (fLosslessJPEGTables && !fLosslessJPEGTables->IsFrozen ())
+				{
+				
+				// Sampling pass of WriteImage, only collect statistics.
+				
+				fLosslessJPEGTables->AddSample ((const uint16 *) temp.fData,
+												temp.fArea.H (),
+												temp.fArea.W (),
+												temp.fPlanes,
+												ifd.fBitsPerSample [0],
+												temp.fRowStep,
+												temp.fColStep);
+												
+				break;
+				
+				}
+				
 			EncodeLosslessJPEG ((const uint16 *) temp.fData,
 								temp.fArea.H (),
 								temp.fArea.W (),
@@ -3953,7 +3974,8 @@ void dng_image_writer::WriteData (dng_host &host,
 								ifd.fBitsPerSample [0],
 								temp.fRowStep,
 								temp.fColStep,
-								stream);
+								stream,
+								fLosslessJPEGTables);
 										
 			break;
 			
@@ -4410,16 +4432,38 @@ dng_write_tiles_task::dng_write_tiles_task
 	,	fCompressedSize   (compressedSize)
 	,	fUncompressedSize (uncompressedSize)
 	,	fNextTileIndex	  (0)
+	,	fSlots			  ()
+	,	fSlotCount		  (0)
+	,	fCommitIndex	  (0)
+	,	fCommitting		  (false)
 	,	fMutex			  ("dng_write_tiles_task")
 	,	fCondition		  ()
+	,	fWaiting		  (0)
 	,	fTaskFailed		  (false)
-	,	fWriteTileIndex	  (0)
 
 	{
 
 	fMinTaskArea = 16 * 16;
 	fUnitCell    = dng_point (16, 16);
 	fMaxTileSize = dng_point (16, 16);
+	
+	// A few tiles per thread, so a slow tile doesn't hold up the others.
+	
+	fSlotCount = Min_uint32 (tilesDown * tilesAcross,
+							 Max_uint32 (host.PerformAreaTaskThreads () * 4, 8));
+	
+	fSlots.Reset (new tile_slot [fSlotCount]);
+	
+	for (uint32 index = 0; index < fSlotCount; index++)
+		{
+		
+		fSlots [index].fStream.Reset (new dng_memory_stream (host.Allocator ()));
+		
+		fSlots [index].fByteCount = 0;
+		
+		fSlots [index].fReady = false;
+		
+		}
 
 	}
 
@@ -4467,69 +4511,35 @@ void dng_write_tiles_task::Process (uint32 /* threadIndex */,
 				return;
 				}
 
-			// Encode the tile. This may be done concurrently.
+			// The tile's slot is free once the tile a ring length before it
+			// has been written. If the task failed in another thread, that
+			// thread already threw an exception.
+
+			if (!WaitForSlot (tileIndex))
+				return;
 
-			uint32 tileByteCount = 0;
+			tile_slot &slot = fSlots [tileIndex % fSlotCount];
 
-			dng_memory_stream tileStream (fHost.Allocator ());
+			// Encode the tile. This may be done concurrently.
 
 			ProcessTask (tileIndex,
 						 compressedBuffer,
 						 uncompressedBuffer,
 						 subTileBlockBuffer,
 						 tempBuffer,
-						 tileByteCount,
-						 tileStream,
+						 slot.fByteCount,
+						 *slot.fStream,
 						 sniffer);
 
-			// Wait until it is our turn to write tile.
+			slot.fReady = true;
 
-				{
+			// Write all tiles that are ready, in order, unless another thread
+			// is already doing so - either way, go on with the next tile.
 
-				dng_lock_mutex lock (&fMutex);
-
-				while (!fTaskFailed &&
-					   fWriteTileIndex != tileIndex)
-					{
-
-					fCondition.Wait (fMutex);
-
-					}
-
-				// If the task failed in another thread, that thread already
-				// threw an exception.
-
-				if (fTaskFailed)
-					return;
-
-				}
-
-			// Write the encoded tile to the output stream. This must be done
-			// sequentially in ascending order of tileIndex (enforced by the
-			// above 'wait').
-
-			WriteTask (tileIndex,
-					   tileByteCount,
-					   tileStream,
-					   sniffer);
-
-			// Let other threads know it is safe to write to stream.
-
-				{
-
-				dng_lock_mutex lock (&fMutex);
-
-				// If the task failed in another thread, that thread already
-				// threw an exception.
-
-				if (fTaskFailed)
-					return;
-
-				fWriteTileIndex++;
-
-				fCondition.Broadcast ();
+			CommitTiles (sniffer);
 
-				}
+			if (fTaskFailed)
+				return;
 
 			}
 
@@ -4538,21 +4548,7 @@ void dng_write_tiles_task::Process (uint32 /* threadIndex */,
 	catch (...)
 		{
 
-		// If first to fail, wake up any threads waiting on condition.
-
-		bool needBroadcast = false;
-
-			{
-
-			dng_lock_mutex lock (&fMutex);
-
-			needBroadcast = !fTaskFailed;
-			fTaskFailed = true;
-
-			}
-
-		if (needBroadcast)
-			fCondition.Broadcast ();
+		Fail ();
 
 		throw;
 
@@ -4648,6 +4644,209 @@ void dng_write_tiles_task::WriteTask (uint32 tileIndex,
 
 /*****************************************************************************/
 
+bool dng_write_tiles_task::WaitForSlot (uint32 tileIndex)
+	{
+	
+	if (tileIndex < fCommitIndex + fSlotCount)
+		{
+		return !fTaskFailed;
+		}
+		
+	// The committer checks fWaiting after advancing fCommitIndex, so either
+	// it sees this thread waiting or this thread sees the new index.
+		
+	dng_lock_mutex lock (&fMutex);
+	
+	fWaiting++;
+	
+	while (!fTaskFailed &&
+		   tileIndex >= fCommitIndex + fSlotCount)
+		{
+		
+		fCondition.Wait (fMutex);
+		
+		}
+		
+	fWaiting--;
+	
+	return !fTaskFailed;
+	
+	}
+
+/*****************************************************************************/
+
+void dng_write_tiles_task::CommitTiles (dng_abort_sniffer *sniffer)
+	{
+	
+	// This routine may be called concurrently, but only one thread at a time
+	// writes tiles.
+	
+	uint32 tileCount = fTilesDown * fTilesAcross;
+	
+	while (!fCommitting.exchange (true))
+		{
+		
+		uint32 tileIndex = fCommitIndex;
+		
+		while (tileIndex < tileCount && !fTaskFailed)
+			{
+			
+			tile_slot &slot = fSlots [tileIndex % fSlotCount];
+			
+			if (!slot.fReady)
+				{
+				break;
+				}
+				
+			WriteTask (tileIndex,
+					   slot.fByteCount,
+					   *slot.fStream,
+					   sniffer);
+					   
+			// Empty the slot's stream, keeping its memory, before handing
+			// the slot to the next tile.
+			
+			slot.fStream->SetLength (0);
+			
+			slot.fStream->SetWritePosition (0);
+			
+			slot.fReady = false;
+			
+			fCommitIndex = ++tileIndex;
+			
+			if (fWaiting > 0)
+				{
+				
+				dng_lock_mutex lock (&fMutex);
+				
+				fCondition.Broadcast ();
+				
+				}
+			
+			}
+			
+		fCommitting = false;
+		
+		// A tile that became ready after the check above, while its thread
+		// couldn't take over, is written in another round.
+		
+		if (tileIndex >= tileCount || fTaskFailed || !fSlots [tileIndex % fSlotCount].fReady)
+			{
+			return;
+			}
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+void dng_write_tiles_task::Fail ()
+	{
+	
+	// If first to fail, wake up any threads waiting for a slot.
+	
+	bool needBroadcast = !fTaskFailed.exchange (true);
+	
+	if (needBroadcast)
+		{
+		
+		dng_lock_mutex lock (&fMutex);
+		
+		fCondition.Broadcast ();
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+void dng_image_writer::SampleLosslessJPEGTables (dng_host &host,
+												 const dng_ifd &ifd,
+												 const dng_image &image,
+												 uint32 fakeChannels,
+												 uint32 compressedSize,
+												 uint32 uncompressedSize,
+												 dng_lossless_jpeg_tables &tables)
+	{
+	
+	AutoPtr<dng_memory_block> compressedBuffer;
+	AutoPtr<dng_memory_block> uncompressedBuffer;
+	AutoPtr<dng_memory_block> subTileBlockBuffer;
+	AutoPtr<dng_memory_block> tempBuffer;
+	
+	if (compressedSize)
+		{
+		compressedBuffer.Reset (host.Allocate (compressedSize));
+		}
+	
+	if (uncompressedSize)
+		{
+		uncompressedBuffer.Reset (host.Allocate (uncompressedSize));
+		}
+	
+	if (ifd.fSubTileBlockRows > 1 && uncompressedSize)
+		{
+		subTileBlockBuffer.Reset (host.Allocate (uncompressedSize));
+		}
+		
+	// Tiles spread evenly over the image. They go through the normal
+	// WriteTile path, where WriteData adds them to the unfrozen tables
+	// instead of encoding them.
+	
+	uint32 tilesAcross = ifd.TilesAcross ();
+	uint32 tileCount   = ifd.TilesDown () * tilesAcross;
+	
+	uint32 sampleCount = Min_uint32 (fLosslessJPEGSampleTiles, tileCount);
+	
+	dng_memory_stream noStream (host.Allocator ());
+	
+	fLosslessJPEGTables = &tables;
+	
+	try
+		{
+		
+		for (uint32 sample = 0; sample < sampleCount; sample++)
+			{
+			
+			host.SniffForAbort ();
+			
+			uint32 tileIndex = (uint32) (((uint64) sample * tileCount + tileCount / 2) / sampleCount);
+			
+			uint32 rowIndex = tileIndex / tilesAcross;
+			uint32 colIndex = tileIndex - rowIndex * tilesAcross;
+			
+			WriteTile (host,
+					   ifd,
+					   noStream,
+					   image,
+					   ifd.TileArea (rowIndex, colIndex),
+					   fakeChannels,
+					   compressedBuffer,
+					   uncompressedBuffer,
+					   subTileBlockBuffer,
+					   tempBuffer,
+					   false);
+					   
+			}
+			
+		}
+		
+	catch (...)
+		{
+		
+		fLosslessJPEGTables = NULL;
+		
+		throw;
+		
+		}
+		
+	tables.Freeze ();
+	
+	}
+
+/*****************************************************************************/
+
 void dng_image_writer::DoWriteTiles (dng_host &host,
 									 const dng_ifd &ifd,
 									 dng_basic_tag_set &basic,
@@ -4758,6 +4957,29 @@ void dng_image_writer::WriteImage (dng_host &host,
 							  (host.PerformAreaTaskThreads () > 1) &&
 							  (subTileLength == ifd.fTileLength) &&
 							  (ifd.fCompression != ccUncompressed);
+							  
+	// Shared lossless JPEG Huffman tables, if sampling fewer tiles than
+	// the image has. Whole tiles are sampled, so not with sub-tiles.
+	
+	dng_lossless_jpeg_tables sampledTables;
+	
+	fLosslessJPEGTables = NULL;
+	
+	if (ifd.fCompression == ccJPEG &&
+		fLosslessJPEGSampleTiles > 0 &&
+		fLosslessJPEGSampleTiles < tilesDown * tilesAcross &&
+		subTileLength == ifd.fTileLength)
+		{
+		
+		SampleLosslessJPEGTables (host,
+								  ifd,
+								  image,
+								  fakeChannels,
+								  compressedSize,
+								  uncompressedSize.Get (),
+								  sampledTables);
+		
+		}
 	
 	if (useMultipleThreads)
 		{
@@ -4870,6 +5092,11 @@ void dng_image_writer::WriteImage (dng_host &host,
 			
 		}
 		
+	// The sampled tables go out of scope. If an exception skips this, the
+	// pointer is still reset before the next WriteImage uses it.
+		
+	fLosslessJPEGTables = NULL;
+		
 	}
 
 /*****************************************************************************/
@@ -5790,6 +6017,17 @@ void dng_image_writer::WriteTIFFWithProfile (dng_host &host,
 							   
 /*****************************************************************************/
 
+void dng_image_writer::FindRawTileSize (dng_host & /* host */,
+										dng_ifd &info)
+	{
+	
+	info.FindTileSize (info.fCompression == ccJPEG ? 128 * 1024
+												   : 512 * 1024);
+	
+	}
+
+/*****************************************************************************/
+
 void dng_image_writer::WriteDNG (dng_host &host,
 							     dng_stream &stream,
 							     dng_negative &negative,
@@ -6332,17 +6570,11 @@ void dng_image_writer::WriteDNGWithMetadata (dng_host &host,
 		
 		}
 	
-	else if (info.fCompression == ccJPEG)
-		{
-		
-		info.FindTileSize (128 * 1024);
-		
-		}
-		
-	else if (info.fCompression == ccDeflate)
+	else if (info.fCompression == ccJPEG ||
+			 info.fCompression == ccDeflate)
 		{
 		
-		info.FindTileSize (512 * 1024);
+		FindRawTileSize (host, info);
 		
 		}
 		
@@ -2414,14 +2414,9 @@ void dng_opcode_FixVignetteRadial::Prepare (dng_negative &negative,
 													 imagePlanes, 
 													 padSIMDBytes);
 
-		// Support repeated Prepare() calls by ensuring all buffers are reset.
+		// Support repeated Prepare() calls by replacing all buffers.
 
-		for (uint32 threadIndex = 0; threadIndex < kMaxMPThreads; threadIndex++)
-			{
-				
-			fMaskBuffers [threadIndex] . Reset ();
-				
-			}
+		fMaskBuffers.Reset (new AutoPtr<dng_memory_block> [threadCount]);
 
 		for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
 			{
@@ -616,7 +616,7 @@ class dng_opcode_FixVignetteRadial: public dng_inplace_opcode
 
 		AutoPtr<dng_memory_block> fGainTable;
 
-		AutoPtr<dng_memory_block> fMaskBuffers [kMaxMPThreads];
+		AutoArray<AutoPtr<dng_memory_block> > fMaskBuffers;
 
 	public:
 	
@@ -41,11 +41,17 @@
 
 #include "dng_lossless_jpeg.h"
 
+#include "dng_abort_sniffer.h"
+#include "dng_area_task.h"
 #include "dng_assertions.h"
 #include "dng_exceptions.h"
+#include "dng_host.h"
 #include "dng_memory.h"
+#include "dng_mutex.h"
+#include "dng_rect.h"
 #include "dng_stream.h"
 #include "dng_tag_codes.h"
+#include "dng_utils.h"
 
 /*****************************************************************************/
 
@@ -176,7 +182,7 @@ static void FixHuffTbl (HuffmanTable *htbl)
     // Figure C.3: generate encoding tables
     // These are code and size indexed by symbol value
     // Set any codeless symbols to have code length 0; this allows
-    // EmitBits to detect any attempt to emit such symbols.
+    // EncodeOneDiff to detect any attempt to emit such symbols.
 
     memset (htbl->ehufsi, 0, sizeof (htbl->ehufsi));
 
@@ -263,6 +269,102 @@ static void FixHuffTbl (HuffmanTable *htbl)
 
 /*****************************************************************************/
 
+/*
+ * Lookahead table for decoding one difference: indexed by the next
+ * kHuffLookupBits bits of the bit stream, each entry holds the number of
+ * bits to consume and, where code and extra bits fit, the difference itself.
+ * Otherwise pending is the number of extra bits still to be read; a length
+ * of zero means the code is longer than the lookahead.
+ */
+
+const int32 kHuffLookupBits = 12;
+
+struct HuffmanLookup
+	{
+
+	int16 diff;
+	uint8 length;
+	uint8 pending;
+
+	};
+
+/*****************************************************************************/
+
+// Builds the lookahead table by replaying the decoding of Figure F.16 for
+// every bit pattern, so that it agrees with HuffDecode even on damaged tables.
+
+static void BuildHuffLookup (const HuffmanTable *htbl,
+							 bool bug16,
+							 HuffmanLookup *lookup)
+	{
+
+	for (int32 index = 0; index < (1 << kHuffLookupBits); index++)
+		{
+
+		HuffmanLookup &entry = lookup [index];
+
+		entry.diff    = 0;
+		entry.length  = 0;
+		entry.pending = 0;
+
+		int32 code = index >> (kHuffLookupBits - 8);
+
+		int32 l = htbl->numbits [code];
+		int32 s = htbl->value   [code];
+
+		if (!l)
+			{
+
+			for (l = 8; l < kHuffLookupBits && code > htbl->maxcode [l]; l++)
+				{
+				code = (code << 1) | ((index >> (kHuffLookupBits - 1 - l)) & 1);
+				}
+
+			if (code > htbl->maxcode [l])
+				{
+				continue;
+				}
+
+			s = htbl->huffval [htbl->valptr [l] +
+							   ((int32) (code - htbl->mincode [l]))];
+
+			}
+
+		entry.length = (uint8) l;
+
+		if (s == 0)
+			{
+			continue;
+			}
+
+		if (s == 16 && !bug16)
+			{
+			entry.diff = -32768;
+			continue;
+			}
+
+		if (l + s > kHuffLookupBits)
+			{
+			entry.pending = (uint8) s;
+			continue;
+			}
+
+		int32 d = (index >> (kHuffLookupBits - l - s)) & ((1 << s) - 1);
+
+		if (d < (1 << (s - 1)))
+			{
+			d += 1 - (1 << s);
+			}
+
+		entry.diff   = (int16) d;
+		entry.length = (uint8) (l + s);
+
+		}
+
+	}
+
+/*****************************************************************************/
+
 /*
  * The following structure stores basic information about one component.
  */
@@ -334,6 +436,11 @@ struct DecompressInfo
      */
     HuffmanTable *dcHuffTblPtrs[4];
 
+    /*
+     * matching lookahead tables, built by HuffDecoderInit
+     */
+    HuffmanLookup *dcLookupPtrs[4];
+
     /* 
      * prediction selection value (PSV) and point transform parameter (Pt)
      */
@@ -378,6 +485,8 @@ class dng_lossless_decoder: private dng_uncopyable
 
 		dng_memory_data huffmanBuffer [4];
 		
+		dng_memory_data lookupBuffer [4];
+		
 		dng_memory_data compInfoBuffer;
 		
 		DecompressInfo info;
@@ -392,11 +501,22 @@ class dng_lossless_decoder: private dng_uncopyable
 		
 		uint64 getBuffer;			// current bit-extraction buffer
 		int32 bitsLeft;				// # of unused bits in it
+		
+		dng_memory_data dataBuffer;
+		
+		const uint8 *fData;			// Entropy coded data held in memory,
+		const uint8 *fDataPtr;		// NULL while reading from fStream.
+		const uint8 *fDataEnd;
+		
+		int32 fPadBits;				// Zero bits stuffed in place of data
+									// (saturating, only compared to bitsLeft).
 				
 		#if qSupportHasselblad_3FR
 		bool fHasselblad3FR;
 		#endif
 
+		friend class dng_lossless_restart_task;
+
 	public:
 	
 		dng_lossless_decoder (dng_stream *stream,
@@ -407,7 +527,8 @@ class dng_lossless_decoder: private dng_uncopyable
 						uint32 &imageHeight,
 						uint32 &imageChannels);
 
-		void FinishRead ();
+		void FinishRead (uint64 endOfData,
+						 dng_host *host);
 		
 		#if qSupportHasselblad_3FR
 	
@@ -422,12 +543,34 @@ class dng_lossless_decoder: private dng_uncopyable
 
 		uint8 GetJpegChar ()
 			{
+			
+			if (fData)
+				{
+				
+				if (fDataPtr == fDataEnd)
+					{
+					ThrowEndOfFile ();
+					}
+					
+				return *fDataPtr++;
+				
+				}
+				
 			return fStream->Get_uint8 ();
+			
 			}
 			
 		void UnGetJpegChar ()
 			{
+			
+			if (fData)
+				{
+				fDataPtr--;
+				return;
+				}
+				
 			fStream->SetReadPosition (fStream->Position () - 1);
+			
 			}
 			
 		uint16 Get2bytes ();
@@ -467,6 +610,8 @@ class dng_lossless_decoder: private dng_uncopyable
 
 		void FillBitBuffer (int32 nbits);
 
+		void FillBitBufferFromData (int32 nbits);
+
 		int32 show_bits8 ();
 
 		void flush_bits (int32 nbits);
@@ -479,6 +624,9 @@ class dng_lossless_decoder: private dng_uncopyable
 
 		void HuffExtend (int32 &x, int32 s);
 
+		int32 DecodeDiff (HuffmanTable *htbl,
+						  const HuffmanLookup *lookup);
+
 		void PmPutRow (MCU *buf,
 					   int32 numComp,
 					   int32 numCol,
@@ -488,6 +636,17 @@ class dng_lossless_decoder: private dng_uncopyable
 
 		void DecodeImage ();
 		
+		bool HasStandardLayout () const;
+		
+		void StartInterval (const DecompressInfo &scanInfo);
+		
+		void DecodeInterval (const uint8 *data,
+							 const uint8 *dataEnd,
+							 int32 rows,
+							 dng_spooler &spooler);
+		
+		bool DecodeRestartIntervals (dng_host &host);
+		
 	};
 
 /*****************************************************************************/
@@ -510,6 +669,11 @@ dng_lossless_decoder::dng_lossless_decoder (dng_stream *stream,
 	,	mcuROW2		   (NULL)
 	,	getBuffer      (0)
 	,	bitsLeft	   (0)
+	,	dataBuffer	   ()
+	,	fData		   (NULL)
+	,	fDataPtr	   (NULL)
+	,	fDataEnd	   (NULL)
+	,	fPadBits	   (0)
 	
 	#if qSupportHasselblad_3FR
 	,	fHasselblad3FR (false)
@@ -1297,6 +1461,17 @@ void dng_lossless_decoder::HuffDecoderInit ()
 		// big deal
 
 		FixHuffTbl (info.dcHuffTblPtrs [compptr->dcTblNo]);
+		
+		// Likewise for the lookahead table.
+		
+		lookupBuffer [compptr->dcTblNo].Allocate (1 << kHuffLookupBits,
+												  sizeof (HuffmanLookup));
+		
+		info.dcLookupPtrs [compptr->dcTblNo] = (HuffmanLookup *) lookupBuffer [compptr->dcTblNo].Buffer ();
+		
+		BuildHuffLookup (info.dcHuffTblPtrs [compptr->dcTblNo],
+						 fBug16,
+						 info.dcLookupPtrs [compptr->dcTblNo]);
 
 	    }
 
@@ -1331,7 +1506,23 @@ void dng_lossless_decoder::ProcessRestart ()
 	
 	// Throw away and unused odd bits in the bit buffer.
 	
-	fStream->SetReadPosition (fStream->Position () - bitsLeft / 8);
+	if (fData)
+		{
+		
+		// Stuffed zeroes never came from the data.
+		
+		int32 unusedBytes = Max_int32 (bitsLeft - fPadBits, 0) / 8;
+		
+		fDataPtr -= Min_int32 (unusedBytes, (int32) (fDataPtr - fData));
+		
+		fPadBits = 0;
+		
+		}
+		
+	else
+		{
+		fStream->SetReadPosition (fStream->Position () - bitsLeft / 8);
+		}
 	
 	bitsLeft  = 0;
 	getBuffer = 0;
@@ -1468,6 +1659,12 @@ inline int32 dng_lossless_decoder::QuickPredict (int32 col,
 inline void dng_lossless_decoder::FillBitBuffer (int32 nbits)
 	{
 	
+	if (fData)
+		{
+		FillBitBufferFromData (nbits);
+		return;
+		}
+	
 	const int32 kMinGetBits = sizeof (uint32) * 8 - 7;
 	
 	#if qSupportHasselblad_3FR
@@ -1583,6 +1780,96 @@ inline void dng_lossless_decoder::FillBitBuffer (int32 nbits)
 
 /*****************************************************************************/
 
+/*
+ *--------------------------------------------------------------
+ *
+ * FillBitBufferFromData --
+ *
+ *	FillBitBuffer for entropy coded data held in memory. Fills
+ *	the whole 64-bit buffer, four bytes at a time as long as
+ *	none of them is 0xFF. The end of the data is handled like
+ *	a marker.
+ *
+ *--------------------------------------------------------------
+ */
+
+void dng_lossless_decoder::FillBitBufferFromData (int32 nbits)
+	{
+	
+	const int32 kMinGetBits = sizeof (uint64) * 8 - 7;
+	
+	while (bitsLeft <= 32 && fDataEnd - fDataPtr >= 4)
+		{
+		
+		uint32 w = ((uint32) fDataPtr [0] << 24) |
+				   ((uint32) fDataPtr [1] << 16) |
+				   ((uint32) fDataPtr [2] <<  8) |
+				   ((uint32) fDataPtr [3]      );
+				   
+		// Any 0xFF byte (stuffed or marker) takes the slow path below.
+		
+		if ((~w - 0x01010101) & w & 0x80808080)
+			{
+			break;
+			}
+			
+		getBuffer = (getBuffer << 32) | w;
+		
+		bitsLeft += 32;
+		
+		fDataPtr += 4;
+		
+		}
+	
+    while (bitsLeft < kMinGetBits)
+    	{
+    	
+    	int32 c = 0;
+    	
+    	if (fDataPtr == fDataEnd)
+    		{
+    		
+			if (bitsLeft >= nbits)
+			    break;
+			    
+			fPadBits = Min_int32 (fPadBits + 8, 128);
+    		
+    		}
+    		
+    	else if (fDataPtr [0] != 0xFF)
+    		{
+    		c = *fDataPtr++;
+    		}
+    		
+    	else if (fDataEnd - fDataPtr >= 2 && fDataPtr [1] == 0)
+    		{
+    		c = 0xFF;
+    		fDataPtr += 2;
+    		}
+    		
+    	else
+    		{
+    		
+    		// A marker: leave it in place, and stuff zeroes if the
+    		// data segment runs short, as FillBitBuffer does.
+    		
+			if (bitsLeft >= nbits)
+			    break;
+			    
+			fPadBits = Min_int32 (fPadBits + 8, 128);
+			    
+    		}
+			
+		getBuffer = (getBuffer << 8) | c;
+		
+		bitsLeft += 8;
+		
+   		}
+ 
+	}
+
+/*****************************************************************************/
+
 inline int32 dng_lossless_decoder::show_bits8 ()
 	{
 	
@@ -1728,6 +2015,77 @@ inline void dng_lossless_decoder::HuffExtend (int32 &x, int32 s)
 
 /*****************************************************************************/
 
+/*
+ *--------------------------------------------------------------
+ *
+ * DecodeDiff --
+ *
+ *	Section F.2.2.1: decode the difference. Short codes are
+ *	resolved together with their extra bits by a single
+ *	lookahead table access; long ones fall back to HuffDecode.
+ *
+ * Results:
+ *	The difference.
+ *
+ * Side effects:
+ *	Bitstream is parsed.
+ *
+ *--------------------------------------------------------------
+ */
+
+inline int32 dng_lossless_decoder::DecodeDiff (HuffmanTable *htbl,
+											   const HuffmanLookup *lookup)
+	{
+	
+	if (bitsLeft < kHuffLookupBits)
+		FillBitBuffer (kHuffLookupBits);
+		
+	const HuffmanLookup &entry = lookup [(getBuffer >> (bitsLeft - kHuffLookupBits)) &
+										 ((1 << kHuffLookupBits) - 1)];
+	
+	int32 s;
+	
+	if (entry.length)
+		{
+		
+		flush_bits (entry.length);
+		
+		if (!entry.pending)
+			{
+			return entry.diff;
+			}
+			
+		s = entry.pending;
+		
+		}
+		
+	else
+		{
+		
+		s = HuffDecode (htbl);
+		
+		if (!s)
+			{
+			return 0;
+			}
+			
+		}
+		
+	if (s == 16 && !fBug16)
+		{
+		return -32768;
+		}
+		
+	int32 d = get_bits (s);
+	
+	HuffExtend (d, s);
+	
+	return d;
+	
+	}
+
+/*****************************************************************************/
+
 // Called from DecodeImage () to write one row.
  
 void dng_lossless_decoder::PmPutRow (MCU *buf,
@@ -1783,25 +2141,7 @@ void dng_lossless_decoder::DecodeFirstRow (MCU *curRowBuf)
 
         // Section F.2.2.1: decode the difference
 
-  		int32 d = 0;
-	
-        int32 s = HuffDecode (dctbl);
-        
-      	if (s)
-      		{
-      		
-      		if (s == 16 && !fBug16)
-      			{
-      			d = -32768;
-      			}
-      		
-      		else
-      			{
-				d = get_bits (s);
-            	HuffExtend (d, s);
-            	}
-
-            }
+  		int32 d = DecodeDiff (dctbl, info.dcLookupPtrs [compptr->dcTblNo]);
 
 		// Add the predictor to the difference.
 
@@ -1830,25 +2170,7 @@ void dng_lossless_decoder::DecodeFirstRow (MCU *curRowBuf)
 
 			// Section F.2.2.1: decode the difference
 
-	  		int32 d = 0;
-		
-	        int32 s = HuffDecode (dctbl);
-	        
-	      	if (s)
-	      		{
-
-	      		if (s == 16 && !fBug16)
-	      			{
-	      			d = -32768;
-	      			}
-	      		
-	      		else
-	      			{
-					d = get_bits (s);
-	            	HuffExtend (d, s);
-	            	}
-
-	            }
+	  		int32 d = DecodeDiff (dctbl, info.dcLookupPtrs [compptr->dcTblNo]);
 	            
 			// Add the predictor to the difference.
 
@@ -1899,8 +2221,11 @@ void dng_lossless_decoder::DecodeImage ()
     // Precompute the decoding table for each table.
     
     HuffmanTable *ht [4];
+    
+    const HuffmanLookup *lt [4];
 
 	memset (ht, 0, sizeof (ht));
+	memset (lt, 0, sizeof (lt));
     
 	for (int32 curComp = 0; curComp < compsInScan; curComp++)
     	{
@@ -1910,6 +2235,7 @@ void dng_lossless_decoder::DecodeImage ()
         JpegComponentInfo *compptr = info.curCompInfo [ci];
         
         ht [curComp] = info.dcHuffTblPtrs [compptr->dcTblNo];
+        lt [curComp] = info.dcLookupPtrs  [compptr->dcTblNo];
 
    		}
 		
@@ -2423,25 +2749,7 @@ void dng_lossless_decoder::DecodeImage ()
         	
 	        // Section F.2.2.1: decode the difference
 
-	  		int32 d = 0;
-		
-	        int32 s = HuffDecode (ht [curComp]);
-	        
-	      	if (s)
-	      		{
-
-	      		if (s == 16 && !fBug16)
-	      			{
-	      			d = -32768;
-	      			}
-	      		
-	      		else
-	      			{
-					d = get_bits (s);
-	            	HuffExtend (d, s);
-	            	}
-
-	            }
+	  		int32 d = DecodeDiff (ht [curComp], lt [curComp]);
 	            
 	        // First column of row above is predictor for first column.
 
@@ -2466,49 +2774,8 @@ void dng_lossless_decoder::DecodeImage ()
 			for (int32 col = 1; col < numCOL; col++)
 	        	{
 	        	
-		        int32 s = HuffDecode (ht [0]);
-		        
-		      	if (s)
-		      		{
-		      		
-		      		int32 d;
-
-		      		if (s == 16 && !fBug16)
-		      			{
-		      			d = -32768;
-		      			}
-		      		
-		      		else
-		      			{
-						d = get_bits (s);
-		            	HuffExtend (d, s);
-		            	}
-
-		        	prev0 += d;
-		        	
-		            }
-		            
-		        s = HuffDecode (ht [1]);
-		        
-		      	if (s)
-		      		{
-		      		
-		      		int32 d;
-
-		      		if (s == 16 && !fBug16)
-		      			{
-		      			d = -32768;
-		      			}
-		      		
-		      		else
-		      			{
-						d = get_bits (s);
-		            	HuffExtend (d, s);
-		            	}
-
-					prev1 += d;
-					
-		            }
+	        	prev0 += DecodeDiff (ht [0], lt [0]);
+	        	prev1 += DecodeDiff (ht [1], lt [1]);
 		        
 				dPtr [0] = (uint16) prev0;
 				dPtr [1] = (uint16) prev1;
@@ -2530,25 +2797,7 @@ void dng_lossless_decoder::DecodeImage ()
 	            	
 		 	        // Section F.2.2.1: decode the difference
 
-			  		int32 d = 0;
-				
-			        int32 s = HuffDecode (ht [curComp]);
-			        
-			      	if (s)
-			      		{
-			      		
-			      		if (s == 16 && !fBug16)
-			      			{
-			      			d = -32768;
-			      			}
-			      		
-			      		else
-			      			{
-							d = get_bits (s);
-			            	HuffExtend (d, s);
-			            	}
-
-			            }
+			  		int32 d = DecodeDiff (ht [curComp], lt [curComp]);
 			            
 			        // Predict the pixel value.
 		            
@@ -2579,39 +2828,478 @@ void dng_lossless_decoder::DecodeImage ()
 
 /*****************************************************************************/
 
-void dng_lossless_decoder::StartRead (uint32 &imageWidth,
-								      uint32 &imageHeight,
-								      uint32 &imageChannels)
-	{ 
+// False for the vendor specific layouts that DecodeImage handles with loops
+// of their own, which stay on the stream reader.
+
+bool dng_lossless_decoder::HasStandardLayout () const
+	{
 	
-	ReadFileHeader    ();
-	ReadScanHeader    ();
-	DecoderStructInit ();
-	HuffDecoderInit   ();
+	#if qSupportCanon_sRAW
 	
-	imageWidth    = info.imageWidth;
-	imageHeight   = info.imageHeight;
-	imageChannels = info.compsInScan;
+	if (info.compInfo [0].hSampFactor == 2)
+		{
+		return false;
+		}
+		
+	#endif
+	
+	#if qSupportHasselblad_3FR
+	
+	if (info.Ss == 8)
+		{
+		return false;
+		}
+		
+	#endif
+	
+	return true;
 	
 	}
 
 /*****************************************************************************/
 
-void dng_lossless_decoder::FinishRead ()
+// Prepares a decoder for restart intervals of the scan described by
+// scanInfo, which it shares the Huffman tables with.
+
+void dng_lossless_decoder::StartInterval (const DecompressInfo &scanInfo)
 	{
 	
-	DecodeImage ();
-		
+	info = scanInfo;
+	
+	info.restartInterval = 0;
+	info.restartInRows   = 0;
+	info.restartRowsToGo = 0;
+	info.nextRestartNum  = 0;
+	
+	DecoderStructInit ();
+	
 	}
 
 /*****************************************************************************/
 
-void DecodeLosslessJPEG (dng_stream &stream,
-					     dng_spooler &spooler,
-					     uint32 minDecodedSize,
-					     uint32 maxDecodedSize,
-						 bool bug16,
-						 uint64 endOfData)
+// Decodes one restart interval, whose entropy coded data (up to and
+// including the following marker) is given in memory.
+
+void dng_lossless_decoder::DecodeInterval (const uint8 *data,
+										   const uint8 *dataEnd,
+										   int32 rows,
+										   dng_spooler &spooler)
+	{
+	
+	fSpooler = &spooler;
+	
+	fData    = data;
+	fDataPtr = data;
+	fDataEnd = dataEnd;
+	
+	getBuffer = 0;
+	bitsLeft  = 0;
+	
+	fPadBits = 0;
+	
+	info.imageHeight = rows;
+	
+	DecodeImage ();
+	
+	if (fDataPtr == fDataEnd && fPadBits > bitsLeft)
+		{
+		ThrowBadFormat ();
+		}
+	
+	}
+
+/*****************************************************************************/
+
+// Writes decoded rows to a fixed block of memory.
+
+class dng_lossless_buffer_spooler: public dng_spooler
+	{
+	
+	private:
+	
+		uint8 *fPtr;
+		uint8 *fEnd;
+		
+	public:
+	
+		dng_lossless_buffer_spooler (uint8 *buffer,
+									 uint32 size)
+		
+			:	fPtr (buffer)
+			,	fEnd (buffer + size)
+			
+			{
+			}
+	
+		virtual void Spool (const void *data,
+							uint32 count)
+			{
+			
+			if (count > (uint32) (fEnd - fPtr))
+				{
+				ThrowBadFormat ();
+				}
+				
+			memcpy (fPtr, data, count);
+			
+			fPtr += count;
+			
+			}
+	
+	};
+
+/*****************************************************************************/
+
+// Decodes a batch of restart intervals, each thread taking the next
+// undecoded interval until none are left. The per-thread decoders (which
+// share the scan's Huffman tables) are owned by the caller and set up on
+// first use, so that they carry over from one batch to the next.
+
+class dng_lossless_restart_task: public dng_area_task
+	{
+	
+	private:
+	
+		const dng_lossless_decoder &fDecoder;
+		
+		AutoPtr<dng_lossless_decoder> *fThreadDecoders;
+		
+		uint32 fThreadCount;
+		
+		const uint8 * const *fIntervalData;
+		
+		uint32 fFirstInterval;
+		uint32 fEndInterval;
+		
+		uint8 *fOutput;
+		
+		uint32 fRowBytes;
+		
+		dng_mutex fMutex;
+		
+		uint32 fNextInterval;
+		
+	public:
+	
+		dng_lossless_restart_task (const dng_lossless_decoder &decoder,
+								   AutoPtr<dng_lossless_decoder> *threadDecoders,
+								   uint32 threadCount,
+								   const uint8 * const *intervalData,
+								   uint32 firstInterval,
+								   uint32 endInterval,
+								   uint8 *output,
+								   uint32 rowBytes)
+		
+			:	dng_area_task ("dng_lossless_restart_task")
+			
+			,	fDecoder	   (decoder)
+			,	fThreadDecoders (threadDecoders)
+			,	fThreadCount   (threadCount)
+			,	fIntervalData  (intervalData)
+			,	fFirstInterval (firstInterval)
+			,	fEndInterval   (endInterval)
+			,	fOutput		   (output)
+			,	fRowBytes	   (rowBytes)
+			,	fMutex		   ("dng_lossless_restart_task")
+			,	fNextInterval  (firstInterval)
+			
+			{
+			
+			fMaxThreads  = threadCount;
+			fMinTaskArea = 16 * 16;
+			fUnitCell    = dng_point (16, 16);
+			fMaxTileSize = dng_point (16, 16);
+			
+			}
+			
+		virtual void Process (uint32 threadIndex,
+							  const dng_rect & /* tile */,
+							  dng_abort_sniffer *sniffer)
+			{
+			
+			const DecompressInfo &scanInfo = fDecoder.info;
+			
+			if (threadIndex >= fThreadCount)
+				{
+				ThrowProgramError ();
+				}
+			
+			AutoPtr<dng_lossless_decoder> &decoder = fThreadDecoders [threadIndex];
+			
+			if (!decoder.Get ())
+				{
+				
+				decoder.Reset (new dng_lossless_decoder (NULL,
+														 NULL,
+														 fDecoder.fBug16));
+										  
+				decoder->StartInterval (scanInfo);
+				
+				}
+			
+			while (true)
+				{
+				
+				uint32 interval;
+				
+					{
+					
+					dng_lock_mutex lock (&fMutex);
+					
+					if (fNextInterval == fEndInterval)
+						{
+						return;
+						}
+						
+					interval = fNextInterval++;
+					
+					}
+					
+				dng_abort_sniffer::SniffForAbort (sniffer);
+				
+				int32 firstRow = (int32) interval * scanInfo.restartInRows;
+				
+				int32 rows = Min_int32 (scanInfo.restartInRows,
+										scanInfo.imageHeight - firstRow);
+				
+				uint32 offset = (interval - fFirstInterval) *
+								(uint32) scanInfo.restartInRows;
+				
+				dng_lossless_buffer_spooler spooler (fOutput + offset * fRowBytes,
+													 rows * fRowBytes);
+				
+				decoder->DecodeInterval (fIntervalData [interval    ],
+										 fIntervalData [interval + 1],
+										 rows,
+										 spooler);
+				
+				}
+			
+			}
+	
+	};
+
+/*****************************************************************************/
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DecodeRestartIntervals --
+ *
+ *	Decode a scan whose restart intervals are whole rows in
+ *	parallel, spooling the rows in batches. The entropy coded
+ *	data must be in memory.
+ *
+ * Results:
+ *	False if the restart markers are not as expected, in which
+ *	case nothing has been decoded.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+bool dng_lossless_decoder::DecodeRestartIntervals (dng_host &host)
+	{
+	
+	const uint32 kBatchBytes = 16 * 1024 * 1024;
+	
+	uint32 intervals = (uint32) ((info.imageHeight + info.restartInRows - 1) /
+								 info.restartInRows);
+	
+	// Locate the RSTn markers. Within entropy coded data a 0xFF byte
+	// is always followed by a stuffed zero, while markers may be
+	// preceded by any number of 0xFF fill bytes.
+	
+	dng_std_vector<const uint8 *> intervalData;
+	
+	intervalData.reserve (intervals + 1);
+	
+	intervalData.push_back (fData);
+	
+	const uint8 *ptr = fData;
+	
+	while (intervalData.size () < intervals)
+		{
+		
+		ptr = (const uint8 *) memchr (ptr, 0xFF, fDataEnd - ptr);
+		
+		if (ptr == NULL || fDataEnd - ptr < 2)
+			{
+			return false;
+			}
+			
+		int32 c = ptr [1];
+		
+		if (c == 0 || c == 0xFF)
+			{
+			ptr++;
+			continue;
+			}
+			
+		if (c != M_RST0 + (int32) ((intervalData.size () - 1) & 7))
+			{
+			return false;
+			}
+			
+		// Each interval's data includes its marker, which stops the
+		// bit reader like any other.
+			
+		ptr += 2;
+		
+		intervalData.push_back (ptr);
+		
+		}
+		
+	intervalData.push_back (fDataEnd);
+	
+	// Decode and spool a batch of intervals at a time.
+	
+	uint32 threadCount = host.PerformAreaTaskThreads ();
+	
+	uint32 rowBytes = (uint32) info.imageWidth *
+					  (uint32) info.compsInScan *
+					  (uint32) sizeof (ComponentType);
+	
+	dng_safe_uint32 intervalBytes = dng_safe_uint32 (rowBytes) *
+									(uint32) info.restartInRows;
+									
+	uint32 batch = Min_uint32 (Max_uint32 (threadCount * 4,
+										   kBatchBytes / intervalBytes.Get ()),
+							   intervals);
+							   
+	dng_memory_data output (intervalBytes * batch);
+	
+	AutoArray<AutoPtr<dng_lossless_decoder> > threadDecoders (new AutoPtr<dng_lossless_decoder> [threadCount]);
+	
+	for (uint32 first = 0; first < intervals; first += batch)
+		{
+		
+		uint32 last = Min_uint32 (first + batch, intervals);
+		
+		dng_lossless_restart_task task (*this,
+										threadDecoders.Get (),
+										threadCount,
+										&intervalData [0],
+										first,
+										last,
+										output.Buffer_uint8 (),
+										rowBytes);
+										
+		host.PerformAreaTask (task,
+							  dng_rect (0, 0, 16, 16 * Min_uint32 (last - first,
+																	 threadCount)));
+																	 
+		uint32 rows = Min_uint32 (last * (uint32) info.restartInRows,
+								  (uint32) info.imageHeight) -
+					  first * (uint32) info.restartInRows;
+		
+		fSpooler->Spool (output.Buffer (),
+						 rows * rowBytes);
+		
+		}
+		
+	fDataPtr = fDataEnd;
+	
+	return true;
+	
+	}
+
+/*****************************************************************************/
+
+void dng_lossless_decoder::StartRead (uint32 &imageWidth,
+								      uint32 &imageHeight,
+								      uint32 &imageChannels)
+	{ 
+	
+	ReadFileHeader    ();
+	ReadScanHeader    ();
+	DecoderStructInit ();
+	HuffDecoderInit   ();
+	
+	imageWidth    = info.imageWidth;
+	imageHeight   = info.imageHeight;
+	imageChannels = info.compsInScan;
+	
+	}
+
+/*****************************************************************************/
+
+void dng_lossless_decoder::FinishRead (uint64 endOfData,
+									   dng_host *host)
+	{
+	
+	// Read the entropy coded data of a standard scan into memory, which
+	// lets the bit reader run without going through the stream, and its
+	// restart intervals, if any, be decoded in parallel.
+	
+	uint64 startOfData = fStream->Position ();
+	
+	uint64 endOfBuffer = Min_uint64 (endOfData, fStream->Length ());
+	
+	if (!HasStandardLayout () ||
+		endOfBuffer <= startOfData ||
+		endOfBuffer - startOfData > 0x7FFFFFFF)
+		{
+		
+		DecodeImage ();
+		
+		return;
+		
+		}
+		
+	uint32 dataSize = (uint32) (endOfBuffer - startOfData);
+	
+	dataBuffer.Allocate (dataSize);
+	
+	fStream->Get (dataBuffer.Buffer (), dataSize);
+	
+	fData    = dataBuffer.Buffer_uint8 ();
+	fDataPtr = fData;
+	fDataEnd = fData + dataSize;
+	
+	bool decoded = false;
+	
+	if (host &&
+		host->PerformAreaTaskThreads () > 1 &&
+		info.restartInRows > 0 &&
+		info.restartInterval == info.restartInRows * info.imageWidth &&
+		info.imageHeight > info.restartInRows)
+		{
+		
+		decoded = DecodeRestartIntervals (*host);
+		
+		}
+		
+	if (!decoded)
+		{
+		
+		DecodeImage ();
+		
+		}
+		
+	// Decoding bits past the end of the data (rather than up to a
+	// marker) is an error, as reading them from the stream would be.
+		
+	if (fDataPtr == fDataEnd && fPadBits > bitsLeft)
+		{
+		ThrowBadFormat ();
+		}
+		
+	fStream->SetReadPosition (startOfData + (uint64) (fDataPtr - fData));
+	
+	}
+
+/*****************************************************************************/
+
+void DecodeLosslessJPEG (dng_stream &stream,
+					     dng_spooler &spooler,
+					     uint32 minDecodedSize,
+					     uint32 maxDecodedSize,
+						 bool bug16,
+						 uint64 endOfData,
+						 dng_host *host)
 	{
 	
 	dng_lossless_decoder decoder (&stream,
@@ -2637,7 +3325,8 @@ void DecodeLosslessJPEG (dng_stream &stream,
 		ThrowBadFormat ();
 		}
 	
-	decoder.FinishRead ();
+	decoder.FinishRead (endOfData,
+						host);
 	
 	uint64 streamPos = stream.Position ();
 	
@@ -2652,21 +3341,380 @@ void DecodeLosslessJPEG (dng_stream &stream,
 		
 		#if qSupportHasselblad_3FR
 		
-		if (decoder.IsHasselblad3FR () &&
-			streamPos - endOfData == 4)
+		if (decoder.IsHasselblad3FR () &&
+			streamPos - endOfData == 4)
+			{
+			throwBadFormat = false;
+			}
+			
+		#endif
+		
+		if (throwBadFormat)
+			{
+			ThrowBadFormat ();
+			}
+		}
+	
+	}
+
+/*****************************************************************************/
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DiffBits --
+ *
+ *	Number of bits needed for the magnitude of a difference
+ *	value, i.e. its category per section F.1.2.1.
+ *
+ *--------------------------------------------------------------
+ */
+
+static inline uint32 DiffBits (uint32 magnitude)
+	{
+	
+	#if defined(__GNUC__)
+	
+	// The shifted-in one bit makes zero map to zero without a branch.
+	
+	return 31 - __builtin_clz ((magnitude << 1) | 1);
+	
+	#else
+	
+	uint32 nbits = 0;
+	
+	if (magnitude >= 256) { nbits += 8; magnitude >>= 8; }
+	if (magnitude >=  16) { nbits += 4; magnitude >>= 4; }
+	if (magnitude >=   4) { nbits += 2; magnitude >>= 2; }
+	if (magnitude >=   2) { nbits += 1; magnitude >>= 1; }
+	
+	return nbits + magnitude;
+	
+	#endif
+	
+	}
+
+/*****************************************************************************/
+
+/*
+ *--------------------------------------------------------------
+ *
+ * CountDiffs --
+ *
+ *      Count the times each category symbol occurs in an image,
+ *      adding to the counts of each channel.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void CountDiffs (const uint16 *srcData,
+						uint32 srcRows,
+						uint32 srcCols,
+						uint32 srcChannels,
+						uint32 srcBitDepth,
+						int32 srcRowStep,
+						int32 srcColStep,
+						uint32 *countTable [4])
+	{
+	
+	DNG_ASSERT ((int32)srcRows >= 0, "CountDiffs: srcRows too large.");
+
+    for (int32 row = 0; row < (int32)srcRows; row++)
+    	{
+    	
+		const uint16 *sPtr = srcData + row * srcRowStep;
+		
+		// Initialize predictors for this row.
+		
+		int32 predictor [4] = { 0, 0, 0, 0 };
+		
+		for (int32 channel = 0; channel < (int32)srcChannels; channel++)
+			{
+			
+			if (row == 0)
+				predictor [channel] = 1 << (srcBitDepth - 1);
+				
+			else
+				predictor [channel] = sPtr [channel - srcRowStep];
+			
+			}
+			
+		// Unroll most common case of two channels
+		
+		if (srcChannels == 2)
+			{
+			
+			int32 pred0 = predictor [0];
+			int32 pred1 = predictor [1];
+			
+			uint32 *count0 = countTable [0];
+			uint32 *count1 = countTable [1];
+			
+	    	for (uint32 col = 0; col < srcCols; col++)
+	    		{
+	    		
+    			int32 pixel0 = sPtr [0];
+				int32 pixel1 = sPtr [1];
+    			
+    			int32 diff0 = (int16) (pixel0 - pred0);
+    			int32 diff1 = (int16) (pixel1 - pred1);
+    			
+    			int32 sign0 = diff0 >> 31;
+    			int32 sign1 = diff1 >> 31;
+    			
+    			count0 [DiffBits ((uint32) ((diff0 ^ sign0) - sign0))] ++;
+    			count1 [DiffBits ((uint32) ((diff1 ^ sign1) - sign1))] ++;
+    			
+    			pred0 = pixel0;
+   				pred1 = pixel1;
+	    			
+	    		sPtr += srcColStep;
+	    			
+	    		}
+			
+			}
+			
+		// General case.
+			
+		else
+			{
+			
+	    	for (uint32 col = 0; col < srcCols; col++)
+	    		{
+	    		
+	    		for (uint32 channel = 0; channel < srcChannels; channel++)
+	    			{
+	    			
+	    			int32 pixel = sPtr [channel];
+	    			
+	    			int32 diff = (int16) (pixel - predictor [channel]);
+	    			
+	    			int32 sign = diff >> 31;
+	    			
+	    			countTable [channel] [DiffBits ((uint32) ((diff ^ sign) - sign))] ++;
+	    			
+	    			predictor [channel] = pixel;
+	    			
+	    			}
+	    			
+	    		sPtr += srcColStep;
+	    			
+	    		}
+	    		
+	    	}
+    		
+    	}
+
+	}
+
+/*****************************************************************************/
+
+dng_lossless_jpeg_tables::dng_lossless_jpeg_tables ()
+
+	:	fChannels (0)
+	,	fFrozen   (false)
+	
+	{
+	
+	memset (fCount, 0, sizeof (fCount));
+	
+	}
+
+/*****************************************************************************/
+
+void dng_lossless_jpeg_tables::AddSample (const uint16 *srcData,
+										  uint32 srcRows,
+										  uint32 srcCols,
+										  uint32 srcChannels,
+										  uint32 srcBitDepth,
+										  int32 srcRowStep,
+										  int32 srcColStep)
+	{
+	
+	DNG_REQUIRE (!fFrozen, "dng_lossless_jpeg_tables::AddSample: tables are frozen.");
+	
+	DNG_REQUIRE (srcChannels >= 1 && srcChannels <= 4 &&
+				 (fChannels == 0 || fChannels == srcChannels),
+				 "dng_lossless_jpeg_tables::AddSample: bad channel count.");
+	
+	fChannels = srcChannels;
+	
+	uint32 *countTable [4] = { fCount [0], fCount [1], fCount [2], fCount [3] };
+	
+	CountDiffs (srcData,
+				srcRows,
+				srcCols,
+				srcChannels,
+				srcBitDepth,
+				srcRowStep,
+				srcColStep,
+				countTable);
+	
+	}
+
+/*****************************************************************************/
+
+void dng_lossless_jpeg_tables::Freeze ()
+	{
+	
+	// Categories that did not occur in the sample may still occur in
+	// other tiles, so all of them need a code.
+	
+	for (uint32 channel = 0; channel < 4; channel++)
+		{
+		
+		for (uint32 nbits = 0; nbits <= 16; nbits++)
+			{
+			
+			fCount [channel] [nbits] ++;
+			
+			}
+			
+		}
+	
+	fFrozen = true;
+	
+	}
+
+/*****************************************************************************/
+
+// Accumulates Huffman codes in a 64-bit buffer and writes them, byte
+// stuffed, to a local buffer that goes to the stream in large blocks.
+
+class dng_lossless_bit_writer
+	{
+	
+	private:
+	
+		enum
+			{
+			kBufferSize = 4096
+			};
+	
+		dng_stream &fStream;
+		
+		// Valid bits are right-justified in fBitBuffer. Put writes out
+		// whole 32-bit words, so fewer than 32 bits are retained between
+		// calls and each call can add up to 32 bits.
+		
+		uint64 fBitBuffer;
+		uint32 fBitCount;
+		
+		uint32 fByteCount;
+		
+		// Each word needs up to 8 bytes with byte stuffing.
+		
+		uint8 fBuffer [kBufferSize + 8];
+		
+	public:
+	
+		explicit dng_lossless_bit_writer (dng_stream &stream)
+		
+			:	fStream     (stream)
+			,	fBitBuffer  (0)
+			,	fBitCount   (0)
+			,	fByteCount  (0)
+			
+			{
+			}
+			
+		inline void Put (uint32 code, uint32 size)
+			{
+			
+			DNG_ASSERT (size <= 32, "Bad code size");
+			
+			fBitBuffer = (fBitBuffer << size) | code;
+			fBitCount += size;
+			
+			if (fBitCount >= 32)
+				{
+				
+				fBitCount -= 32;
+				
+				PutWord ((uint32) (fBitBuffer >> fBitCount));
+				
+				}
+			
+			}
+			
+		// Pads the last byte with one bits and writes everything out.
+		
+		void Flush ()
 			{
-			throwBadFormat = false;
+			
+			Put (0x007F, 7);
+			
+			while (fBitCount >= 8)
+				{
+				
+				fBitCount -= 8;
+				
+				PutByte ((uint8) (fBitBuffer >> fBitCount));
+				
+				}
+				
+			fBitBuffer = 0;
+			fBitCount  = 0;
+			
+			fStream.Put (fBuffer, fByteCount);
+			
+			fByteCount = 0;
+			
 			}
 			
-		#endif
-		
-		if (throwBadFormat)
+	private:
+	
+		inline void PutByte (uint8 value)
 			{
-			ThrowBadFormat ();
+			
+			fBuffer [fByteCount++] = value;
+			
+			if (value == 0xFF)
+				{
+				fBuffer [fByteCount++] = 0;
+				}
+				
+			}
+			
+		inline void PutWord (uint32 word)
+			{
+			
+			// Test for any 0xFF byte, which needs stuffing.
+			
+			if ((((~word) - 0x01010101) & word & 0x80808080) == 0)
+				{
+				
+				fBuffer [fByteCount    ] = (uint8) (word >> 24);
+				fBuffer [fByteCount + 1] = (uint8) (word >> 16);
+				fBuffer [fByteCount + 2] = (uint8) (word >>  8);
+				fBuffer [fByteCount + 3] = (uint8) (word      );
+				
+				fByteCount += 4;
+				
+				}
+				
+			else
+				{
+				
+				PutByte ((uint8) (word >> 24));
+				PutByte ((uint8) (word >> 16));
+				PutByte ((uint8) (word >>  8));
+				PutByte ((uint8) (word      ));
+				
+				}
+				
+			if (fByteCount >= kBufferSize)
+				{
+				
+				fStream.Put (fBuffer, fByteCount);
+				
+				fByteCount = 0;
+				
+				}
+				
 			}
-		}
 	
-	}
+	};
 
 /*****************************************************************************/
 
@@ -2686,20 +3734,13 @@ class dng_lossless_encoder
 		int32 fSrcColStep;
 	
 		dng_stream &fStream;
+		
+		const dng_lossless_jpeg_tables *fTables;
 	
 		HuffmanTable huffTable [4];
 		
 		uint32 freqCount [4] [257];
 		
-		// Current bit-accumulation buffer
-
-		int32 huffPutBuffer;
-		int32 huffPutBits;
-		
-		// Lookup table for number of bits in an 8 bit value.
-		
-		int numBitsTable [256];
-		
 	public:
 	
 		dng_lossless_encoder (const uint16 *srcData,
@@ -2709,7 +3750,8 @@ class dng_lossless_encoder
 					 	      uint32 srcBitDepth,
 					 	      int32 srcRowStep,
 					 	      int32 srcColStep,
-					 	      dng_stream &stream);
+					 	      dng_stream &stream,
+					 	      const dng_lossless_jpeg_tables *tables);
 		
 		void Encode ();
 		
@@ -2717,13 +3759,9 @@ class dng_lossless_encoder
 	
 		void EmitByte (uint8 value);
 	
-		void EmitBits (int code, int size);
-
-		void FlushBits ();
-
-		void CountOneDiff (int diff, uint32 *countTable);
-
-		void EncodeOneDiff (int diff, HuffmanTable *dctbl);
+		void EncodeOneDiff (int32 diff,
+							const HuffmanTable *dctbl,
+							dng_lossless_bit_writer &writer);
 		
 		void FreqCountSet ();
 
@@ -2760,7 +3798,8 @@ dng_lossless_encoder::dng_lossless_encoder (const uint16 *srcData,
 											uint32 srcBitDepth,
 											int32 srcRowStep,
 											int32 srcColStep,
-											dng_stream &stream)
+											dng_stream &stream,
+											const dng_lossless_jpeg_tables *tables)
 								    
 	:	fSrcData     (srcData    )
 	,	fSrcRows     (srcRows    )
@@ -2770,30 +3809,19 @@ dng_lossless_encoder::dng_lossless_encoder (const uint16 *srcData,
 	,	fSrcRowStep  (srcRowStep )
 	,	fSrcColStep  (srcColStep )
 	,	fStream      (stream     )
-	
-	,	huffPutBuffer (0)
-	,	huffPutBits   (0)
+	,	fTables      (tables     )
 	
 	{
 	
-    // Initialize number of bits lookup table.
-    
-    numBitsTable [0] = 0;
-    	
-    for (int i = 1; i < 256; i++)
-    	{
-    	
-		int temp = i;
-		int nbits = 1;
+	// Only use shared tables made for this layout.
+	
+	if (fTables && (!fTables->IsFrozen () ||
+					 fTables->Channels () != fSrcChannels))
+		{
 		
-		while (temp >>= 1)
-			{
-	    	nbits++;
-			}
-			
-		numBitsTable [i] = nbits;
+		fTables = NULL;
 		
-    	}
+		}
     	
 	}
 
@@ -2808,149 +3836,14 @@ inline void dng_lossless_encoder::EmitByte (uint8 value)
 	
 /*****************************************************************************/
 
-/*
- *--------------------------------------------------------------
- *
- * EmitBits --
- *
- *	Code for outputting bits to the file
- *
- *	Only the right 24 bits of huffPutBuffer are used; the valid
- *	bits are left-justified in this part.  At most 16 bits can be
- *	passed to EmitBits in one call, and we never retain more than 7
- *	bits in huffPutBuffer between calls, so 24 bits are
- *	sufficient.
- *
- * Results:
- *	None.
- *
- * Side effects:
- *	huffPutBuffer and huffPutBits are updated.
- *
- *--------------------------------------------------------------
- */
- 
-inline void dng_lossless_encoder::EmitBits (int code, int size)
-	{
-	
-    DNG_ASSERT (size != 0, "Bad Huffman table entry");
-
-    int putBits   = size;
-	int putBuffer = code;
-    
-    putBits += huffPutBits;
-    
-    putBuffer <<= 24 - putBits;
-    putBuffer |= huffPutBuffer;
-
-    while (putBits >= 8)
-    	{
-    	
-		uint8 c = (uint8) (putBuffer >> 16);
-
-		// Output whole bytes we've accumulated with byte stuffing
-
-		EmitByte (c);
-		
-		if (c == 0xFF)
-			{
-	   	 	EmitByte (0);
-			}
-
-		putBuffer <<= 8;
-		putBits -= 8;
-		
-    	}
-
-    huffPutBuffer = putBuffer;
-    huffPutBits   = putBits;
-    
-	}
-
-/*****************************************************************************/
-
-/*
- *--------------------------------------------------------------
- *
- * FlushBits --
- *
- *	Flush any remaining bits in the bit buffer. Used before emitting
- *	a marker.
- *
- * Results:
- *	None.
- *
- * Side effects:
- *	huffPutBuffer and huffPutBits are reset
- *
- *--------------------------------------------------------------
- */
-
-void dng_lossless_encoder::FlushBits ()
-	{
-	
-    // The first call forces output of any partial bytes.
-
-    EmitBits (0x007F, 7);
-    
-    // We can then zero the buffer.
-
-    huffPutBuffer = 0;
-    huffPutBits   = 0;
-    
-	}
-
-/*****************************************************************************/
-
-/*
- *--------------------------------------------------------------
- *
- * CountOneDiff --
- *
- *      Count the difference value in countTable.
- *
- * Results:
- *      diff is counted in countTable.
- *
- * Side effects:
- *      None. 
- *
- *--------------------------------------------------------------
- */
-
-inline void dng_lossless_encoder::CountOneDiff (int diff, uint32 *countTable)
-	{
-	
-    // Encode the DC coefficient difference per section F.1.2.1
-     
-    int temp = diff;
-    
-    if (temp < 0)
-    	{
-    	
- 		temp = -temp;
- 
-	    }
-
-    // Find the number of bits needed for the magnitude of the coefficient
-
-    int nbits = temp >= 256 ? numBitsTable [temp >> 8  ] + 8
-    						: numBitsTable [temp & 0xFF];
-        	
-    // Update count for this bit length
-
-    countTable [nbits] ++;
-    
-	}
-
-/*****************************************************************************/
-
 /*
  *--------------------------------------------------------------
  *
  * EncodeOneDiff --
  *
- *	Encode a single difference value.
+ *	Encode a single difference value: the Huffman-coded
+ *	symbol for its number of bits and the bits of the value
+ *	itself go out in one call.
  *
  * Results:
  *	None.
@@ -2961,52 +3854,34 @@ inline void dng_lossless_encoder::CountOneDiff (int diff, uint32 *countTable)
  *--------------------------------------------------------------
  */
 
-inline void dng_lossless_encoder::EncodeOneDiff (int diff, HuffmanTable *dctbl)
+inline void dng_lossless_encoder::EncodeOneDiff (int32 diff,
+												 const HuffmanTable *dctbl,
+												 dng_lossless_bit_writer &writer)
 	{
 
-    // Encode the DC coefficient difference per section F.1.2.1
+    // Encode the DC coefficient difference per section F.1.2.1.
+    // sign is all ones for a negative input, giving the magnitude as
+    // (diff ^ sign) - sign, and the bitwise complement of the magnitude
+    // as diff + sign. This code assumes we are on a two's complement
+    // machine.
      
-    int temp  = diff;
-    int temp2 = diff;
+    int32 sign = diff >> 31;
     
-    if (temp < 0)
-    	{
-    	
-		temp = -temp;
-		
-		// For a negative input, want temp2 = bitwise complement of
-		// abs (input).  This code assumes we are on a two's complement
-		// machine.
-
-		temp2--;
-		
-	    }
-
-    // Find the number of bits needed for the magnitude of the coefficient
-
-    int nbits = temp >= 256 ? numBitsTable [temp >> 8  ] + 8
-    						: numBitsTable [temp & 0xFF];
+    uint32 nbits = DiffBits ((uint32) ((diff ^ sign) - sign));
 
-    // Emit the Huffman-coded symbol for the number of bits
-
-    EmitBits (dctbl->ehufco [nbits],
-    		  dctbl->ehufsi [nbits]);
-
-    // Emit that number of bits of the value, if positive,
-    // or the complement of its magnitude, if negative.
-    
     // If the number of bits is 16, there is only one possible difference
     // value (-32786), so the lossless JPEG spec says not to output anything
     // in that case.  So we only need to output the diference value if
     // the number of bits is between 1 and 15.
 
-    if (nbits & 15)
-    	{
-    	
-		EmitBits (temp2 & (0x0FFFF >> (16 - nbits)),
-				  nbits);
-		
-		}
+    uint32 extra = nbits & 15;
+    
+    uint32 value = (uint32) (diff + sign) & ((1u << extra) - 1);
+    
+    DNG_ASSERT (dctbl->ehufsi [nbits] != 0, "Bad Huffman table entry");
+    
+    writer.Put (((uint32) dctbl->ehufco [nbits] << extra) | value,
+    			(uint32) dctbl->ehufsi [nbits] + extra);
 
 	}
 
@@ -3034,88 +3909,34 @@ void dng_lossless_encoder::FreqCountSet ()
     
 	memset (freqCount, 0, sizeof (freqCount));
 	
-	DNG_ASSERT ((int32)fSrcRows >= 0, "dng_lossless_encoder::FreqCountSet: fSrcRpws too large.");
-
-    for (int32 row = 0; row < (int32)fSrcRows; row++)
-    	{
-    	
-		const uint16 *sPtr = fSrcData + row * fSrcRowStep;
-		
-		// Initialize predictors for this row.
+	if (fTables)
+		{
 		
-		int32 predictor [4] = { 0, 0, 0, 0 };
+		// Counts were gathered from sampled tiles.
 		
-		for (int32 channel = 0; channel < (int32)fSrcChannels; channel++)
+		for (uint32 channel = 0; channel < fSrcChannels; channel++)
 			{
 			
-			if (row == 0)
-				predictor [channel] = 1 << (fSrcBitDepth - 1);
-				
-			else
-				predictor [channel] = sPtr [channel - fSrcRowStep];
+			memcpy (freqCount [channel],
+					fTables->Count (channel),
+					17 * sizeof (uint32));
 			
 			}
 			
-		// Unroll most common case of two channels
+		return;
 		
-		if (fSrcChannels == 2)
-			{
-			
-			int32 pred0 = predictor [0];
-			int32 pred1 = predictor [1];
-			
-			uint32 srcCols    = fSrcCols;
-			int32  srcColStep = fSrcColStep;
-			
-	    	for (uint32 col = 0; col < srcCols; col++)
-	    		{
-	    		
-    			int32 pixel0 = sPtr [0];
-				int32 pixel1 = sPtr [1];
-    			
-    			int16 diff0 = (int16) (pixel0 - pred0);
-    			int16 diff1 = (int16) (pixel1 - pred1);
-    			
-    			CountOneDiff (diff0, freqCount [0]);
-    			CountOneDiff (diff1, freqCount [1]);
-    			
-    			pred0 = pixel0;
-   				pred1 = pixel1;
-	    			
-	    		sPtr += srcColStep;
-	    			
-	    		}
-			
-			}
-			
-		// General case.
-			
-		else
-			{
-			
-	    	for (uint32 col = 0; col < fSrcCols; col++)
-	    		{
-	    		
-	    		for (uint32 channel = 0; channel < fSrcChannels; channel++)
-	    			{
-	    			
-	    			int32 pixel = sPtr [channel];
-	    			
-	    			int16 diff = (int16) (pixel - predictor [channel]);
-	    			
-	    			CountOneDiff (diff, freqCount [channel]);
-	    			
-	    			predictor [channel] = pixel;
-	    			
-	    			}
-	    			
-	    		sPtr += fSrcColStep;
-	    			
-	    		}
-	    		
-	    	}
-    		
-    	}
+		}
+	
+	uint32 *countTable [4] = { freqCount [0], freqCount [1], freqCount [2], freqCount [3] };
+	
+	CountDiffs (fSrcData,
+				fSrcRows,
+				fSrcCols,
+				fSrcChannels,
+				fSrcBitDepth,
+				fSrcRowStep,
+				fSrcColStep,
+				countTable);
 
 	}
 
@@ -3141,6 +3962,8 @@ void dng_lossless_encoder::HuffEncode ()
 	{
     
 	DNG_ASSERT ((int32)fSrcRows >= 0, "dng_lossless_encoder::HuffEncode: fSrcRows too large.");
+	
+	dng_lossless_bit_writer writer (fStream);
 
 	for (int32 row = 0; row < (int32)fSrcRows; row++)
     	{
@@ -3179,11 +4002,8 @@ void dng_lossless_encoder::HuffEncode ()
     			int32 pixel0 = sPtr [0];
 				int32 pixel1 = sPtr [1];
     			
-    			int16 diff0 = (int16) (pixel0 - pred0);
-    			int16 diff1 = (int16) (pixel1 - pred1);
-    			
-    			EncodeOneDiff (diff0, &huffTable [0]);
-   				EncodeOneDiff (diff1, &huffTable [1]);
+    			EncodeOneDiff ((int16) (pixel0 - pred0), &huffTable [0], writer);
+   				EncodeOneDiff ((int16) (pixel1 - pred1), &huffTable [1], writer);
     			
     			pred0 = pixel0;
    				pred1 = pixel1;
@@ -3207,9 +4027,7 @@ void dng_lossless_encoder::HuffEncode ()
 	    			
 	    			int32 pixel = sPtr [channel];
 	    			
-	    			int16 diff = (int16) (pixel - predictor [channel]);
-	    			
-    				EncodeOneDiff (diff, &huffTable [channel]);
+    				EncodeOneDiff ((int16) (pixel - predictor [channel]), &huffTable [channel], writer);
 	    			
 	    			predictor [channel] = pixel;
 	    			
@@ -3223,7 +4041,7 @@ void dng_lossless_encoder::HuffEncode ()
     		
     	}
   
-    FlushBits ();
+    writer.Flush ();
     
 	}
 
@@ -3825,7 +4643,8 @@ void EncodeLosslessJPEG (const uint16 *srcData,
 						 uint32 srcBitDepth,
 						 int32 srcRowStep,
 						 int32 srcColStep,
-						 dng_stream &stream)
+						 dng_stream &stream,
+						 const dng_lossless_jpeg_tables *tables)
 	{
 	
 	dng_lossless_encoder encoder (srcData,
@@ -3835,7 +4654,8 @@ void EncodeLosslessJPEG (const uint16 *srcData,
 							      srcBitDepth,
 							      srcRowStep,
 							      srcColStep,
-							      stream);
+							      stream,
+							      tables);
 
 	encoder.Encode ();
 	
@@ -40,15 +40,79 @@ class dng_spooler
 						   
 /*****************************************************************************/
 
+/// Decodes a tile. Given a host, a tile with whole-row restart intervals
+/// has these decoded in parallel on the host's area task threads.
+
 void DecodeLosslessJPEG (dng_stream &stream,
 					     dng_spooler &spooler,
 					     uint32 minDecodedSize,
 					     uint32 maxDecodedSize,
 						 bool bug16,
-						 uint64 endOfData);
+						 uint64 endOfData,
+						 dng_host *host = NULL);
 						   
 /*****************************************************************************/
 
+/// \brief Huffman statistics shared by the lossless JPEG encodes of an image's tiles.
+///
+/// By default every tile gets optimal Huffman tables of its own, which takes
+/// a statistics pass over the tile before it is encoded. Gathering the
+/// statistics from a sample of tiles instead lets every tile be encoded in a
+/// single pass, at the cost of slightly larger output.
+
+class dng_lossless_jpeg_tables
+	{
+	
+	private:
+	
+		uint32 fChannels;
+		
+		uint32 fCount [4] [17];
+		
+		bool fFrozen;
+		
+	public:
+	
+		dng_lossless_jpeg_tables ();
+		
+		/// Adds the difference statistics of one tile (same layout as
+		/// passed to EncodeLosslessJPEG).
+		
+		void AddSample (const uint16 *srcData,
+						uint32 srcRows,
+						uint32 srcCols,
+						uint32 srcChannels,
+						uint32 srcBitDepth,
+						int32 srcRowStep,
+						int32 srcColStep);
+						
+		/// Ends sampling. Every difference category gets a code, even those
+		/// not seen in the sampled tiles.
+		
+		void Freeze ();
+		
+		bool IsFrozen () const
+			{
+			return fFrozen;
+			}
+			
+		uint32 Channels () const
+			{
+			return fChannels;
+			}
+			
+		const uint32 * Count (uint32 channel) const
+			{
+			return fCount [channel];
+			}
+			
+	};
+	
+/*****************************************************************************/
+
+/// Encodes a tile. With frozen tables of the same channel count, these are
+/// used instead of tables optimal for the tile.
+
 void EncodeLosslessJPEG (const uint16 *srcData,
 						 uint32 srcRows,
 						 uint32 srcCols,
@@ -56,7 +120,8 @@ void EncodeLosslessJPEG (const uint16 *srcData,
 						 uint32 srcBitDepth,
 						 int32 srcRowStep,
 						 int32 srcColStep,
-						 dng_stream &stream);
+						 dng_stream &stream,
+						 const dng_lossless_jpeg_tables *tables = NULL);
 						 
 /*****************************************************************************/
 
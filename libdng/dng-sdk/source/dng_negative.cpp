@@ -1653,7 +1653,7 @@ class dng_find_new_raw_image_digest_task : public dng_area_task
 		
 		AutoArray<dng_fingerprint> fTileHash;
 		
-		AutoPtr<dng_memory_block> fBufferData [kMaxMPThreads];
+		AutoArray<AutoPtr<dng_memory_block> > fBufferData;
 	
 	public:
 	
@@ -1706,6 +1706,8 @@ class dng_find_new_raw_image_digest_task : public dng_area_task
 								   fImage.Planes (),
 								   padNone);
 								
+			fBufferData.Reset (new AutoPtr<dng_memory_block> [threadCount]);
+			
 			for (uint32 index = 0; index < threadCount; index++)
 				{
 				
@@ -427,7 +427,7 @@ class dng_inplace_opcode_task: public dng_area_task
 		
 		uint32 fPixelType;
 		
-		AutoPtr<dng_memory_block> fBuffer [kMaxMPThreads];
+		AutoArray<AutoPtr<dng_memory_block> > fBuffer;
 
 	public:
 	
@@ -458,6 +458,8 @@ class dng_inplace_opcode_task: public dng_area_task
 												   fImage.Planes (), 
 												   padSIMDBytes);
 								   
+			fBuffer.Reset (new AutoPtr<dng_memory_block> [threadCount]);
+			
 			for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
 				{
 				
@@ -1882,12 +1882,18 @@ bool dng_read_image::ReadLosslessJPEG (dng_host &host,
 	
 	uint64 tileOffset = stream.Position ();
 	
+	// With fewer tiles than threads (typically a single strip), let the
+	// decoder spread the restart intervals of a tile over the threads.
+	
+	bool decodeInParallel = ifd.TilesPerImage () < host.PerformAreaTaskThreads ();
+	
 	DecodeLosslessJPEG (stream,
 					    spooler,
 					    decodedSize.Get (),
 					    decodedSize.Get (),
 						bug16,
-						tileOffset + tileByteCount);
+						tileOffset + tileByteCount,
+						decodeInParallel ? &host : NULL);
 
 	return true;
 	
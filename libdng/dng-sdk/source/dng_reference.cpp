@@ -14,6 +14,7 @@
 #include "dng_matrix.h"
 #include "dng_resample.h"
 #include "dng_simd_type.h"
+#include "dng_tag_types.h"
 #include "dng_utils.h"
 				   
 /*****************************************************************************/
@@ -3206,3 +3207,171 @@ void RefBaselineMapPoly32 (real32 *dPtr,
 	}
 
 /*****************************************************************************/
+
+void RefBaselineRender16 (const uint16 *sPtrA,
+						  const uint16 *sPtrB,
+						  const uint16 *sPtrC,
+						  void *dPtrR,
+						  void *dPtrG,
+						  void *dPtrB,
+						  uint32 count,
+						  const dng_baseline_render_params &params)
+	{
+	
+	// Same steps as dng_render_task's row-by-row path, applied to short strips
+	// of the row so that the intermediate data stays in the first level cache.
+	
+	const uint32 kStripSize = 256;
+	
+	real32 buffer [3] [kStripSize];
+	
+	real32 *tPtrR = buffer [0];
+	real32 *tPtrG = buffer [1];
+	real32 *tPtrB = buffer [2];
+	
+	const uint16 *sPtr [3] = { sPtrA, sPtrB, sPtrC };
+	
+	void *dPtr [3] = { dPtrR, dPtrG, dPtrB };
+	
+	for (uint32 col = 0; col < count; col += kStripSize)
+		{
+		
+		uint32 cols = Min_uint32 (kStripSize, count - col);
+		
+		for (uint32 plane = 0; plane < 3; plane++)
+			{
+			
+			RefCopyArea16_R32 (sPtr [plane] + col,
+							   buffer [plane],
+							   1,
+							   cols,
+							   1,
+							   0, 1, 0,
+							   0, 1, 0,
+							   params.fSrcPixelRange);
+			
+			if (params.fZeroOffsetRamp)
+				{
+				
+				RefBaseline1DTable (buffer [plane],
+									buffer [plane],
+									cols,
+									*params.fZeroOffsetRamp);
+				
+				}
+			
+			}
+		
+		RefBaselineABCtoRGB (tPtrR,
+							 tPtrG,
+							 tPtrB,
+							 tPtrR,
+							 tPtrG,
+							 tPtrB,
+							 cols,
+							 *params.fCameraWhite,
+							 *params.fCameraToRGB);
+		
+		if (params.fHueSatMap)
+			{
+			
+			RefBaselineHueSatMap (tPtrR,
+								  tPtrG,
+								  tPtrB,
+								  tPtrR,
+								  tPtrG,
+								  tPtrB,
+								  cols,
+								  *params.fHueSatMap,
+								  params.fHueSatMapEncode,
+								  params.fHueSatMapDecode);
+			
+			}
+		
+		for (uint32 plane = 0; plane < 3; plane++)
+			{
+			
+			RefBaseline1DTable (buffer [plane],
+								buffer [plane],
+								cols,
+								*params.fExposureRamp);
+			
+			}
+		
+		if (params.fLookTable)
+			{
+			
+			RefBaselineHueSatMap (tPtrR,
+								  tPtrG,
+								  tPtrB,
+								  tPtrR,
+								  tPtrG,
+								  tPtrB,
+								  cols,
+								  *params.fLookTable,
+								  params.fLookTableEncode,
+								  params.fLookTableDecode);
+			
+			}
+		
+		RefBaselineRGBTone (tPtrR,
+							tPtrG,
+							tPtrB,
+							tPtrR,
+							tPtrG,
+							tPtrB,
+							cols,
+							*params.fToneCurve);
+		
+		RefBaselineRGBtoRGB (tPtrR,
+							 tPtrG,
+							 tPtrB,
+							 tPtrR,
+							 tPtrG,
+							 tPtrB,
+							 cols,
+							 *params.fRGBtoFinal);
+		
+		for (uint32 plane = 0; plane < 3; plane++)
+			{
+			
+			RefBaseline1DTable (buffer [plane],
+								buffer [plane],
+								cols,
+								*params.fEncodeGamma);
+			
+			if (params.fDstPixelType == ttByte)
+				{
+				
+				RefCopyAreaR32_8 (buffer [plane],
+								  (uint8 *) dPtr [plane] + col,
+								  1,
+								  cols,
+								  1,
+								  0, 1, 0,
+								  0, 1, 0,
+								  0x0FF);
+				
+				}
+				
+			else
+				{
+				
+				RefCopyAreaR32_16 (buffer [plane],
+								   (uint16 *) dPtr [plane] + col,
+								   1,
+								   cols,
+								   1,
+								   0, 1, 0,
+								   0, 1, 0,
+								   0x0FFFF);
+				
+				}
+			
+			}
+		
+		}
+	
+	}
+
+/*****************************************************************************/
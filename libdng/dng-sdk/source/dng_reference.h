@@ -517,6 +517,17 @@ void RefBaselineMapPoly32 (real32 *dPtr,
 
 /*****************************************************************************/
 
+void RefBaselineRender16 (const uint16 *sPtrA,
+						  const uint16 *sPtrB,
+						  const uint16 *sPtrC,
+						  void *dPtrR,
+						  void *dPtrG,
+						  void *dPtrB,
+						  uint32 count,
+						  const dng_baseline_render_params &params);
+
+/*****************************************************************************/
+
 #endif
 	
 /*****************************************************************************/
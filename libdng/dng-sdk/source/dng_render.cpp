@@ -16,11 +16,16 @@
 #include "dng_filter_task.h"
 #include "dng_host.h"
 #include "dng_image.h"
+#include "dng_mutex.h"
 #include "dng_negative.h"
 #include "dng_resample.h"
 #include "dng_safe_arithmetic.h"
 #include "dng_utils.h"
 
+#include <atomic>
+#include <list>
+#include <memory>
+
 /*****************************************************************************/
 
 dng_function_zero_offset::dng_function_zero_offset (real64 zeroOffset)
@@ -714,6 +719,327 @@ const dng_1d_function & dng_tone_curve_acr3_default::Get ()
 
 /*****************************************************************************/
 
+// Tables derived from the profile, the white balance, and the exposure and tone
+// settings. They are only read once built, so render tasks with the same settings
+// share them through the process-wide cache below - which is why they are
+// allocated with the default allocator rather than the one of the host that
+// happened to build them.
+
+class dng_render_tables: private dng_uncopyable
+	{
+	
+	public:
+	
+		AutoPtr<dng_hue_sat_map> fHueSatMap;
+		
+		dng_1d_table fExposureRamp;
+		
+		AutoPtr<dng_hue_sat_map> fLookTable;
+		
+		dng_1d_table fToneCurve;
+		
+		dng_1d_table fEncodeGamma;
+
+		AutoPtr<dng_1d_table> fHueSatMapEncode;
+		AutoPtr<dng_1d_table> fHueSatMapDecode;
+
+		AutoPtr<dng_1d_table> fLookTableEncode;
+		AutoPtr<dng_1d_table> fLookTableDecode;
+		
+	public:
+	
+		dng_render_tables (const dng_camera_profile *profile,
+						   const dng_xy_coord &whiteXY,
+						   real64 exposure,
+						   real64 black,
+						   const dng_1d_function &toneCurve,
+						   const dng_color_space &finalSpace);
+		
+	};
+
+/*****************************************************************************/
+
+dng_render_tables::dng_render_tables (const dng_camera_profile *profile,
+									  const dng_xy_coord &whiteXY,
+									  real64 exposure,
+									  real64 black,
+									  const dng_1d_function &toneCurve,
+									  const dng_color_space &finalSpace)
+	{
+	
+	dng_memory_allocator &allocator = gDefaultDNGMemoryAllocator;
+	
+	// Find Hue/Sat table, if any.
+	
+	if (profile)
+		{
+		
+		fHueSatMap.Reset (profile->HueSatMapForWhite (whiteXY));
+		
+		// Interpolated maps carry a fingerprint derived from their inputs,
+		// but a plain copy of a single map keeps the source's - which is
+		// null for maps built in code rather than read from a profile.
+		// Give those a unique one so that optimized routines can tell
+		// them apart.
+		
+		if (fHueSatMap.Get () && fHueSatMap->RuntimeFingerprint ().IsNull ())
+			{
+			
+			fHueSatMap->AssignNewUniqueRuntimeFingerprint ();
+			
+			}
+		
+		if (profile->HasLookTable ())
+			{
+			
+			fLookTable.Reset (new dng_hue_sat_map (profile->LookTable ()));
+			
+			if (fLookTable->RuntimeFingerprint ().IsNull ())
+				{
+				
+				fLookTable->AssignNewUniqueRuntimeFingerprint ();
+				
+				}
+			
+			}
+
+		if (profile->HueSatMapEncoding () != encoding_Linear)
+			{
+				
+			BuildHueSatMapEncodingTable (allocator,
+										 profile->HueSatMapEncoding (),
+										 fHueSatMapEncode,
+										 fHueSatMapDecode,
+										 false);
+				
+			}
+		
+		if (profile->LookTableEncoding () != encoding_Linear)
+			{
+				
+			BuildHueSatMapEncodingTable (allocator,
+										 profile->LookTableEncoding (),
+										 fLookTableEncode,
+										 fLookTableDecode,
+										 false);
+				
+			}
+		
+		}
+		
+	// Compute exposure/shadows ramp.
+
+		{
+		
+		real64 white = 1.0 / pow (2.0, Max_real64 (0.0, exposure));
+		
+		black = Min_real64 (black, 0.99 * white);
+	
+		dng_function_exposure_ramp rampFunction (white,
+												 black,
+												 black);
+												 
+		fExposureRamp.Initialize (allocator, rampFunction);
+
+		}
+		
+	// Compute tone curve.
+	
+		{
+		
+		// If there is any negative exposure compenation to perform
+		// (beyond what the camera provides for with its baseline exposure),
+		// we fake this by darkening the tone curve.
+		
+		dng_function_exposure_tone exposureTone (exposure);
+		
+		dng_1d_concatenate totalTone (exposureTone,
+									  toneCurve);
+		
+		fToneCurve.Initialize (allocator, totalTone);
+				
+		}
+		
+	// Compute final space encoding.
+	
+	fEncodeGamma.Initialize (allocator, finalSpace.GammaFunction ());
+	
+	}
+
+/*****************************************************************************/
+
+// Everything dng_render_tables are built from. Tone curves are identified by
+// address, so only the SDK's static curves qualify (and the profile's own
+// curve, which the profile fingerprint covers).
+
+struct dng_render_tables_key
+	{
+	
+	dng_fingerprint fProfile;
+	
+	dng_xy_coord fWhiteXY;
+	
+	real64 fExposure;
+	real64 fBlack;
+	
+	const dng_1d_function *fToneCurve;		// NULL for the profile's curve
+	
+	const dng_color_space *fFinalSpace;
+	
+	bool operator== (const dng_render_tables_key &key) const
+		{
+		
+		return fProfile    == key.fProfile    &&
+			   fWhiteXY    == key.fWhiteXY    &&
+			   fExposure   == key.fExposure   &&
+			   fBlack      == key.fBlack      &&
+			   fToneCurve  == key.fToneCurve  &&
+			   fFinalSpace == key.fFinalSpace;
+		
+		}
+	
+	};
+
+/*****************************************************************************/
+
+static dng_std_mutex gRenderTablesMutex;
+
+// Most recently used first.
+
+static std::list<std::pair<dng_render_tables_key,
+						   std::shared_ptr<const dng_render_tables> > > gRenderTables;
+
+static uint32 gRenderTablesCapacity = 8;
+
+static std::atomic<uint64> gRenderTablesHits (0);
+static std::atomic<uint64> gRenderTablesMisses (0);
+
+/*****************************************************************************/
+
+static std::shared_ptr<const dng_render_tables> FindRenderTables (const dng_render_tables_key &key)
+	{
+	
+	dng_lock_std_mutex lock (gRenderTablesMutex);
+	
+	for (auto it = gRenderTables.begin (); it != gRenderTables.end (); ++it)
+		{
+		
+		if (it->first == key)
+			{
+			
+			gRenderTables.splice (gRenderTables.begin (), gRenderTables, it);
+			
+			return it->second;
+			
+			}
+		
+		}
+	
+	return std::shared_ptr<const dng_render_tables> ();
+	
+	}
+
+/*****************************************************************************/
+
+// Returns the tables to use: the ones passed in, or those another render task
+// added for the same key since FindRenderTables missed.
+
+static std::shared_ptr<const dng_render_tables> AddRenderTables (const dng_render_tables_key &key,
+																 const std::shared_ptr<const dng_render_tables> &tables)
+	{
+	
+	dng_lock_std_mutex lock (gRenderTablesMutex);
+	
+	for (auto it = gRenderTables.begin (); it != gRenderTables.end (); ++it)
+		{
+		
+		if (it->first == key)
+			{
+			
+			gRenderTables.splice (gRenderTables.begin (), gRenderTables, it);
+			
+			return it->second;
+			
+			}
+		
+		}
+	
+	gRenderTables.push_front (std::make_pair (key, tables));
+	
+	while (gRenderTables.size () > gRenderTablesCapacity)
+		{
+		
+		gRenderTables.pop_back ();
+		
+		}
+	
+	return tables;
+	
+	}
+
+/*****************************************************************************/
+
+void dng_render_table_cache::SetCapacity (uint32 count)
+	{
+	
+	dng_lock_std_mutex lock (gRenderTablesMutex);
+	
+	gRenderTablesCapacity = count;
+	
+	while (gRenderTables.size () > gRenderTablesCapacity)
+		{
+		
+		gRenderTables.pop_back ();
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+uint32 dng_render_table_cache::Capacity ()
+	{
+	
+	dng_lock_std_mutex lock (gRenderTablesMutex);
+	
+	return gRenderTablesCapacity;
+	
+	}
+
+/*****************************************************************************/
+
+uint64 dng_render_table_cache::Hits ()
+	{
+	
+	return gRenderTablesHits;
+	
+	}
+
+/*****************************************************************************/
+
+uint64 dng_render_table_cache::Misses ()
+	{
+	
+	return gRenderTablesMisses;
+	
+	}
+
+/*****************************************************************************/
+
+void dng_render_table_cache::Clear ()
+	{
+	
+	dng_lock_std_mutex lock (gRenderTablesMutex);
+	
+	gRenderTables.clear ();
+	
+	gRenderTablesHits   = 0;
+	gRenderTablesMisses = 0;
+	
+	}
+
+/*****************************************************************************/
+
 class dng_render_task: public dng_filter_task
 	{
 	
@@ -732,27 +1058,17 @@ class dng_render_task: public dng_filter_task
 		dng_vector fCameraWhite;
 		dng_matrix fCameraToRGB;
 		
-		AutoPtr<dng_hue_sat_map> fHueSatMap;
-		
-		dng_1d_table fExposureRamp;
-		
-		AutoPtr<dng_hue_sat_map> fLookTable;
-		
-		dng_1d_table fToneCurve;
-		
 		dng_matrix fRGBtoFinal;
 		
-		dng_1d_table fEncodeGamma;
-
-		AutoPtr<dng_1d_table> fHueSatMapEncode;
-		AutoPtr<dng_1d_table> fHueSatMapDecode;
-
-		AutoPtr<dng_1d_table> fLookTableEncode;
-		AutoPtr<dng_1d_table> fLookTableDecode;
+		std::shared_ptr<const dng_render_tables> fTables;
 	
-		AutoPtr<dng_memory_block> fTempBuffer [kMaxMPThreads];
+		AutoArray<AutoPtr<dng_memory_block> > fTempBuffer;
   
-        AutoPtr<dng_memory_block> fMaskBuffer [kMaxMPThreads];
+        AutoArray<AutoPtr<dng_memory_block> > fMaskBuffer;
+		
+		bool fFused;
+		
+		dng_baseline_render_params fFusedParams;
 		
 	public:
 	
@@ -800,23 +1116,11 @@ dng_render_task::dng_render_task (const dng_image &srcImage,
 	,	fCameraWhite ()
 	,	fCameraToRGB ()
 	
-	,	fHueSatMap ()
-	
-	,	fExposureRamp ()
-	
-	,	fLookTable ()
-	
-	,	fToneCurve ()
-	
 	,	fRGBtoFinal ()
 	
-	,	fEncodeGamma ()
-
-	,	fHueSatMapEncode ()
-	,	fHueSatMapDecode ()
-
-	,	fLookTableEncode ()
-	,	fLookTableDecode ()
+	,	fTables ()
+	
+	,	fFused (false)
 	
 	{
 	
@@ -843,6 +1147,27 @@ void dng_render_task::Start (uint32 threadCount,
 							 dng_abort_sniffer *sniffer)
 	{
 	
+	// Three-plane 16-bit data rendered to 8- or 16-bit RGB without a transparency
+	// mask goes through the fused BaselineRender16 routine, which reads and writes
+	// the tile buffers in the image pixel types. Everything else keeps the
+	// row-by-row path through floating point buffers.
+	
+	fFused = fParams.FusedRender () &&
+			 fSrcImage.PixelType () == ttShort &&
+			 fSrcPlanes == 3 &&
+			 fDstPlanes == 3 &&
+			 !fSrcMask &&
+			 (fDstImage.PixelType () == ttByte ||
+			  fDstImage.PixelType () == ttShort);
+			 
+	if (fFused)
+		{
+		
+		fSrcPixelType = fSrcImage.PixelType ();
+		fDstPixelType = fDstImage.PixelType ();
+		
+		}
+	
 	dng_filter_task::Start (threadCount,
 							dstArea,
 							tileSize,
@@ -863,6 +1188,10 @@ void dng_render_task::Start (uint32 threadCount,
 	// Compute camera space to linear ProPhoto RGB parameters.
 	
 	dng_camera_profile_id profileID;	// Default profile ID.
+	
+	const dng_camera_profile *profile = NULL;
+	
+	dng_xy_coord whiteXY;
 		
 	if (!fNegative.IsMonochrome ())
 		{
@@ -902,100 +1231,101 @@ void dng_render_task::Start (uint32 threadCount,
 		fCameraToRGB = dng_space_ProPhoto::Get ().MatrixFromPCS () *
 					   spec->CameraToPCS ();
 					   
-		// Find Hue/Sat table, if any.
+		whiteXY = spec->WhiteXY ();
 		
-		const dng_camera_profile *profile = fNegative.ProfileByID (profileID);
-		
-		if (profile)
-			{
-			
-			fHueSatMap.Reset (profile->HueSatMapForWhite (spec->WhiteXY ()));
-			
-			if (profile->HasLookTable ())
-				{
-				
-				fLookTable.Reset (new dng_hue_sat_map (profile->LookTable ()));
-				
-				}
-
-			if (profile->HueSatMapEncoding () != encoding_Linear)
-				{
-					
-				BuildHueSatMapEncodingTable (*allocator,
-											 profile->HueSatMapEncoding (),
-											 fHueSatMapEncode,
-											 fHueSatMapDecode,
-											 false);
-					
-				}
-			
-			if (profile->LookTableEncoding () != encoding_Linear)
-				{
-					
-				BuildHueSatMapEncodingTable (*allocator,
-											 profile->LookTableEncoding (),
-											 fLookTableEncode,
-											 fLookTableDecode,
-											 false);
-					
-				}
-			
-			}
+		profile = fNegative.ProfileByID (profileID);
 		
 		}
 		
-	// Compute exposure/shadows ramp.
+	// Compute linear ProPhoto RGB to final space matrix.
+	
+	const dng_color_space &finalSpace = fParams.FinalSpace ();
+	
+	fRGBtoFinal = finalSpace.MatrixFromPCS () *
+				  dng_space_ProPhoto::Get ().MatrixToPCS ();
+				  
+	// Find or build the Hue/Sat maps, exposure ramp, tone curve and encoding
+	// gamma for these settings.
 
 	real64 exposure = fParams.Exposure () +
 					  fNegative.TotalBaselineExposure (profileID) -
 					  (log (fNegative.Stage3Gain ()) / log (2.0));
 	
+	real64 black = fParams.Shadows () *
+				   fNegative.ShadowScale () *
+				   fNegative.Stage3Gain () *
+				   0.001;
+				   
+	dng_render_tables_key key;
+	
+	key.fProfile    = profile ? profile->Fingerprint () : dng_fingerprint ();
+	key.fWhiteXY    = whiteXY;
+	key.fExposure   = exposure;
+	key.fBlack      = black;
+	key.fToneCurve  = fParams.UsesProfileToneCurve () ? NULL : &fParams.ToneCurve ();
+	key.fFinalSpace = &finalSpace;
+	
+	bool cacheable = key.fToneCurve == NULL ||
+					 key.fToneCurve == &dng_tone_curve_acr3_default::Get () ||
+					 key.fToneCurve == &dng_1d_identity::Get ();
+					 
+	if (cacheable)
 		{
 		
-		real64 white = 1.0 / pow (2.0, Max_real64 (0.0, exposure));
+		fTables = FindRenderTables (key);
 		
-		real64 black = fParams.Shadows () *
-					   fNegative.ShadowScale () *
-					   fNegative.Stage3Gain () *
-					   0.001;
-					   
-		black = Min_real64 (black, 0.99 * white);
-	
-		dng_function_exposure_ramp rampFunction (white,
-												 black,
-												 black);
-												 
-		fExposureRamp.Initialize (*allocator, rampFunction);
-
 		}
 		
-	// Compute tone curve.
-	
+	if (fTables)
 		{
 		
-		// If there is any negative exposure compenation to perform
-		// (beyond what the camera provides for with its baseline exposure),
-		// we fake this by darkening the tone curve.
-		
-		dng_function_exposure_tone exposureTone (exposure);
-		
-		dng_1d_concatenate totalTone (exposureTone,
-									  fParams.ToneCurve ());
+		++gRenderTablesHits;
 		
-		fToneCurve.Initialize (*allocator, totalTone);
-				
 		}
 		
-	// Compute linear ProPhoto RGB to final space parameters.
-	
+	else
 		{
 		
-		const dng_color_space &finalSpace = fParams.FinalSpace ();
+		fTables.reset (new dng_render_tables (profile,
+											  whiteXY,
+											  exposure,
+											  black,
+											  fParams.ToneCurve (),
+											  finalSpace));
 		
-		fRGBtoFinal = finalSpace.MatrixFromPCS () *
-					  dng_space_ProPhoto::Get ().MatrixToPCS ();
-					  
-		fEncodeGamma.Initialize (*allocator, finalSpace.GammaFunction ());
+		if (cacheable)
+			{
+			
+			++gRenderTablesMisses;
+			
+			fTables = AddRenderTables (key, fTables);
+			
+			}
+		
+		}
+
+	if (fFused)
+		{
+		
+		fFusedParams.fSrcPixelRange	  = 0x0FFFF;
+		fFusedParams.fZeroOffsetRamp  = fNegative.Stage3BlackLevel () ? &fZeroOffsetRamp : NULL;
+		fFusedParams.fCameraWhite	  = &fCameraWhite;
+		fFusedParams.fCameraToRGB	  = &fCameraToRGB;
+		fFusedParams.fHueSatMap		  = fTables->fHueSatMap.Get ();
+		fFusedParams.fHueSatMapEncode = fTables->fHueSatMapEncode.Get ();
+		fFusedParams.fHueSatMapDecode = fTables->fHueSatMapDecode.Get ();
+		fFusedParams.fExposureRamp	  = &fTables->fExposureRamp;
+		fFusedParams.fLookTable		  = fTables->fLookTable.Get ();
+		fFusedParams.fLookTableEncode = fTables->fLookTableEncode.Get ();
+		fFusedParams.fLookTableDecode = fTables->fLookTableDecode.Get ();
+		fFusedParams.fToneCurve		  = &fTables->fToneCurve;
+		fFusedParams.fRGBtoFinal	  = &fRGBtoFinal;
+		fFusedParams.fEncodeGamma	  = &fTables->fEncodeGamma;
+		fFusedParams.fDstPixelType	  = fDstPixelType;
+		
+		// No temp buffers needed.
+		
+		return;
 		
 		}
 
@@ -1011,6 +1341,8 @@ void dng_render_task::Start (uint32 threadCount,
 		
 		}
 	
+	fTempBuffer.Reset (new AutoPtr<dng_memory_block> [threadCount]);
+	
 	for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
 		{
 		
@@ -1033,6 +1365,8 @@ void dng_render_task::Start (uint32 threadCount,
             
             }
     
+        fMaskBuffer.Reset (new AutoPtr<dng_memory_block> [threadCount]);
+        
         for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
             {
             
@@ -1056,6 +1390,37 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 	
 	uint32 srcCols = srcArea.W ();
 	
+	if (fFused)
+		{
+		
+		for (int32 srcRow = srcArea.t; srcRow < srcArea.b; srcRow++)
+			{
+			
+			const uint16 *sPtrA = srcBuffer.ConstPixel_uint16 (srcRow,
+															   srcArea.l,
+															   0);
+			
+			void *dPtrR = dstBuffer.DirtyPixel (srcRow + (dstArea.t - srcArea.t),
+												dstArea.l,
+												0);
+			
+			uint32 dPlaneStep = (uint32) dstBuffer.fPlaneStep * dstBuffer.fPixelSize;
+			
+			DoBaselineRender16 (sPtrA,
+								sPtrA + srcBuffer.fPlaneStep,
+								sPtrA + 2 * srcBuffer.fPlaneStep,
+								dPtrR,
+								(uint8 *) dPtrR + dPlaneStep,
+								(uint8 *) dPtrR + 2 * dPlaneStep,
+								srcCols,
+								fFusedParams);
+			
+			}
+		
+		return;
+		
+		}
+	
 	real32 *tPtrR = fTempBuffer [threadIndex]->Buffer_real32 ();
 	
 	real32 *tPtrG = tPtrR + srcCols;
@@ -1167,7 +1532,7 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 					
 				// Apply Hue/Sat map, if any.
 				
-				if (fHueSatMap.Get ())
+				if (fTables->fHueSatMap.Get ())
 					{
 					
 					DoBaselineHueSatMap (tPtrR,
@@ -1177,9 +1542,9 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 										 tPtrG,
 										 tPtrB,
 										 srcCols,
-										 *fHueSatMap.Get (),
-										 fHueSatMapEncode.Get (),
-										 fHueSatMapDecode.Get ());
+										 *fTables->fHueSatMap.Get (),
+										 fTables->fHueSatMapEncode.Get (),
+										 fTables->fHueSatMapDecode.Get ());
 					
 					}
 				
@@ -1192,21 +1557,21 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 		DoBaseline1DTable (tPtrR,
 						   tPtrR,
 						   srcCols,
-						   fExposureRamp);
+						   fTables->fExposureRamp);
 								
 		DoBaseline1DTable (tPtrG,
 						   tPtrG,
 						   srcCols,
-						   fExposureRamp);
+						   fTables->fExposureRamp);
 								
 		DoBaseline1DTable (tPtrB,
 						   tPtrB,
 						   srcCols,
-						   fExposureRamp);
+						   fTables->fExposureRamp);
 		
 		// Apply look table, if any.
 		
-		if (fLookTable.Get ())
+		if (fTables->fLookTable.Get ())
 			{
 			
 			DoBaselineHueSatMap (tPtrR,
@@ -1216,9 +1581,9 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 								 tPtrG,
 								 tPtrB,
 								 srcCols,
-								 *fLookTable.Get (),
-								 fLookTableEncode.Get (),
-								 fLookTableDecode.Get ());
+								 *fTables->fLookTable.Get (),
+								 fTables->fLookTableEncode.Get (),
+								 fTables->fLookTableDecode.Get ());
 			
 			}
 
@@ -1231,7 +1596,7 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 					       tPtrG,
 						   tPtrB,
 						   srcCols,
-						   fToneCurve);
+						   fTables->fToneCurve);
 						   
 		// Convert to final color space.
 		
@@ -1254,7 +1619,7 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 			DoBaseline1DTable (dPtrG,
 							   dPtrG,
 							   srcCols,
-							   fEncodeGamma);
+							   fTables->fEncodeGamma);
 								
 			}
 		
@@ -1280,17 +1645,17 @@ void dng_render_task::ProcessArea (uint32 threadIndex,
 			DoBaseline1DTable (dPtrR,
 							   dPtrR,
 							   srcCols,
-							   fEncodeGamma);
+							   fTables->fEncodeGamma);
 								
 			DoBaseline1DTable (dPtrG,
 							   dPtrG,
 							   srcCols,
-							   fEncodeGamma);
+							   fTables->fEncodeGamma);
 								
 			DoBaseline1DTable (dPtrB,
 							   dPtrB,
 							   srcCols,
-							   fEncodeGamma);
+							   fTables->fEncodeGamma);
 							   
 			}
    
@@ -1345,6 +1710,8 @@ dng_render::dng_render (dng_host &host,
 	
 	,	fMaximumSize	(0)
 	
+	,	fFusedRender	(true)
+	
 	,	fProfileToneCurve ()
 	
 	{
@@ -168,6 +168,8 @@ class dng_render: private dng_uncopyable
 		
 		uint32 fMaximumSize;
 		
+		bool fFusedRender;
+		
 	private:
 	
 		AutoPtr<dng_spline_solver> fProfileToneCurve;
@@ -306,6 +308,31 @@ class dng_render: private dng_uncopyable
 			return fMaximumSize;
 			}
 
+		/// Set whether three-plane negatives may be rendered to 8- or 16-bit RGB in a
+		/// single fused pass per row (default), rather than step by step through
+		/// floating point tile buffers. Both produce identical results.
+		/// \param fused Allow the fused pass.
+
+		void SetFusedRender (bool fused)
+			{
+			fFusedRender = fused;
+			}
+
+		/// Get whether the fused rendering pass may be used.
+		/// \retval True if the fused pass is allowed.
+
+		bool FusedRender () const
+			{
+			return fFusedRender;
+			}
+
+		/// Returns true if the tone curve is the default one of the negative's profile.
+
+		bool UsesProfileToneCurve () const
+			{
+			return fProfileToneCurve.Get () && fToneCurve == fProfileToneCurve.Get ();
+			}
+
 		/// Actually render a digital negative to a displayable image.
 		/// Input digital negative is passed to the constructor of this dng_render class.
 		/// \retval The final resulting image.
@@ -316,6 +343,47 @@ class dng_render: private dng_uncopyable
 
 /*****************************************************************************/
 
+/// \brief Process-wide cache of the tables render tasks derive from the profile,
+/// white balance, exposure and tone settings (Hue/Sat maps, exposure ramp, tone
+/// curve and encoding gamma), so that renders with the same settings - e.g., the
+/// previews of a batch of frames from one camera - build them only once.
+///
+/// Renders with a custom tone curve neither use nor count towards the cache.
+
+class dng_render_table_cache
+	{
+	
+	public:
+	
+		/// Set the number of table sets kept, least recently used ones are
+		/// dropped first. 0 disables the cache. Default is 8.
+		/// \param count Maximum number of table sets.
+		
+		static void SetCapacity (uint32 count);
+		
+		/// Get the number of table sets kept.
+		/// \retval Maximum number of table sets.
+		
+		static uint32 Capacity ();
+		
+		/// Number of render tasks that found their tables in the cache.
+		/// \retval Cache hits since start or the last Clear ().
+		
+		static uint64 Hits ();
+		
+		/// Number of render tasks that had to build their tables.
+		/// \retval Cache misses since start or the last Clear ().
+		
+		static uint64 Misses ();
+		
+		/// Drop all cached tables and reset the counts.
+		
+		static void Clear ();
+		
+	};
+
+/*****************************************************************************/
+
 #endif
 	
 /*****************************************************************************/
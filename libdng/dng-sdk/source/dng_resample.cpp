@@ -498,7 +498,7 @@ class dng_resample_task: public dng_filter_task
 		
 		dng_point fSrcTileSize;
 		
-		AutoPtr<dng_memory_block> fTempBuffer [kMaxMPThreads];
+		AutoArray<AutoPtr<dng_memory_block> > fTempBuffer;
 		
 	public:
 	
@@ -666,6 +666,8 @@ void dng_resample_task::Start (uint32 threadCount,
 		
 		}
 	
+	fTempBuffer.Reset (new AutoPtr<dng_memory_block> [threadCount]);
+	
 	for (uint32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
 		{
 		
@@ -62,13 +62,12 @@ const uint32 kMaxImageSide = 65000;
 
 const uint32 kMaxToneCurvePoints = 8192;
 
-/// Maximum number of MP threads for dng_area_task operations.
+/// Maximum number of MP threads for dng_area_task operations. Per-thread
+/// buffers are sized by the thread count passed to dng_area_task::Start, so
+/// this is only a sanity limit; the number of threads actually used is
+/// decided by dng_host::PerformAreaTaskThreads at runtime.
 
-#if qDNG64Bit
-const uint32 kMaxMPThreads = 128; // EP! Needs much larger max!
-#else
-const uint32 kMaxMPThreads = 8;
-#endif
+const uint32 kMaxMPThreads = 1024;
 
 /// Maximum supported value of Stage3BlackLevelNormalized.
 
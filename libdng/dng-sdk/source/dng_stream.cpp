@@ -402,6 +402,12 @@ void dng_stream::SetLength (uint64 length)
 	
 	Flush ();
 	
+	// Drop data buffered for reading, it may be out of date from now on.
+	
+	fBufferStart = 0;
+	fBufferEnd   = 0;
+	fBufferLimit = fBufferSize;
+	
 	if (Length () != length)
 		{
 		
@@ -22,6 +22,9 @@
 */
 
 #include "dnghost.h"
+
+#include <chrono>
+
 #include "dng_abort_sniffer.h"
 #include "dng_area_task.h"
 #include "dng_rect.h"
@@ -30,69 +33,122 @@
 #define kLocalUseThreads 1
 #endif
 
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(const Clock::time_point &start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+// Set while a thread processes an area task. Tasks started from there (e.g., the restart
+// interval decode within the tile reading task) are nested and not recorded: the starting
+// thread is counted as busy by the outer task until they return, recording them too would
+// count that time twice
+static thread_local bool inAreaTask = false;
+
+class AreaTaskScope {
+public:
+    AreaTaskScope() : m_outer(inAreaTask) {inAreaTask = true;}
+    ~AreaTaskScope() {inAreaTask = m_outer;}
+
+private:
+    bool m_outer;
+};
+
+
+std::map<std::string, AreaTaskStats> DngHost::areaTaskStats() const {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_taskStats;
+}
+
+
+void DngHost::resetStats() {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_taskStats.clear();
+}
+
+
+void DngHost::addTaskStats(const char *name, uint32 threads, double seconds, double busySeconds) {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    AreaTaskStats &stats = m_taskStats[(name != NULL) ? name : ""];
+    stats.runs++;
+    stats.threads = Max_uint32(stats.threads, threads);
+    stats.seconds += seconds;
+    stats.busySeconds += busySeconds;
+    stats.threadSeconds += seconds * threads;
+}
+
+
 #if !kLocalUseThreads
 
-void DngHost::PerformAreaTask(dng_area_task &task, const dng_rect &area) { 
-   dng_area_task::Perform(task, area, &Allocator (), Sniffer ());
+void DngHost::PerformAreaTask(dng_area_task &task, const dng_rect &area, dng_area_task_progress *progress) { 
+   bool collectStats = m_collectStats && !inAreaTask;
+   Clock::time_point start(Clock::now());
+   {
+       AreaTaskScope scope;
+       dng_area_task::Perform(task, area, &Allocator (), Sniffer (), progress);
+   }
+   if (collectStats) {
+       double seconds = secondsSince(start);
+       addTaskStats(task.Name(), 1, seconds, seconds);
+   }
+}
+
+uint32 DngHost::PerformAreaTaskThreads() {
+   return 1;
 }
 
 #else 
 
-#include <thread>
-#include <vector>
-#include <exception>
+#include <atomic>
 #include "dng_sdk_limits.h"
+#include "threadpool.h"
 
-static std::exception_ptr threadException = nullptr;
 
-static void executeAreaThread(std::reference_wrapper<dng_area_task> task, uint32 threadIndex, const dng_rect &threadArea, const dng_point &tileSize, dng_abort_sniffer *sniffer) {
-   try { task.get().ProcessOnThread(threadIndex, threadArea, tileSize, sniffer, NULL); }
-   catch (...) { threadException = std::current_exception(); }
+uint32 DngHost::PerformAreaTaskThreads() {
+    return Min_uint32(ThreadPool::global().threads(), kMaxMPThreads);
 }
 
 
 void DngHost::PerformAreaTask(dng_area_task &task, const dng_rect &area, dng_area_task_progress *progress) {
     dng_point tileSize(task.FindTileSize(area));
 
-    // Now we need to do some resource allocation
-    // We start by assuming one tile per thread, and work our way up
-    uint32 vTilesinArea = area.H() / tileSize.v; if ((area.H() - (vTilesinArea * tileSize.v)) > 0) vTilesinArea++;
-    uint32 hTilesinArea = area.W() / tileSize.h; if ((area.W() - (hTilesinArea * tileSize.h)) > 0) hTilesinArea++;
-
-    int vTilesPerThread = 1, hTilesPerThread = 1;
-    // Ensure we don't exceed maxThreads for this task
-    while (((vTilesinArea + vTilesPerThread - 1) / vTilesPerThread) * ((hTilesinArea + hTilesPerThread - 1) / hTilesPerThread) > kMaxMPThreads) {
-        // Here we want to increase the number of tiles per thread; so do we do that in the V or H dimension?
-        if ((vTilesinArea / vTilesPerThread) > (hTilesinArea / hTilesPerThread)) vTilesPerThread++;
-        else hTilesPerThread++;
-    }
-
-    task.Start(Min_uint32(task.MaxThreads (), kMaxMPThreads), area, tileSize, &Allocator (), Sniffer ());
+    // Threads don't own a fixed region: every pool worker keeps pulling the next unprocessed
+    // tile until none are left, so a slow tile doesn't leave the other threads idle
+    uint32 vTilesinArea = (area.H() + tileSize.v - 1) / tileSize.v;
+    uint32 hTilesinArea = (area.W() + tileSize.h - 1) / tileSize.h;
 
-    std::vector<std::thread> areaThreads;
-    threadException = nullptr;
+    uint32 threadCount = Min_uint32(task.MaxThreads(), PerformAreaTaskThreads());
+    threadCount = Max_uint32(Min_uint32(threadCount, vTilesinArea * hTilesinArea), 1);
 
-    dng_rect threadArea(area.t, area.l, area.t + (vTilesPerThread * tileSize.v), area.l + (hTilesPerThread * tileSize.h));
-    for (uint32 vIndex = 0; vIndex < vTilesinArea; vIndex += vTilesPerThread) {
+    task.Start(threadCount, area, tileSize, &Allocator (), Sniffer ());
 
-        for (uint32 hIndex = 0; hIndex < hTilesinArea; hIndex += hTilesPerThread) {
-            try { areaThreads.push_back(std::thread(executeAreaThread, std::ref(task), areaThreads.size(), threadArea, tileSize, Sniffer ())); }
-            catch (...) { executeAreaThread(task, areaThreads.size(), threadArea, tileSize, Sniffer ()); }
+    std::atomic<uint32> nextTile(0);
+    dng_abort_sniffer *sniffer = Sniffer ();
 
-            threadArea.l = threadArea.r;
-            threadArea.r = Min_int32(threadArea.r + (hTilesPerThread * tileSize.h), area.r);
-        }
+    if (!m_collectStats || inAreaTask) {
+        ThreadPool::global().run(threadCount, [&] (uint32 threadIndex) {
+            AreaTaskScope scope;
+            task.ProcessOnThread(threadIndex, area, tileSize, nextTile, sniffer, progress);
+        });
 
-        threadArea.t = threadArea.b;
-        threadArea.l = area.l;
-        threadArea.b = Min_int32(threadArea.b + (vTilesPerThread * tileSize.v), area.b);
-        threadArea.r = area.l + (hTilesPerThread * tileSize.h);
+        task.Finish(threadCount);
+        return;
     }
 
-   for (auto& areaThread : areaThreads) areaThread.join();
-   if (threadException) std::rethrow_exception(threadException);
+    // same, but timing each thread's share of the work
+    Clock::time_point start(Clock::now());
+    std::atomic<uint64> busyNanoseconds(0);
+
+    ThreadPool::global().run(threadCount, [&] (uint32 threadIndex) {
+        Clock::time_point threadStart(Clock::now());
+        AreaTaskScope scope;
+        task.ProcessOnThread(threadIndex, area, tileSize, nextTile, sniffer, progress);
+        busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - threadStart).count();
+    });
 
-   task.Finish(Min_uint32(task.MaxThreads(), kMaxMPThreads));
+    task.Finish(threadCount);
+    addTaskStats(task.Name(), threadCount, secondsSince(start), busyNanoseconds * 1e-9);
 }
 
 #endif
@@ -19,13 +19,43 @@
 
 #pragma once
 
+#include <map>
+#include <mutex>
+#include <string>
+
 #include "dng_host.h"
 
+// Time spent in one type of area task (tasks are told apart by name), summed over all runs
+struct AreaTaskStats {
+    AreaTaskStats() : runs(0), threads(0), seconds(0.0), busySeconds(0.0), threadSeconds(0.0) {}
+
+    uint32 runs;
+    uint32 threads;        // most threads any run was split across
+    double seconds;        // wall time
+    double busySeconds;    // time the threads actually spent processing tiles, summed over threads
+    double threadSeconds;  // wall time times threads of each run - busySeconds / threadSeconds is the utilisation
+};
+
 class DngHost : public dng_host {
 public:
-    DngHost(dng_memory_allocator *allocator = NULL, dng_abort_sniffer *sniffer = NULL) {}
+    DngHost(dng_memory_allocator *allocator = NULL, dng_abort_sniffer *sniffer = NULL)
+        : dng_host(allocator, sniffer), m_collectStats(false) {}
     ~DngHost(void) {}
 
 public:
     virtual void PerformAreaTask(dng_area_task &task, const dng_rect &area, dng_area_task_progress *progress = NULL);
+    virtual uint32 PerformAreaTaskThreads();
+
+    // Area task timing is only collected once enabled. Only top-level tasks are recorded,
+    // not those nested in them
+    void setCollectStats(bool collect) {m_collectStats = collect;}
+    std::map<std::string, AreaTaskStats> areaTaskStats() const;
+    void resetStats();
+
+private:
+    void addTaskStats(const char *name, uint32 threads, double seconds, double busySeconds);
+
+    bool m_collectStats;
+    mutable std::mutex m_statsMutex;
+    std::map<std::string, AreaTaskStats> m_taskStats;
 };
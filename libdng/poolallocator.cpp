@@ -0,0 +1,461 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "poolallocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dng_exceptions.h"
+
+// Smaller requests aren't worth pooling and are just passed on to the system
+static const size_t minPooledBytes = 1024;
+
+// Size classes: 4 KB, then four per power of two (5/4, 6/4, 7/4 and 8/4 of the one below)
+static const size_t minClassBytes = 4096;
+static const uint32 classCount = 1 + (64 - 12) * 4;
+static const uint32 unpooled = UINT32_MAX;
+
+// Per-thread caches: blocks of up to 1 MB, at most four per class
+static const size_t threadCacheMaxBytes = 1 << 20;
+static const size_t threadCacheDepth = 4;
+static const uint32 threadClassCount = 1 + (20 - 12) * 4;
+
+// Malloc() keeps the block size in front of the memory it returns
+static const size_t mallocHeader = 16;
+static const size_t memoryAlignment = 64;
+
+// Large page mode maps blocks from 4 MB up separately, in multiples of 2 MB pages
+static const size_t largeBlockBytes = 4 << 20;
+static const size_t largePageBytes = 2 << 20;
+
+#if defined(MAP_HUGETLB) && !defined(MAP_HUGE_2MB)
+#define MAP_HUGE_2MB (21 << 26)
+#endif
+
+
+static uint32 sizeClass(size_t bytes, size_t &classBytes) {
+    if (bytes < minPooledBytes) {
+        classBytes = bytes;
+        return unpooled;
+    }
+    if (bytes <= minClassBytes) {
+        classBytes = minClassBytes;
+        return 0;
+    }
+
+    uint32 log2 = 63 - __builtin_clzll(static_cast<unsigned long long>(bytes - 1));
+    size_t step = static_cast<size_t>(1) << (log2 - 2);
+    classBytes = (bytes + step - 1) & ~(step - 1);
+    return 1 + (log2 - 12) * 4 + static_cast<uint32>(classBytes / step) - 5;
+}
+
+
+static size_t classSize(uint32 index) {
+    if (index == 0) return minClassBytes;
+    uint32 log2 = 12 + (index - 1) / 4;
+    return static_cast<size_t>(5 + (index - 1) % 4) << (log2 - 2);
+}
+
+
+static size_t largeLength(size_t bytes) {
+    return (bytes + largePageBytes - 1) & ~(largePageBytes - 1);
+}
+
+
+static bool hasNumaNodes() {
+    struct stat node;
+    return stat("/sys/devices/system/node/node1", &node) == 0;
+}
+
+
+// -----------------------------------------------------------------------------------------
+// A thread's cache holds blocks of one allocator at a time. When the thread switches to
+// another allocator or exits, its blocks go back to their allocator's shared lists - or to
+// the system, if that allocator has been destroyed in the meantime. The allocator keeps a
+// list of the caches holding its blocks, so that releaseCached() can take them back; the
+// cache's own mutex is only ever contended then. Lock order: liveMutex, m_mutex, cache mutex
+
+static std::mutex liveMutex;
+static std::set<uint64> liveAllocators;
+static std::atomic<uint64> nextAllocatorId(1);
+
+struct PoolAllocator::ThreadCache {
+    ThreadCache() : owner(0), allocator(NULL), lists(threadClassCount) {}
+    ~ThreadCache() {release();}
+
+    void release() {
+        std::lock_guard<std::mutex> liveLock(liveMutex);
+
+        if ((owner != 0) && (liveAllocators.count(owner) > 0)) {
+            std::lock_guard<std::mutex> poolLock(allocator->m_mutex);
+            std::lock_guard<std::mutex> lock(mutex);
+            for (uint32 index = 0; index < threadClassCount; index++) {
+                std::vector<void*> &freeList = allocator->m_freeLists[index];
+                freeList.insert(freeList.end(), lists[index].begin(), lists[index].end());
+                lists[index].clear();
+            }
+            std::vector<ThreadCache*> &caches = allocator->m_threadCaches;
+            caches.erase(std::find(caches.begin(), caches.end(), this));
+        }
+        else {
+            // a destroyed allocator has already taken back its blocks
+            std::lock_guard<std::mutex> lock(mutex);
+            for (uint32 index = 0; index < threadClassCount; index++) {
+                for (void *memory : lists[index]) free(memory);
+                lists[index].clear();
+            }
+        }
+
+        owner = 0;
+        allocator = NULL;
+    }
+
+    std::mutex mutex;
+    uint64 owner;
+    PoolAllocator *allocator;
+    std::vector<std::vector<void*>> lists;
+};
+
+
+// Memory block whose memory goes back to the pool when it's deleted
+class PoolAllocator::Block : public dng_memory_block {
+public:
+    Block(PoolAllocator &pool, uint32 size) : dng_memory_block(size), m_pool(pool), m_bytes(PhysicalSize()) {
+        m_memory = m_pool.take(m_bytes);
+        if (m_memory == NULL) ThrowMemoryFull();
+        SetBuffer(m_memory);
+    }
+
+    virtual ~Block() {m_pool.give(m_memory, m_bytes);}
+
+private:
+    PoolAllocator &m_pool;
+    size_t m_bytes;
+    void *m_memory;
+};
+
+
+// -----------------------------------------------------------------------------------------
+
+PoolAllocator::PoolAllocator(uint64 cacheLimit, LargePages largePages)
+    : m_id(nextAllocatorId++), m_largePages(largePages), m_firstTouch((largePages != largePagesOff) && hasNumaNodes()), m_limit(0), m_cacheLimit(cacheLimit), m_inUse(0), m_cached(0), m_highWater(0),
+      m_allocations(0), m_recycled(0), m_freeLists(classCount) {
+    std::lock_guard<std::mutex> lock(liveMutex);
+    liveAllocators.insert(m_id);
+}
+
+
+PoolAllocator::~PoolAllocator() {
+    {
+        std::lock_guard<std::mutex> liveLock(liveMutex);
+        liveAllocators.erase(m_id);
+
+        // threads still holding our blocks won't touch their caches' lists for us any more
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (ThreadCache *cache : m_threadCaches) {
+            std::lock_guard<std::mutex> cacheLock(cache->mutex);
+            for (uint32 index = 0; index < threadClassCount; index++) {
+                m_freeLists[index].insert(m_freeLists[index].end(), cache->lists[index].begin(), cache->lists[index].end());
+                cache->lists[index].clear();
+            }
+        }
+        m_threadCaches.clear();
+    }
+    trim();
+}
+
+
+dng_memory_block* PoolAllocator::Allocate(uint32 size) {
+    return new Block(*this, size);
+}
+
+
+void* PoolAllocator::Malloc(size_t size) {
+    if (size > SIZE_MAX - mallocHeader) return NULL;
+
+    uint8 *memory = static_cast<uint8*>(take(size + mallocHeader));
+    if (memory == NULL) return NULL;
+
+    *reinterpret_cast<size_t*>(memory) = size + mallocHeader;
+    return memory + mallocHeader;
+}
+
+
+void PoolAllocator::Free(void *ptr) {
+    if (ptr == NULL) return;
+
+    uint8 *memory = static_cast<uint8*>(ptr) - mallocHeader;
+    give(memory, *reinterpret_cast<size_t*>(memory));
+}
+
+
+void PoolAllocator::setCacheLimit(uint64 bytes) {
+    m_cacheLimit = bytes;
+    if (m_cached > bytes) releaseCached(m_cached - bytes);
+}
+
+
+void PoolAllocator::trim() {
+    releaseCached(UINT64_MAX);
+}
+
+
+PoolAllocator::Stats PoolAllocator::stats() const {
+    Stats stats;
+    stats.inUse = m_inUse;
+    stats.cached = m_cached;
+    stats.highWater = m_highWater;
+    stats.allocations = m_allocations;
+    stats.recycled = m_recycled;
+    return stats;
+}
+
+
+static const char* largePagesNames[] = {"off", "transparent", "explicit"};
+
+const char* PoolAllocator::name(LargePages largePages) {
+    return largePagesNames[largePages];
+}
+
+
+bool PoolAllocator::parse(const char *name, LargePages &largePages) {
+    for (int mode = largePagesOff; mode <= largePagesExplicit; mode++)
+        if (strcmp(name, largePagesNames[mode]) == 0) {
+            largePages = static_cast<LargePages>(mode);
+            return true;
+        }
+    return false;
+}
+
+
+// -----------------------------------------------------------------------------------------
+
+void* PoolAllocator::take(size_t bytes) {
+    size_t classBytes;
+    uint32 index = sizeClass(bytes, classBytes);
+    m_allocations++;
+
+    if (index != unpooled) {
+        void *memory = NULL;
+
+        if (classBytes <= threadCacheMaxBytes) {
+            ThreadCache &cache = threadCache();
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            std::vector<void*> &list = cache.lists[index];
+            if (!list.empty()) {
+                memory = list.back();
+                list.pop_back();
+            }
+        }
+        if (memory == NULL) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::vector<void*> &list = m_freeLists[index];
+            if (!list.empty()) {
+                memory = list.back();
+                list.pop_back();
+            }
+        }
+        if (memory != NULL) {
+            // in use before no longer cached, so that the footprint is never under-counted
+            m_inUse += classBytes;
+            m_cached -= classBytes;
+            m_recycled++;
+            return memory;
+        }
+    }
+
+    return allocateMemory(classBytes);
+}
+
+
+void PoolAllocator::give(void *memory, size_t bytes) {
+    size_t classBytes;
+    uint32 index = sizeClass(bytes, classBytes);
+
+    if (index != unpooled) {
+        if ((classBytes <= threadCacheMaxBytes) && (m_cached + classBytes <= m_cacheLimit)) {
+            ThreadCache &cache = threadCache();
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            std::vector<void*> &list = cache.lists[index];
+            if (list.size() < threadCacheDepth) {
+                list.push_back(memory);
+                m_cached += classBytes;
+                m_inUse -= classBytes;
+                return;
+            }
+        }
+
+        // let the next user's threads fault the pages in again on their own nodes
+        if (m_firstTouch && isLarge(classBytes)) madvise(memory, largeLength(classBytes), MADV_DONTNEED);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cached + classBytes <= m_cacheLimit) {
+            m_freeLists[index].push_back(memory);
+            m_cached += classBytes;
+            m_inUse -= classBytes;
+            return;
+        }
+    }
+
+    releaseMemory(memory, classBytes);
+    m_inUse -= classBytes;
+}
+
+
+void* PoolAllocator::allocateMemory(size_t bytes) {
+    // Reserve the bytes before allocating them. Only reservations grow the footprint, and with
+    // a hard limit they are made under m_mutex, so concurrent allocations can't all pass the
+    // check - cached blocks are given up first to stay below it
+    uint64 limit = m_limit;
+    if (limit > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64 footprint = m_inUse + m_cached + bytes;
+        if (footprint > limit) releaseCachedLocked(footprint - limit);
+        if (m_inUse + m_cached + bytes > limit) return NULL;
+        m_inUse += bytes;
+    }
+    else
+        m_inUse += bytes;
+
+    void *memory = NULL;
+    bool failed = false;
+    if (isLarge(bytes)) {
+        memory = mapLarge(bytes);
+        if (memory == NULL) {
+            trim();
+            failed = (memory = mapLarge(bytes)) == NULL;
+        }
+    }
+    else if (posix_memalign(&memory, memoryAlignment, bytes) != 0) {
+        trim();
+        failed = posix_memalign(&memory, memoryAlignment, bytes) != 0;
+    }
+
+    if (failed) {
+        m_inUse -= bytes;
+        return NULL;
+    }
+
+    updateHighWater();
+    return memory;
+}
+
+
+void PoolAllocator::releaseMemory(void *memory, size_t bytes) {
+    if (isLarge(bytes))
+        munmap(memory, largeLength(bytes));
+    else
+        free(memory);
+}
+
+
+void* PoolAllocator::mapLarge(size_t bytes) {
+    size_t length = largeLength(bytes);
+
+#ifdef MAP_HUGETLB
+    if (m_largePages == largePagesExplicit) {
+        void *memory = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+        if (memory != MAP_FAILED) return memory;
+    }
+#endif
+
+    // transparent huge pages need 2 MB aligned memory: map one page more and cut off the ends
+    size_t mapped = length + largePageBytes;
+    void *region = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) return NULL;
+
+    uint8 *start = static_cast<uint8*>(region);
+    uint8 *memory = reinterpret_cast<uint8*>((reinterpret_cast<uintptr_t>(start) + largePageBytes - 1) & ~(largePageBytes - 1));
+    if (memory > start) munmap(start, memory - start);
+    if (start + mapped > memory + length) munmap(memory + length, start + mapped - (memory + length));
+
+#ifdef MADV_HUGEPAGE
+    madvise(memory, length, MADV_HUGEPAGE);
+#endif
+    return memory;
+}
+
+
+bool PoolAllocator::isLarge(size_t bytes) const {
+    return (m_largePages != largePagesOff) && (bytes >= largeBlockBytes);
+}
+
+
+void PoolAllocator::releaseCached(uint64 bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    releaseCachedLocked(bytes);
+}
+
+
+void PoolAllocator::releaseCachedLocked(uint64 bytes) {
+    // biggest blocks first - they are the rarest to be reused
+    uint64 released = 0;
+    for (uint32 index = classCount; (index-- > 0) && (released < bytes);) {
+        std::vector<void*> &list = m_freeLists[index];
+        size_t classBytes = classSize(index);
+        while (!list.empty() && (released < bytes)) {
+            releaseMemory(list.back(), classBytes);
+            list.pop_back();
+            m_cached -= classBytes;
+            released += classBytes;
+        }
+    }
+
+    // then the blocks idling in the threads' caches (none of them large)
+    for (size_t cache = 0; (cache < m_threadCaches.size()) && (released < bytes); cache++) {
+        std::lock_guard<std::mutex> lock(m_threadCaches[cache]->mutex);
+        for (uint32 index = threadClassCount; (index-- > 0) && (released < bytes);) {
+            std::vector<void*> &list = m_threadCaches[cache]->lists[index];
+            size_t classBytes = classSize(index);
+            while (!list.empty() && (released < bytes)) {
+                free(list.back());
+                list.pop_back();
+                m_cached -= classBytes;
+                released += classBytes;
+            }
+        }
+    }
+}
+
+
+void PoolAllocator::updateHighWater() {
+    uint64 footprint = m_inUse + m_cached;
+    uint64 highWater = m_highWater;
+    while ((footprint > highWater) && !m_highWater.compare_exchange_weak(highWater, footprint)) {}
+}
+
+
+PoolAllocator::ThreadCache& PoolAllocator::threadCache() {
+    static thread_local ThreadCache cache;
+    if (cache.owner != m_id) {
+        cache.release();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_threadCaches.push_back(&cache);
+        cache.owner = m_id;
+        cache.allocator = this;
+    }
+    return cache;
+}
@@ -0,0 +1,112 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "dng_memory.h"
+
+// Allocator that recycles memory instead of returning it to the system. Blocks are rounded up
+// to size classes (four per power of two) and freed blocks are kept on free lists per class,
+// so the image, tile and stream buffers of one conversion are reused by the next instead of
+// going through mmap/munmap every time.
+//
+// Blocks of up to 1 MB (the tile buffers) are cached per thread first and only go to the
+// shared, locked lists when a thread's cache is full. Memory held on the free lists and in the
+// thread caches is capped (setCacheLimit), and an optional hard limit (setLimit) makes
+// allocations fail rather than let memory in use and cached grow beyond it. Allocations reserve
+// their bytes against that limit before they are made, and cached blocks - including those in
+// other threads' caches - are released to make room.
+//
+// With large pages, blocks of 4 MB and more (the image buffers) get their own mappings backed
+// by 2 MB pages - transparent huge pages, or pages from the kernel's hugetlb pool (falling
+// back to transparent ones when it runs out). The allocator never touches that memory, so
+// each page is placed on the NUMA node of the worker thread that first writes a tile into
+// it. On NUMA machines recycled large blocks drop their pages for the same reason.
+class PoolAllocator : public dng_memory_allocator {
+public:
+    struct Stats {
+        uint64 inUse;        // bytes handed out (rounded up to their size class)
+        uint64 cached;       // bytes held on free lists for reuse
+        uint64 highWater;    // most bytes in use and cached at any one time
+        uint64 allocations;  // allocations in total ...
+        uint64 recycled;     // ... and those served from a free list
+    };
+
+    enum LargePages {
+        largePagesOff,
+        largePagesTransparent,
+        largePagesExplicit
+    };
+
+    explicit PoolAllocator(uint64 cacheLimit = defaultCacheLimit, LargePages largePages = largePagesOff);
+    virtual ~PoolAllocator();
+
+    virtual dng_memory_block* Allocate(uint32 size);
+    virtual void* Malloc(size_t size);
+    virtual void Free(void *ptr);
+
+    // Hard limit on memory in use and cached (0 = none): cached blocks are released to stay
+    // below it, allocations that would still exceed it fail (dng_error_memory)
+    void setLimit(uint64 bytes) {m_limit = bytes;}
+    uint64 limit() const {return m_limit;}
+
+    void setCacheLimit(uint64 bytes);
+
+    // Returns all cached memory, on the shared free lists and in the thread caches, to the system
+    void trim();
+
+    Stats stats() const;
+    LargePages largePages() const {return m_largePages;}
+
+    // "off", "transparent" or "explicit"
+    static const char* name(LargePages largePages);
+    static bool parse(const char *name, LargePages &largePages);
+
+    static const uint64 defaultCacheLimit = 1024ull << 20;
+
+private:
+    class Block;
+    struct ThreadCache;
+
+    void* take(size_t bytes);
+    void give(void *memory, size_t bytes);
+
+    void* allocateMemory(size_t bytes);
+    void releaseMemory(void *memory, size_t bytes);
+    void* mapLarge(size_t bytes);
+    bool isLarge(size_t bytes) const;
+    void releaseCached(uint64 bytes);
+    void releaseCachedLocked(uint64 bytes);
+    void updateHighWater();
+
+    ThreadCache& threadCache();
+
+    const uint64 m_id;
+    const LargePages m_largePages;
+    const bool m_firstTouch;
+    std::atomic<uint64> m_limit, m_cacheLimit;
+    std::atomic<uint64> m_inUse, m_cached, m_highWater, m_allocations, m_recycled;
+
+    std::mutex m_mutex;
+    std::vector<std::vector<void*>> m_freeLists;
+    std::vector<ThreadCache*> m_threadCaches;
+};
@@ -0,0 +1,255 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "posixfilestream.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dng_exceptions.h"
+
+// O_DIRECT needs offsets, sizes and memory aligned to the device's logical block size
+static const uint64 directAlignment = 4096;
+
+
+static bool writeAll(int file, const uint8 *data, uint64 count, uint64 offset) {
+    while (count > 0) {
+        ssize_t written = pwrite(file, data, count, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (written == 0) return false;
+        data += written;
+        count -= written;
+        offset += written;
+    }
+    return true;
+}
+
+
+// -----------------------------------------------------------------------------------------
+
+PosixFileStream::PosixFileStream(const char *filename, bool output, uint32 bufferSize, bool directWrite)
+    : dng_stream(static_cast<dng_abort_sniffer*>(NULL), bufferSize, 0),
+      m_file(-1), m_directFile(-1), m_directBuffer(NULL), m_directBufferSize(0), m_maxInFlight(0), m_inFlight(0),
+      m_writeFailed(false), m_stopWriter(false) {
+    m_file = output ? open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)
+                    : open(filename, O_RDONLY | O_CLOEXEC);
+    if (m_file < 0) ThrowOpenFile();
+
+    if (!output) {
+        posix_fadvise(m_file, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return;
+    }
+
+#ifdef O_DIRECT
+    if (directWrite) {
+        // a second descriptor for the aligned writes, the first one takes care of the rest
+        m_directBufferSize = static_cast<uint32>((bufferSize + directAlignment - 1) & ~(directAlignment - 1));
+        void *buffer = NULL;
+        if (posix_memalign(&buffer, directAlignment, m_directBufferSize) != 0) {
+            close(m_file);
+            ThrowMemoryFull();
+        }
+        m_directBuffer = static_cast<uint8*>(buffer);
+        m_directFile = open(filename, O_WRONLY | O_DIRECT | O_CLOEXEC);
+    }
+#else
+    (void) directWrite;
+#endif
+}
+
+
+PosixFileStream::~PosixFileStream() {
+    // whatever is still queued gets written before the writer stops
+    if (m_writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopWriter = true;
+        }
+        m_queued.notify_one();
+        m_writer.join();
+    }
+
+    if (m_directFile >= 0) {
+        close(m_directFile);
+        posix_fadvise(m_file, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    if (m_file >= 0) close(m_file);
+    free(m_directBuffer);
+}
+
+
+void PosixFileStream::setWriteBehind(uint64 maxInFlight) {
+    drain();
+    m_maxInFlight = maxInFlight;
+    if ((maxInFlight > 0) && !m_writer.joinable()) m_writer = std::thread(&PosixFileStream::writerLoop, this);
+}
+
+
+void PosixFileStream::finish() {
+    Flush();
+    drain();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_writeFailed) ThrowWriteFile();
+}
+
+
+uint64 PosixFileStream::DoGetLength() {
+    drain();
+
+    struct stat status;
+    if (fstat(m_file, &status) != 0) ThrowReadFile();
+    return static_cast<uint64>(status.st_size);
+}
+
+
+void PosixFileStream::DoRead(void *data, uint32 count, uint64 offset) {
+    drain();
+
+    uint8 *bytes = static_cast<uint8*>(data);
+    while (count > 0) {
+        ssize_t bytesRead = pread(m_file, bytes, count, static_cast<off_t>(offset));
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            ThrowReadFile();
+        }
+        if (bytesRead == 0) ThrowReadFile();  // beyond the end of the file
+        bytes += bytesRead;
+        count -= static_cast<uint32>(bytesRead);
+        offset += bytesRead;
+    }
+}
+
+
+void PosixFileStream::DoWrite(const void *data, uint32 count, uint64 offset) {
+    if (m_maxInFlight == 0) {
+        writeNow(static_cast<const uint8*>(data), count, offset);
+        return;
+    }
+
+    // wait for room in the queue - a write bigger than all of it waits for the queue to be empty
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_written.wait(lock, [&] {return m_writeFailed || (m_inFlight == 0) || (m_inFlight + count <= m_maxInFlight);});
+    if (m_writeFailed) ThrowWriteFile();
+    m_inFlight += count;
+    lock.unlock();
+
+    // copy to memory aligned like the file offset, so direct writes need no further copy
+    size_t skew = static_cast<size_t>(offset & (directAlignment - 1));
+    void *memory = NULL;
+    if (posix_memalign(&memory, directAlignment, skew + count) != 0) {
+        lock.lock();
+        m_inFlight -= count;
+        m_written.notify_all();
+        ThrowMemoryFull();
+    }
+
+    PendingWrite write = {static_cast<uint8*>(memory), static_cast<uint8*>(memory) + skew, count, offset};
+    memcpy(write.data, data, count);
+
+    lock.lock();
+    m_pending.push_back(write);
+    m_queued.notify_one();
+}
+
+
+void PosixFileStream::DoSetLength(uint64 length) {
+    drain();
+
+    if (ftruncate(m_file, static_cast<off_t>(length)) != 0) ThrowWriteFile();
+}
+
+
+void PosixFileStream::writeNow(const uint8 *bytes, uint32 count, uint64 offset) {
+    if (m_directFile >= 0) {
+        uint64 start = (offset + directAlignment - 1) & ~(directAlignment - 1);
+        uint64 end = (offset + count) & ~(directAlignment - 1);
+        if (end > start) {
+            if (!writeAll(m_file, bytes, start - offset, offset)) ThrowWriteFile();
+            writeDirect(bytes + (start - offset), end - start, start);
+            if (!writeAll(m_file, bytes + (end - offset), offset + count - end, end)) ThrowWriteFile();
+            return;
+        }
+    }
+
+    if (!writeAll(m_file, bytes, count, offset)) ThrowWriteFile();
+}
+
+
+void PosixFileStream::writeDirect(const uint8 *data, uint64 count, uint64 offset) {
+    // dng_stream's buffer or the caller's data - copy it to aligned memory unless it already is.
+    // Should the device refuse a direct write after all, it's simply repeated through the cache
+    if ((reinterpret_cast<uintptr_t>(data) & (directAlignment - 1)) == 0) {
+        if (!writeAll(m_directFile, data, count, offset) && !writeAll(m_file, data, count, offset)) ThrowWriteFile();
+        return;
+    }
+
+    while (count > 0) {
+        uint64 chunk = (count < m_directBufferSize) ? count : m_directBufferSize;
+        memcpy(m_directBuffer, data, chunk);
+        if (!writeAll(m_directFile, m_directBuffer, chunk, offset) && !writeAll(m_file, data, chunk, offset))
+            ThrowWriteFile();
+        data += chunk;
+        count -= chunk;
+        offset += chunk;
+    }
+}
+
+
+void PosixFileStream::writerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_queued.wait(lock, [&] {return m_stopWriter || !m_pending.empty();});
+        if (m_pending.empty()) return;
+
+        PendingWrite write = m_pending.front();
+        m_pending.pop_front();
+        bool skip = m_writeFailed;
+        lock.unlock();
+
+        // after the first failure, the rest is dropped - the file is broken anyway
+        bool failed = false;
+        if (!skip) {
+            try {writeNow(write.data, write.count, write.offset);}
+            catch (...) {failed = true;}
+        }
+        free(write.memory);
+
+        lock.lock();
+        if (failed) m_writeFailed = true;
+        m_inFlight -= write.count;
+        m_written.notify_all();
+    }
+}
+
+
+void PosixFileStream::drain() {
+    if (!m_writer.joinable()) return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_written.wait(lock, [&] {return m_inFlight == 0;});
+}
@@ -0,0 +1,85 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "dng_stream.h"
+
+// Stream on a POSIX file: reads and writes with pread/pwrite at 64-bit offsets through a
+// large buffer (dng_file_stream goes through stdio with a 4 KB buffer and 32-bit offsets).
+//
+// Input files get a sequential access hint. Output can bypass the page cache (directWrite):
+// the block-aligned part of every write goes to the file with O_DIRECT, only the few bytes
+// at its unaligned ends go through the page cache, which is dropped once the file is closed.
+// File systems without O_DIRECT get normal buffered writes.
+//
+// With write-behind, writes are copied to a queue and a writer thread of the stream puts
+// them into the file, so the threads encoding the image don't wait for the storage.
+class PosixFileStream : public dng_stream {
+public:
+    PosixFileStream(const char *filename, bool output = false, uint32 bufferSize = defaultBufferSize,
+                    bool directWrite = false);
+    virtual ~PosixFileStream();
+
+    // Whether writes actually bypass the page cache
+    bool isDirect() const {return m_directFile >= 0;}
+
+    // Queues writes for the writer thread, which is never more than maxInFlight bytes behind
+    // (0 writes synchronously again). Reads and length changes wait for the queue to be written
+    void setWriteBehind(uint64 maxInFlight);
+
+    // Flushes the stream and waits for all queued writes, throws if any of them failed
+    void finish();
+
+    static const uint32 defaultBufferSize = 4 << 20;
+
+protected:
+    virtual uint64 DoGetLength();
+    virtual void DoRead(void *data, uint32 count, uint64 offset);
+    virtual void DoWrite(const void *data, uint32 count, uint64 offset);
+    virtual void DoSetLength(uint64 length);
+
+private:
+    struct PendingWrite {
+        uint8 *memory;
+        uint8 *data;
+        uint32 count;
+        uint64 offset;
+    };
+
+    void writeNow(const uint8 *data, uint32 count, uint64 offset);
+    void writeDirect(const uint8 *data, uint64 count, uint64 offset);
+    void writerLoop();
+    void drain();
+
+    int m_file, m_directFile;
+    uint8 *m_directBuffer;
+    uint32 m_directBufferSize;
+
+    uint64 m_maxInFlight, m_inFlight;
+    std::deque<PendingWrite> m_pending;
+    bool m_writeFailed, m_stopWriter;
+    std::mutex m_mutex;
+    std::condition_variable m_queued, m_written;
+    std::thread m_writer;
+};
@@ -0,0 +1,569 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+// Vector kernels behind simdsuite.cpp. This header is included by one translation unit per
+// instruction set (simdsuite_sse41.cpp, ...), each compiled with its own -m flags and
+// providing a vector type V. Everything in here has internal linkage so that no code built
+// for one instruction set can end up being called through another unit's symbols - for the
+// same reason, nothing but dng_types.h and the intrinsics headers may be included.
+//
+// All kernels compute exactly what their Ref* counterparts in dng_reference.cpp compute, in
+// the same order of operations (the units are built with -ffp-contract=off), so the results
+// are bit-identical. Lanes that don't fill a whole vector go through the same code with the
+// one-lane ScalarVec.
+
+#include "dng_types.h"
+
+
+// dng_hue_sat_map baked for the HueSatMap kernel (see BakedHueSatMap in simdsuite.cpp): one
+// array per component instead of HSBModify triples, so that each can be gathered, and the
+// hue dimension padded with a copy of hue 0 so that interpolation never needs to wrap around.
+// Scales and limits are the ones RefBaselineHueSatMap derives from the divisions.
+struct HueSatTable {
+    bool is3D;
+    int32 hueStep, valStep;
+    real32 hScale, sScale, vScale;
+    int32 maxHueIndex0, maxSatIndex0, maxValIndex0;
+    const real32 *hueShift, *satScale, *valScale;
+};
+
+// dng_baseline_render_params unpacked for the Render kernels. Optional steps are NULL when
+// absent; the hue/sat encoding tables follow the rules of the HueSatMap kernel.
+struct RenderTables {
+    real32 srcScale;
+    const real32 *zeroOffsetRamp; uint32 zeroOffsetCount;
+    real32 clip[3], cameraToRGB[9];
+    const HueSatTable *hueSatMap;
+    const real32 *hueSatEncode, *hueSatDecode; uint32 hueSatEncodeCount, hueSatDecodeCount;
+    const real32 *exposureRamp; uint32 exposureCount;
+    const HueSatTable *lookTable;
+    const real32 *lookEncode, *lookDecode; uint32 lookEncodeCount, lookDecodeCount;
+    const real32 *toneCurve; uint32 toneCount;
+    real32 rgbToFinal[9];
+    const real32 *encodeGamma; uint32 gammaCount;
+};
+
+// Plain-argument kernels, filled in per instruction set. A NULL entry keeps the Ref* routine.
+struct SimdKernels {
+    void (*copy16ToR32)(const uint16 *sPtr, real32 *dPtr, uint32 count, real32 scale);
+
+    void (*abcToRGB)(const real32 *sPtrA, const real32 *sPtrB, const real32 *sPtrC,
+                     real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                     const real32 *clip, const real32 *matrix);
+
+    void (*rgbTone)(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                    real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                    const real32 *table, uint32 tableCount);
+
+    void (*resampleDown32)(const real32 *sPtr, real32 *dPtr, uint32 sCount, int32 sRowStep,
+                           const real32 *wPtr, uint32 wCount);
+
+    void (*vignette16)(int16 *sPtr, const uint16 *mPtr, uint32 count, uint32 mBits);
+
+    void (*mapRow16)(uint16 *dPtr, uint32 count, const uint16 *map);
+
+    // encodeTable/decodeTable are both given or both NULL
+    void (*hueSatMap)(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                      real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count, const HueSatTable &table,
+                      const real32 *encodeTable, uint32 encodeCount, const real32 *decodeTable, uint32 decodeCount);
+
+    void (*render8)(const uint16 *sPtrA, const uint16 *sPtrB, const uint16 *sPtrC,
+                    uint8 *dPtrR, uint8 *dPtrG, uint8 *dPtrB, uint32 count, const RenderTables &tables);
+    void (*render16)(const uint16 *sPtrA, const uint16 *sPtrB, const uint16 *sPtrC,
+                     uint16 *dPtrR, uint16 *dPtrG, uint16 *dPtrB, uint32 count, const RenderTables &tables);
+};
+
+void getSSE41Kernels(SimdKernels &kernels);
+void getAVX2Kernels(SimdKernels &kernels);
+void getAVX512Kernels(SimdKernels &kernels);
+
+
+#ifdef SIMD_KERNEL_TEMPLATES
+
+namespace {
+
+// One-lane vector, used for the tail of every row
+struct ScalarVec {
+    static const uint32 N = 1;
+    typedef real32 F;
+    typedef uint32 I;
+    typedef bool M;
+
+    static F load(const real32 *p) {return *p;}
+    static void store(real32 *p, F x) {*p = x;}
+    static F set1(real32 x) {return x;}
+
+    static F add(F a, F b) {return a + b;}
+    static F sub(F a, F b) {return a - b;}
+    static F mul(F a, F b) {return a * b;}
+    static F div(F a, F b) {return a / b;}
+    static F min(F a, F b) {return (a < b) ? a : b;}
+    static F max(F a, F b) {return (a > b) ? a : b;}
+
+    static M cmpGE(F a, F b) {return a >= b;}
+    static M cmpGT(F a, F b) {return a > b;}
+    static M cmpEQ(F a, F b) {return a == b;}
+    static M mAnd(M a, M b) {return a && b;}
+    static M mOr(M a, M b) {return a || b;}
+    static M mAndNot(M a, M b) {return !a && b;}
+    static F select(M m, F a, F b) {return m ? a : b;}
+
+    static I truncate(F x) {return static_cast<uint32>(static_cast<int32>(x));}
+    static F toFloat(I x) {return static_cast<real32>(static_cast<int32>(x));}
+    static F gather(const real32 *table, I index) {return table[static_cast<int32>(index)];}
+
+    static I loadU16(const uint16 *p) {return *p;}
+    static I loadS16(const int16 *p) {return static_cast<uint32>(*p + 32768);}
+    static void storeS16(int16 *p, I x) {*p = static_cast<int16>(static_cast<int32>(x) - 32768);}
+    static void storeU16(uint16 *p, I x) {*p = static_cast<uint16>(x);}
+    static void storeU8(uint8 *p, I x) {*p = static_cast<uint8>(x);}
+    static I set1i(uint32 x) {return x;}
+    static I addi(I a, I b) {return a + b;}
+    static I mullo(I a, I b) {return a * b;}
+    static I srl(I a, uint32 bits) {return a >> bits;}
+    static I minu(I a, I b) {return (a < b) ? a : b;}
+    static I mini(I a, I b) {return (static_cast<int32>(a) < static_cast<int32>(b)) ? a : b;}
+    static M cmpEQi(I a, I b) {return a == b;}
+    static F u16ToFloat(const uint16 *p) {return static_cast<real32>(*p);}
+};
+
+
+// -----------------------------------------------------------------------------------------
+// CopyArea16_R32 (one row of one plane)
+
+template <class V> inline void copy16ToR32Step(const uint16 *sPtr, real32 *dPtr, typename V::F scale) {
+    V::store(dPtr, V::mul(scale, V::u16ToFloat(sPtr)));
+}
+
+template <class V> void copy16ToR32(const uint16 *sPtr, real32 *dPtr, uint32 count, real32 scale) {
+    uint32 col = 0;
+    for (; col + V::N <= count; col += V::N)
+        copy16ToR32Step<V>(sPtr + col, dPtr + col, V::set1(scale));
+    for (; col < count; col++)
+        copy16ToR32Step<ScalarVec>(sPtr + col, dPtr + col, scale);
+}
+
+
+// -----------------------------------------------------------------------------------------
+// BaselineABCtoRGB
+
+template <class V> inline typename V::F pin01(typename V::F x) {
+    return V::max(V::set1(0.0f), V::min(x, V::set1(1.0f)));
+}
+
+// In: A, B, C in r, g, b
+template <class V> inline void abcToRGBPixels(typename V::F &r, typename V::F &g, typename V::F &b,
+                                              const real32 *clip, const real32 *m) {
+    typedef typename V::F F;
+
+    F A = V::min(r, V::set1(clip[0]));
+    F B = V::min(g, V::set1(clip[1]));
+    F C = V::min(b, V::set1(clip[2]));
+
+    r = pin01<V>(V::add(V::add(V::mul(V::set1(m[0]), A), V::mul(V::set1(m[1]), B)), V::mul(V::set1(m[2]), C)));
+    g = pin01<V>(V::add(V::add(V::mul(V::set1(m[3]), A), V::mul(V::set1(m[4]), B)), V::mul(V::set1(m[5]), C)));
+    b = pin01<V>(V::add(V::add(V::mul(V::set1(m[6]), A), V::mul(V::set1(m[7]), B)), V::mul(V::set1(m[8]), C)));
+}
+
+template <class V> inline void abcToRGBStep(const real32 *sPtrA, const real32 *sPtrB, const real32 *sPtrC,
+                                            real32 *dPtrR, real32 *dPtrG, real32 *dPtrB,
+                                            const real32 *clip, const real32 *m) {
+    typename V::F r = V::load(sPtrA), g = V::load(sPtrB), b = V::load(sPtrC);
+    abcToRGBPixels<V>(r, g, b, clip, m);
+
+    V::store(dPtrR, r);
+    V::store(dPtrG, g);
+    V::store(dPtrB, b);
+}
+
+template <class V> void abcToRGB(const real32 *sPtrA, const real32 *sPtrB, const real32 *sPtrC,
+                                 real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                                 const real32 *clip, const real32 *matrix) {
+    uint32 col = 0;
+    for (; col + V::N <= count; col += V::N)
+        abcToRGBStep<V>(sPtrA + col, sPtrB + col, sPtrC + col, dPtrR + col, dPtrG + col, dPtrB + col, clip, matrix);
+    for (; col < count; col++)
+        abcToRGBStep<ScalarVec>(sPtrA + col, sPtrB + col, sPtrC + col, dPtrR + col, dPtrG + col, dPtrB + col, clip, matrix);
+}
+
+
+// -----------------------------------------------------------------------------------------
+// BaselineRGBTone: the seven orderings of RefBaselineRGBTone become masks. The largest and
+// smallest channel go through the tone curve, the middle one is interpolated between them
+// (case 4, r >= g == b, takes the curve value of g for both g and b).
+
+template <class V> inline typename V::F interpolate(const real32 *table, uint32 tableCount, typename V::F x) {
+    typedef typename V::F F;
+
+    F y = V::mul(x, V::set1(static_cast<real32>(tableCount)));
+    typename V::I index = V::truncate(y);
+    F fract = V::sub(y, V::toFloat(index));
+
+    return V::add(V::mul(V::gather(table, index), V::sub(V::set1(1.0f), fract)),
+                  V::mul(V::gather(table + 1, index), fract));
+}
+
+template <class V> inline void rgbTonePixels(typename V::F &r, typename V::F &g, typename V::F &b,
+                                             const real32 *table, uint32 tableCount) {
+    typedef typename V::F F;
+    typedef typename V::M M;
+
+    r = pin01<V>(r);
+    g = pin01<V>(g);
+    b = pin01<V>(b);
+
+    M rGEg = V::cmpGE(r, g), gGTr = V::cmpGT(g, r), rGEb = V::cmpGE(r, b);
+    M gGTb = V::cmpGT(g, b), bGTr = V::cmpGT(b, r), bGTg = V::cmpGT(b, g);
+
+    M case1 = V::mAnd(rGEg, gGTb);                                  // r >= g > b
+    M notCase1 = V::mAndNot(gGTb, rGEg);
+    M case2 = V::mAnd(notCase1, bGTr);                              // b > r >= g
+    M notCase2 = V::mAndNot(bGTr, notCase1);
+    M case3 = V::mAnd(notCase2, bGTg);                              // r >= b > g
+    M case4 = V::mAndNot(bGTg, notCase2);                           // r >= g == b
+    M case5 = V::mAnd(gGTr, rGEb);                                  // g > r >= b
+    M notCase5 = V::mAndNot(rGEb, gGTr);
+    M case6 = V::mAnd(notCase5, bGTg);                              // b > g > r
+    M case7 = V::mAndNot(bGTg, notCase5);                           // g >= b > r
+
+    M hiR = V::mOr(V::mOr(case1, case3), case4), hiG = V::mOr(case5, case7);
+    M loB = V::mOr(case1, case5), loG = V::mOr(V::mOr(case2, case3), case4);
+    M midR = V::mOr(case2, case5), midG = V::mOr(case1, case6);
+
+    F hi = V::select(hiR, r, V::select(hiG, g, b));
+    F lo = V::select(loB, b, V::select(loG, g, r));
+    F mid = V::select(midR, r, V::select(midG, g, b));
+
+    F hiTone = interpolate<V>(table, tableCount, hi);
+    F loTone = interpolate<V>(table, tableCount, lo);
+    F midTone = V::add(loTone, V::div(V::mul(V::sub(hiTone, loTone), V::sub(mid, lo)), V::sub(hi, lo)));
+    midTone = V::select(case4, loTone, midTone);
+
+    r = V::select(hiR, hiTone, V::select(midR, midTone, loTone));
+    g = V::select(hiG, hiTone, V::select(midG, midTone, loTone));
+    b = V::select(V::mOr(case2, case6), hiTone, V::select(V::mOr(V::mOr(case3, case4), case7), midTone, loTone));
+}
+
+template <class V> inline void rgbToneStep(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                                           real32 *dPtrR, real32 *dPtrG, real32 *dPtrB,
+                                           const real32 *table, uint32 tableCount) {
+    typename V::F r = V::load(sPtrR), g = V::load(sPtrG), b = V::load(sPtrB);
+    rgbTonePixels<V>(r, g, b, table, tableCount);
+
+    V::store(dPtrR, r);
+    V::store(dPtrG, g);
+    V::store(dPtrB, b);
+}
+
+template <class V> void rgbTone(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                                real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                                const real32 *table, uint32 tableCount) {
+    uint32 col = 0;
+    for (; col + V::N <= count; col += V::N)
+        rgbToneStep<V>(sPtrR + col, sPtrG + col, sPtrB + col, dPtrR + col, dPtrG + col, dPtrB + col, table, tableCount);
+    for (; col < count; col++)
+        rgbToneStep<ScalarVec>(sPtrR + col, sPtrG + col, sPtrB + col, dPtrR + col, dPtrG + col, dPtrB + col, table, tableCount);
+}
+
+
+// -----------------------------------------------------------------------------------------
+// ResampleDown32: the Ref* routine accumulates row by row in dPtr, here each column block
+// accumulates all rows in a register - same sums in the same order. Needs wCount >= 2.
+
+template <class V> inline void resampleDown32Step(const real32 *sPtr, real32 *dPtr, int32 sRowStep,
+                                                  const real32 *wPtr, uint32 wCount) {
+    typename V::F total = V::mul(V::set1(wPtr[0]), V::load(sPtr));
+
+    for (uint32 j = 1; j < wCount - 1; j++) {
+        sPtr += sRowStep;
+        total = V::add(total, V::mul(V::set1(wPtr[j]), V::load(sPtr)));
+    }
+
+    sPtr += sRowStep;
+    V::store(dPtr, pin01<V>(V::add(total, V::mul(V::set1(wPtr[wCount - 1]), V::load(sPtr)))));
+}
+
+template <class V> void resampleDown32(const real32 *sPtr, real32 *dPtr, uint32 sCount, int32 sRowStep,
+                                       const real32 *wPtr, uint32 wCount) {
+    uint32 col = 0;
+    for (; col + V::N <= sCount; col += V::N)
+        resampleDown32Step<V>(sPtr + col, dPtr + col, sRowStep, wPtr, wCount);
+    for (; col < sCount; col++)
+        resampleDown32Step<ScalarVec>(sPtr + col, dPtr + col, sRowStep, wPtr, wCount);
+}
+
+
+// -----------------------------------------------------------------------------------------
+// Vignette16 (one row of one plane). s * m + mRound cannot overflow 32 bits.
+
+template <class V> inline void vignette16Step(int16 *sPtr, const uint16 *mPtr, typename V::I mRound, uint32 mBits) {
+    typename V::I s = V::mullo(V::loadS16(sPtr), V::loadU16(mPtr));
+    V::storeS16(sPtr, V::minu(V::srl(V::addi(s, mRound), mBits), V::set1i(65535)));
+}
+
+template <class V> void vignette16(int16 *sPtr, const uint16 *mPtr, uint32 count, uint32 mBits) {
+    const uint32 mRound = 1 << (mBits - 1);
+
+    uint32 col = 0;
+    for (; col + V::N <= count; col += V::N)
+        vignette16Step<V>(sPtr + col, mPtr + col, V::set1i(mRound), mBits);
+    for (; col < count; col++)
+        vignette16Step<ScalarVec>(sPtr + col, mPtr + col, mRound, mBits);
+}
+
+
+// -----------------------------------------------------------------------------------------
+// BaselineHueSatMap: RGB -> HSV, trilinear (or, for tables with one value division, bilinear)
+// lookup in the baked table, HSV -> RGB. The branches of DNG_RGBtoHSV/DNG_HSVtoRGB become
+// selects; like in the Ref* routine, a pixel whose hue ends up outside [0, 6) keeps its input.
+
+template <class V> inline void rgbToHSV(typename V::F r, typename V::F g, typename V::F b,
+                                        typename V::F &h, typename V::F &s, typename V::F &v) {
+    typedef typename V::F F;
+    const F zero = V::set1(0.0f);
+
+    v = V::max(r, V::max(g, b));
+    F gap = V::sub(v, V::min(r, V::min(g, b)));
+
+    F hR = V::div(V::sub(g, b), gap);
+    hR = V::select(V::cmpGT(zero, hR), V::add(hR, V::set1(6.0f)), hR);
+    F hG = V::add(V::set1(2.0f), V::div(V::sub(b, r), gap));
+    F hB = V::add(V::set1(4.0f), V::div(V::sub(r, g), gap));
+
+    typename V::M hasGap = V::cmpGT(gap, zero);
+    h = V::select(hasGap, V::select(V::cmpEQ(r, v), hR, V::select(V::cmpEQ(g, v), hG, hB)), zero);
+    s = V::select(hasGap, V::div(gap, v), zero);
+}
+
+template <class V> inline void hsvToRGB(typename V::F h, typename V::F s, typename V::F v,
+                                        typename V::F &r, typename V::F &g, typename V::F &b) {
+    typedef typename V::F F;
+    typedef typename V::M M;
+    const F one = V::set1(1.0f), six = V::set1(6.0f);
+
+    h = V::select(V::cmpGT(V::set1(0.0f), h), V::add(h, six), h);
+    h = V::select(V::cmpGE(h, six), V::sub(h, six), h);
+
+    typename V::I i = V::truncate(h);
+    F f = V::sub(h, V::toFloat(i));
+
+    F p = V::mul(v, V::sub(one, s));
+    F q = V::mul(v, V::sub(one, V::mul(s, f)));
+    F t = V::mul(v, V::sub(one, V::mul(s, V::sub(one, f))));
+
+    M i0 = V::cmpEQi(i, V::set1i(0)), i1 = V::cmpEQi(i, V::set1i(1)), i2 = V::cmpEQi(i, V::set1i(2));
+    M i3 = V::cmpEQi(i, V::set1i(3)), i4 = V::cmpEQi(i, V::set1i(4)), i5 = V::cmpEQi(i, V::set1i(5));
+
+    M sPositive = V::cmpGT(s, V::set1(0.0f));
+    r = V::select(sPositive, V::select(V::mOr(i0, i5), v, V::select(i1, q, V::select(V::mOr(i2, i3), p, V::select(i4, t, r)))), v);
+    g = V::select(sPositive, V::select(i0, t, V::select(V::mOr(i1, i2), v, V::select(i3, q, V::select(V::mOr(i4, i5), p, g)))), v);
+    b = V::select(sPositive, V::select(V::mOr(i0, i1), p, V::select(i2, t, V::select(V::mOr(i3, i4), v, V::select(i5, q, b)))), v);
+}
+
+// hFract0 * entry00 + hFract1 * entry01 along hue, for one component
+template <class V> inline typename V::F hueLerp(const real32 *component, typename V::I entry00, int32 hueStep,
+                                                typename V::F hFract0, typename V::F hFract1) {
+    return V::add(V::mul(hFract0, V::gather(component, entry00)),
+                  V::mul(hFract1, V::gather(component + hueStep, entry00)));
+}
+
+template <class V> inline typename V::F hueValLerp(const real32 *component, typename V::I entry00, const HueSatTable &table,
+                                                   typename V::F hFract0, typename V::F hFract1,
+                                                   typename V::F vFract0, typename V::F vFract1) {
+    return V::add(V::mul(vFract0, hueLerp<V>(component, entry00, table.hueStep, hFract0, hFract1)),
+                  V::mul(vFract1, hueLerp<V>(component + table.valStep, entry00, table.hueStep, hFract0, hFract1)));
+}
+
+template <class V> inline typename V::F tableLerp(const real32 *component, typename V::I entry00, const HueSatTable &table,
+                                                  typename V::F hFract0, typename V::F hFract1,
+                                                  typename V::F vFract0, typename V::F vFract1,
+                                                  typename V::F sFract0, typename V::F sFract1) {
+    if (!table.is3D)
+        return V::add(V::mul(sFract0, hueLerp<V>(component, entry00, table.hueStep, hFract0, hFract1)),
+                      V::mul(sFract1, hueLerp<V>(component + 1, entry00, table.hueStep, hFract0, hFract1)));
+
+    return V::add(V::mul(sFract0, hueValLerp<V>(component, entry00, table, hFract0, hFract1, vFract0, vFract1)),
+                  V::mul(sFract1, hueValLerp<V>(component + 1, entry00, table, hFract0, hFract1, vFract0, vFract1)));
+}
+
+template <class V> inline void hueSatMapPixels(typename V::F &r, typename V::F &g, typename V::F &b, const HueSatTable &table,
+                                               const real32 *encodeTable, uint32 encodeCount,
+                                               const real32 *decodeTable, uint32 decodeCount) {
+    typedef typename V::F F;
+    typedef typename V::I I;
+    const F one = V::set1(1.0f);
+
+    F h, s, v;
+    rgbToHSV<V>(r, g, b, h, s, v);
+
+    F vEncoded = v;
+    if (table.is3D && encodeTable) vEncoded = interpolate<V>(encodeTable, encodeCount, pin01<V>(v));
+
+    F hScaled = V::mul(h, V::set1(table.hScale));
+    F sScaled = V::mul(s, V::set1(table.sScale));
+    I hIndex0 = V::mini(V::truncate(hScaled), V::set1i(table.maxHueIndex0));
+    I sIndex0 = V::mini(V::truncate(sScaled), V::set1i(table.maxSatIndex0));
+    F hFract1 = V::sub(hScaled, V::toFloat(hIndex0));
+    F sFract1 = V::sub(sScaled, V::toFloat(sIndex0));
+    F hFract0 = V::sub(one, hFract1), sFract0 = V::sub(one, sFract1);
+
+    I entry00 = V::addi(V::mullo(hIndex0, V::set1i(table.hueStep)), sIndex0);
+
+    F vFract0 = one, vFract1 = one;
+    if (table.is3D) {
+        F vScaled = V::mul(vEncoded, V::set1(table.vScale));
+        I vIndex0 = V::mini(V::truncate(vScaled), V::set1i(table.maxValIndex0));
+        vFract1 = V::sub(vScaled, V::toFloat(vIndex0));
+        vFract0 = V::sub(one, vFract1);
+        entry00 = V::addi(V::mullo(vIndex0, V::set1i(table.valStep)), entry00);
+    }
+
+    F hueShift = tableLerp<V>(table.hueShift, entry00, table, hFract0, hFract1, vFract0, vFract1, sFract0, sFract1);
+    F satScale = tableLerp<V>(table.satScale, entry00, table, hFract0, hFract1, vFract0, vFract1, sFract0, sFract1);
+    F valScale = tableLerp<V>(table.valScale, entry00, table, hFract0, hFract1, vFract0, vFract1, sFract0, sFract1);
+
+    h = V::add(h, V::mul(hueShift, V::set1(6.0f / 360.0f)));
+    s = V::min(V::mul(s, satScale), one);
+    vEncoded = pin01<V>(V::mul(vEncoded, valScale));
+    v = decodeTable ? interpolate<V>(decodeTable, decodeCount, vEncoded) : vEncoded;
+
+    hsvToRGB<V>(h, s, v, r, g, b);
+}
+
+template <class V> inline void hueSatMapStep(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                                             real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, const HueSatTable &table,
+                                             const real32 *encodeTable, uint32 encodeCount,
+                                             const real32 *decodeTable, uint32 decodeCount) {
+    typename V::F r = V::load(sPtrR), g = V::load(sPtrG), b = V::load(sPtrB);
+    hueSatMapPixels<V>(r, g, b, table, encodeTable, encodeCount, decodeTable, decodeCount);
+
+    V::store(dPtrR, r);
+    V::store(dPtrG, g);
+    V::store(dPtrB, b);
+}
+
+template <class V> void hueSatMap(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                                  real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count, const HueSatTable &table,
+                                  const real32 *encodeTable, uint32 encodeCount, const real32 *decodeTable, uint32 decodeCount) {
+    uint32 col = 0;
+    for (; col + V::N <= count; col += V::N)
+        hueSatMapStep<V>(sPtrR + col, sPtrG + col, sPtrB + col, dPtrR + col, dPtrG + col, dPtrB + col, table,
+                         encodeTable, encodeCount, decodeTable, decodeCount);
+    for (; col < count; col++)
+        hueSatMapStep<ScalarVec>(sPtrR + col, sPtrG + col, sPtrB + col, dPtrR + col, dPtrG + col, dPtrB + col, table,
+                                 encodeTable, encodeCount, decodeTable, decodeCount);
+}
+
+
+// -----------------------------------------------------------------------------------------
+// MapArea16 (one contiguous row), for instruction sets with gathers. The table is read as
+// 32-bit words at even indices, so no read goes past its 65536 entries.
+
+template <class V> void mapRow16(uint16 *dPtr, uint32 count, const uint16 *map) {
+    uint32 col = 0;
+    for (; col + V::N <= count; col += V::N) {
+        typename V::I index = V::loadU16(dPtr + col);
+        typename V::I pair = V::gatheri(map, V::srl(index, 1));
+        V::storeU16(dPtr + col, V::srlOdd(pair, index));
+    }
+    for (; col < count; col++)
+        dPtr[col] = map[dPtr[col]];
+}
+
+
+// -----------------------------------------------------------------------------------------
+// BaselineRender16: every step of RefBaselineRender16 for a vector of pixels, which stay in
+// registers from the 16-bit source planes to the 8- or 16-bit output planes.
+
+// RefBaseline1DTable
+template <class V> inline typename V::F table1D(const real32 *table, uint32 tableCount, typename V::F x) {
+    return interpolate<V>(table, tableCount, pin01<V>(x));
+}
+
+// Pin_Overrange: in-range values except +-0 pass, larger ones (and +inf) give 1, others 0
+template <class V> inline typename V::F pinOverrange(typename V::F x) {
+    typedef typename V::F F;
+    const F zero = V::set1(0.0f), one = V::set1(1.0f);
+
+    return V::select(V::mAnd(V::cmpGT(x, zero), V::cmpGE(one, x)), x,
+                     V::select(V::cmpGT(x, V::set1(0.5f)), one, zero));
+}
+
+template <class V> inline void storePixels(uint8 *dPtr, typename V::I x) {V::storeU8(dPtr, x);}
+template <class V> inline void storePixels(uint16 *dPtr, typename V::I x) {V::storeU16(dPtr, x);}
+
+template <class V, typename T> inline void renderStep(const uint16 *sPtrA, const uint16 *sPtrB, const uint16 *sPtrC,
+                                                      T *dPtrR, T *dPtrG, T *dPtrB, const RenderTables &t,
+                                                      real32 dstScale) {
+    typedef typename V::F F;
+
+    const F srcScale = V::set1(t.srcScale);
+    F r = V::mul(srcScale, V::u16ToFloat(sPtrA));
+    F g = V::mul(srcScale, V::u16ToFloat(sPtrB));
+    F b = V::mul(srcScale, V::u16ToFloat(sPtrC));
+
+    if (t.zeroOffsetRamp) {
+        r = table1D<V>(t.zeroOffsetRamp, t.zeroOffsetCount, r);
+        g = table1D<V>(t.zeroOffsetRamp, t.zeroOffsetCount, g);
+        b = table1D<V>(t.zeroOffsetRamp, t.zeroOffsetCount, b);
+    }
+
+    abcToRGBPixels<V>(r, g, b, t.clip, t.cameraToRGB);
+
+    if (t.hueSatMap)
+        hueSatMapPixels<V>(r, g, b, *t.hueSatMap, t.hueSatEncode, t.hueSatEncodeCount, t.hueSatDecode, t.hueSatDecodeCount);
+
+    r = table1D<V>(t.exposureRamp, t.exposureCount, r);
+    g = table1D<V>(t.exposureRamp, t.exposureCount, g);
+    b = table1D<V>(t.exposureRamp, t.exposureCount, b);
+
+    if (t.lookTable)
+        hueSatMapPixels<V>(r, g, b, *t.lookTable, t.lookEncode, t.lookEncodeCount, t.lookDecode, t.lookDecodeCount);
+
+    rgbTonePixels<V>(r, g, b, t.toneCurve, t.toneCount);
+
+    // RefBaselineRGBtoRGB: like ABCtoRGB, minus the clipping
+    const real32 *m = t.rgbToFinal;
+    F R = r, G = g, B = b;
+    r = pin01<V>(V::add(V::add(V::mul(V::set1(m[0]), R), V::mul(V::set1(m[1]), G)), V::mul(V::set1(m[2]), B)));
+    g = pin01<V>(V::add(V::add(V::mul(V::set1(m[3]), R), V::mul(V::set1(m[4]), G)), V::mul(V::set1(m[5]), B)));
+    b = pin01<V>(V::add(V::add(V::mul(V::set1(m[6]), R), V::mul(V::set1(m[7]), G)), V::mul(V::set1(m[8]), B)));
+
+    // encoding gamma, then RefCopyAreaR32_8/16
+    const F scale = V::set1(dstScale), half = V::set1(0.5f);
+    storePixels<V>(dPtrR, V::truncate(V::add(V::mul(pinOverrange<V>(table1D<V>(t.encodeGamma, t.gammaCount, r)), scale), half)));
+    storePixels<V>(dPtrG, V::truncate(V::add(V::mul(pinOverrange<V>(table1D<V>(t.encodeGamma, t.gammaCount, g)), scale), half)));
+    storePixels<V>(dPtrB, V::truncate(V::add(V::mul(pinOverrange<V>(table1D<V>(t.encodeGamma, t.gammaCount, b)), scale), half)));
+}
+
+template <class V, typename T> void render(const uint16 *sPtrA, const uint16 *sPtrB, const uint16 *sPtrC,
+                                           T *dPtrR, T *dPtrG, T *dPtrB, uint32 count, const RenderTables &tables) {
+    const real32 dstScale = (sizeof(T) == 1) ? 255.0f : 65535.0f;
+
+    uint32 col = 0;
+    for (; col + V::N <= count; col += V::N)
+        renderStep<V>(sPtrA + col, sPtrB + col, sPtrC + col, dPtrR + col, dPtrG + col, dPtrB + col, tables, dstScale);
+    for (; col < count; col++)
+        renderStep<ScalarVec>(sPtrA + col, sPtrB + col, sPtrC + col, dPtrR + col, dPtrG + col, dPtrB + col, tables, dstScale);
+}
+
+}  // namespace
+
+#endif  // SIMD_KERNEL_TEMPLATES
@@ -0,0 +1,583 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "simdsuite.h"
+#include "simdkernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "dng_1d_table.h"
+#include "dng_bottlenecks.h"
+#include "dng_camera_profile.h"
+#include "dng_color_space.h"
+#include "dng_hue_sat_map.h"
+#include "dng_matrix.h"
+#include "dng_memory.h"
+#include "dng_reference.h"
+#include "dng_render.h"
+#include "dng_tag_types.h"
+#include "dng_tag_values.h"
+
+static SimdKernels kernels;
+static SimdLevel installedLevel = simdScalar;
+
+
+// -----------------------------------------------------------------------------------------
+// Hue/sat tables baked into the kernels' layout. Render tasks build their dng_hue_sat_map
+// afresh (interpolated for the white balance), but maps derived from the same profile for the
+// same white carry the same runtime fingerprint - so each is baked once and then shared by all
+// render tasks and threads.
+
+class BakedHueSatMap {
+public:
+    explicit BakedHueSatMap(const dng_hue_sat_map &map);
+
+    const HueSatTable& table() const {return m_table;}
+
+private:
+    std::vector<real32> m_hueShift, m_satScale, m_valScale;
+    HueSatTable m_table;
+};
+
+
+BakedHueSatMap::BakedHueSatMap(const dng_hue_sat_map &map) {
+    uint32 hueDivisions, satDivisions, valDivisions;
+    map.GetDivisions(hueDivisions, satDivisions, valDivisions);
+
+    // same scales and limits as RefBaselineHueSatMap, for a table with one more hue division
+    m_table.is3D = valDivisions >= 2;
+    m_table.hueStep = satDivisions;
+    m_table.valStep = (hueDivisions + 1) * satDivisions;
+    m_table.hScale = (hueDivisions < 2) ? 0.0f : (hueDivisions * (1.0f / 6.0f));
+    m_table.sScale = (real32) ((int32) satDivisions - 1);
+    m_table.vScale = (real32) ((int32) valDivisions - 1);
+    m_table.maxHueIndex0 = (int32) hueDivisions - 1;
+    m_table.maxSatIndex0 = (int32) satDivisions - 2;
+    m_table.maxValIndex0 = (int32) valDivisions - 2;
+
+    const uint32 entries = valDivisions * m_table.valStep;
+    m_hueShift.resize(entries);
+    m_satScale.resize(entries);
+    m_valScale.resize(entries);
+
+    const dng_hue_sat_map::HSBModify *deltas = map.GetConstDeltas();
+    for (uint32 val = 0; val < valDivisions; val++)
+        for (uint32 hue = 0; hue <= hueDivisions; hue++)
+            for (uint32 sat = 0; sat < satDivisions; sat++) {
+                const dng_hue_sat_map::HSBModify &delta =
+                    deltas[(val * hueDivisions + (hue % hueDivisions)) * satDivisions + sat];
+                uint32 entry = val * m_table.valStep + hue * m_table.hueStep + sat;
+
+                m_hueShift[entry] = delta.fHueShift;
+                m_satScale[entry] = delta.fSatScale;
+                m_valScale[entry] = delta.fValScale;
+            }
+
+    m_table.hueShift = m_hueShift.data();
+    m_table.satScale = m_satScale.data();
+    m_table.valScale = m_valScale.data();
+}
+
+
+static const BakedHueSatMap& bakedHueSatMap(const dng_hue_sat_map &map) {
+    static const size_t maxBakedMaps = 16;
+    static std::mutex bakedMutex;
+    static std::list<std::pair<dng_fingerprint, std::shared_ptr<const BakedHueSatMap> > > bakedMaps;  // most recent first
+
+    // render tasks apply the same one or two maps (hue/sat map and look table) to every row,
+    // so each thread remembers the last two
+    thread_local dng_fingerprint lastFingerprint[2];
+    thread_local std::shared_ptr<const BakedHueSatMap> lastBaked[2];
+    thread_local uint32 lastSlot = 0;
+
+    for (uint32 slot = 0; slot < 2; slot++)
+        if (lastBaked[slot] && (lastFingerprint[slot] == map.RuntimeFingerprint())) return *lastBaked[slot];
+
+    std::lock_guard<std::mutex> lock(bakedMutex);
+
+    auto found = std::find_if(bakedMaps.begin(), bakedMaps.end(), [&map](const std::pair<dng_fingerprint, std::shared_ptr<const BakedHueSatMap> > &baked) {
+        return baked.first == map.RuntimeFingerprint();
+    });
+
+    if (found != bakedMaps.end()) bakedMaps.splice(bakedMaps.begin(), bakedMaps, found);
+    else {
+        bakedMaps.push_front(std::make_pair(map.RuntimeFingerprint(), std::make_shared<BakedHueSatMap>(map)));
+        if (bakedMaps.size() > maxBakedMaps) bakedMaps.pop_back();
+    }
+
+    lastSlot ^= 1;
+    lastFingerprint[lastSlot] = map.RuntimeFingerprint();
+    lastBaked[lastSlot] = bakedMaps.front().second;
+    return *lastBaked[lastSlot];
+}
+
+
+// -----------------------------------------------------------------------------------------
+// dng_suite entry points: unpack the SDK arguments and hand rows to the installed kernels.
+// Layouts the kernels don't cover fall back to the Ref* routines.
+
+static void SimdCopyArea16_R32(const uint16 *sPtr, real32 *dPtr, uint32 rows, uint32 cols, uint32 planes,
+                               int32 sRowStep, int32 sColStep, int32 sPlaneStep,
+                               int32 dRowStep, int32 dColStep, int32 dPlaneStep, uint32 pixelRange) {
+    if ((sColStep != 1) || (dColStep != 1)) {
+        RefCopyArea16_R32(sPtr, dPtr, rows, cols, planes, sRowStep, sColStep, sPlaneStep,
+                          dRowStep, dColStep, dPlaneStep, pixelRange);
+        return;
+    }
+
+    real32 scale = 1.0f / (real32) pixelRange;
+
+    for (uint32 row = 0; row < rows; row++, sPtr += sRowStep, dPtr += dRowStep)
+        for (uint32 plane = 0; plane < planes; plane++)
+            kernels.copy16ToR32(sPtr + plane * sPlaneStep, dPtr + plane * dPlaneStep, cols, scale);
+}
+
+
+static void SimdBaselineABCtoRGB(const real32 *sPtrA, const real32 *sPtrB, const real32 *sPtrC,
+                                 real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                                 const dng_vector &cameraWhite, const dng_matrix &cameraToRGB) {
+    const real32 clip[3] = {(real32) cameraWhite[0], (real32) cameraWhite[1], (real32) cameraWhite[2]};
+
+    real32 matrix[9];
+    for (uint32 i = 0; i < 9; i++) matrix[i] = (real32) cameraToRGB[i / 3][i % 3];
+
+    kernels.abcToRGB(sPtrA, sPtrB, sPtrC, dPtrR, dPtrG, dPtrB, count, clip, matrix);
+}
+
+
+static void SimdBaselineRGBTone(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                                real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                                const dng_1d_table &table) {
+    kernels.rgbTone(sPtrR, sPtrG, sPtrB, dPtrR, dPtrG, dPtrB, count, table.Table(), table.Count());
+}
+
+
+// Maps without a fingerprint can't be told apart, they aren't worth baking for a single row
+static bool canBake(const dng_hue_sat_map &map) {
+    return map.IsValid() && !map.RuntimeFingerprint().IsNull();
+}
+
+// The hue/sat kernels take encoding tables only in pairs
+static void encodingTables(const dng_1d_table *encodeTable, const dng_1d_table *decodeTable,
+                           const real32 *&encode, uint32 &encodeCount, const real32 *&decode, uint32 &decodeCount) {
+    const bool hasTable = encodeTable && encodeTable->Table() && decodeTable && decodeTable->Table();
+
+    encode = hasTable ? encodeTable->Table() : NULL;
+    encodeCount = hasTable ? encodeTable->Count() : 0;
+    decode = hasTable ? decodeTable->Table() : NULL;
+    decodeCount = hasTable ? decodeTable->Count() : 0;
+}
+
+
+static void SimdBaselineHueSatMap(const real32 *sPtrR, const real32 *sPtrG, const real32 *sPtrB,
+                                  real32 *dPtrR, real32 *dPtrG, real32 *dPtrB, uint32 count,
+                                  const dng_hue_sat_map &lut, const dng_1d_table *encodeTable,
+                                  const dng_1d_table *decodeTable) {
+    if (!canBake(lut)) {
+        RefBaselineHueSatMap(sPtrR, sPtrG, sPtrB, dPtrR, dPtrG, dPtrB, count, lut, encodeTable, decodeTable);
+        return;
+    }
+
+    const real32 *encode, *decode;
+    uint32 encodeCount, decodeCount;
+    encodingTables(encodeTable, decodeTable, encode, encodeCount, decode, decodeCount);
+
+    kernels.hueSatMap(sPtrR, sPtrG, sPtrB, dPtrR, dPtrG, dPtrB, count, bakedHueSatMap(lut).table(),
+                      encode, encodeCount, decode, decodeCount);
+}
+
+
+static void SimdResampleDown32(const real32 *sPtr, real32 *dPtr, uint32 sCount, int32 sRowStep,
+                               const real32 *wPtr, uint32 wCount) {
+    if (wCount < 2) RefResampleDown32(sPtr, dPtr, sCount, sRowStep, wPtr, wCount);
+    else            kernels.resampleDown32(sPtr, dPtr, sCount, sRowStep, wPtr, wCount);
+}
+
+
+static void SimdVignette16(int16 *sPtr, const uint16 *mPtr, uint32 rows, uint32 cols, uint32 planes,
+                           int32 sRowStep, int32 sPlaneStep, int32 mRowStep, uint32 mBits) {
+    for (uint32 plane = 0; plane < planes; plane++, sPtr += sPlaneStep)
+        for (uint32 row = 0; row < rows; row++)
+            kernels.vignette16(sPtr + row * sRowStep, mPtr + row * mRowStep, cols, mBits);
+}
+
+
+static void SimdMapArea16(uint16 *dPtr, uint32 count0, uint32 count1, uint32 count2,
+                          int32 step0, int32 step1, int32 step2, const uint16 *map) {
+    if (step2 != 1) {
+        RefMapArea16(dPtr, count0, count1, count2, step0, step1, step2, map);
+        return;
+    }
+
+    for (uint32 index0 = 0; index0 < count0; index0++, dPtr += step0)
+        for (uint32 index1 = 0; index1 < count1; index1++)
+            kernels.mapRow16(dPtr + index1 * step1, count2, map);
+}
+
+
+static void SimdBaselineRender16(const uint16 *sPtrA, const uint16 *sPtrB, const uint16 *sPtrC,
+                                 void *dPtrR, void *dPtrG, void *dPtrB, uint32 count,
+                                 const dng_baseline_render_params &params) {
+    if ((params.fHueSatMap && !canBake(*params.fHueSatMap)) || (params.fLookTable && !canBake(*params.fLookTable))) {
+        RefBaselineRender16(sPtrA, sPtrB, sPtrC, dPtrR, dPtrG, dPtrB, count, params);
+        return;
+    }
+
+    RenderTables tables;
+    tables.srcScale = 1.0f / (real32) params.fSrcPixelRange;
+
+    tables.zeroOffsetRamp = params.fZeroOffsetRamp ? params.fZeroOffsetRamp->Table() : NULL;
+    tables.zeroOffsetCount = params.fZeroOffsetRamp ? params.fZeroOffsetRamp->Count() : 0;
+
+    for (uint32 i = 0; i < 3; i++) tables.clip[i] = (real32) (*params.fCameraWhite)[i];
+    for (uint32 i = 0; i < 9; i++) tables.cameraToRGB[i] = (real32) (*params.fCameraToRGB)[i / 3][i % 3];
+
+    tables.hueSatMap = params.fHueSatMap ? &bakedHueSatMap(*params.fHueSatMap).table() : NULL;
+    encodingTables(params.fHueSatMapEncode, params.fHueSatMapDecode, tables.hueSatEncode, tables.hueSatEncodeCount,
+                   tables.hueSatDecode, tables.hueSatDecodeCount);
+
+    tables.exposureRamp = params.fExposureRamp->Table();
+    tables.exposureCount = params.fExposureRamp->Count();
+
+    tables.lookTable = params.fLookTable ? &bakedHueSatMap(*params.fLookTable).table() : NULL;
+    encodingTables(params.fLookTableEncode, params.fLookTableDecode, tables.lookEncode, tables.lookEncodeCount,
+                   tables.lookDecode, tables.lookDecodeCount);
+
+    tables.toneCurve = params.fToneCurve->Table();
+    tables.toneCount = params.fToneCurve->Count();
+
+    for (uint32 i = 0; i < 9; i++) tables.rgbToFinal[i] = (real32) (*params.fRGBtoFinal)[i / 3][i % 3];
+
+    tables.encodeGamma = params.fEncodeGamma->Table();
+    tables.gammaCount = params.fEncodeGamma->Count();
+
+    if (params.fDstPixelType == ttByte)
+        kernels.render8(sPtrA, sPtrB, sPtrC, static_cast<uint8*>(dPtrR), static_cast<uint8*>(dPtrG),
+                        static_cast<uint8*>(dPtrB), count, tables);
+    else
+        kernels.render16(sPtrA, sPtrB, sPtrC, static_cast<uint16*>(dPtrR), static_cast<uint16*>(dPtrG),
+                         static_cast<uint16*>(dPtrB), count, tables);
+}
+
+
+// -----------------------------------------------------------------------------------------
+
+SimdLevel SimdSuite::supported() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+#if kSimdAVX512
+    if (__builtin_cpu_supports("avx512f")) return simdAVX512;
+#endif
+#if kSimdAVX2
+    if (__builtin_cpu_supports("avx2")) return simdAVX2;
+#endif
+#if kSimdSSE41
+    if (__builtin_cpu_supports("sse4.1")) return simdSSE41;
+#endif
+#endif
+    return simdScalar;
+}
+
+
+SimdLevel SimdSuite::install(SimdLevel level) {
+    level = std::min(level, supported());
+
+    SimdKernels levelKernels;
+    memset(&levelKernels, 0, sizeof(levelKernels));
+
+    switch (level) {
+#if kSimdAVX512
+        case simdAVX512: getAVX512Kernels(levelKernels); break;
+#endif
+#if kSimdAVX2
+        case simdAVX2:   getAVX2Kernels(levelKernels); break;
+#endif
+#if kSimdSSE41
+        case simdSSE41:  getSSE41Kernels(levelKernels); break;
+#endif
+        default:         break;
+    }
+    kernels = levelKernels;
+
+    gDNGSuite.CopyArea16_R32   = kernels.copy16ToR32    ? SimdCopyArea16_R32   : RefCopyArea16_R32;
+    gDNGSuite.BaselineABCtoRGB = kernels.abcToRGB       ? SimdBaselineABCtoRGB : RefBaselineABCtoRGB;
+    gDNGSuite.BaselineHueSatMap = kernels.hueSatMap     ? SimdBaselineHueSatMap : RefBaselineHueSatMap;
+    gDNGSuite.BaselineRGBTone  = kernels.rgbTone        ? SimdBaselineRGBTone  : RefBaselineRGBTone;
+    gDNGSuite.ResampleDown32   = kernels.resampleDown32 ? SimdResampleDown32   : RefResampleDown32;
+    gDNGSuite.Vignette16       = kernels.vignette16     ? SimdVignette16       : RefVignette16;
+    gDNGSuite.MapArea16        = kernels.mapRow16       ? SimdMapArea16        : RefMapArea16;
+    gDNGSuite.BaselineRender16 = kernels.render8        ? SimdBaselineRender16 : RefBaselineRender16;
+
+    installedLevel = level;
+    return level;
+}
+
+
+SimdLevel SimdSuite::installed() {
+    return installedLevel;
+}
+
+
+const char* SimdSuite::name(SimdLevel level) {
+    switch (level) {
+        case simdSSE41:  return "sse4.1";
+        case simdAVX2:   return "avx2";
+        case simdAVX512: return "avx512";
+        default:         return "scalar";
+    }
+}
+
+
+bool SimdSuite::parse(const std::string &name, SimdLevel &level) {
+    for (int i = simdScalar; i <= simdAVX512; i++)
+        if (name == SimdSuite::name(static_cast<SimdLevel>(i))) {
+            level = static_cast<SimdLevel>(i);
+            return true;
+        }
+    return false;
+}
+
+
+// -----------------------------------------------------------------------------------------
+// Self-check: every routine in gDNGSuite against its Ref* counterpart. Row lengths are odd
+// so that the vector tails are covered, and inputs are coarsely quantised so that the ties
+// that take special paths (e.g., equal channels in RGBTone) actually occur.
+
+static uint32 nextRandom(uint32 &state) {
+    state = state * 1664525 + 1013904223;
+    return state >> 8;
+}
+
+static real32 randomReal(uint32 &state, real32 low, real32 high) {
+    return low + (high - low) * (nextRandom(state) % 257) / 256.0f;
+}
+
+template <typename T> static bool sameData(const std::vector<T> &a, const std::vector<T> &b) {
+    return memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+
+static bool verifyInstalled(std::ostream &report) {
+    bool allOk = true;
+    uint32 seed = 0x2026;
+
+    auto result = [&](const char *routine, bool ok) {
+        report << "  " << std::left << std::setw(8) << SimdSuite::name(installedLevel) << std::setw(20) << routine
+               << (ok ? "ok" : "MISMATCH") << std::endl;
+        allOk = allOk && ok;
+    };
+
+    const uint32 rows = 5, cols = 1001, planes = 3, count = rows * cols * planes;
+
+    {
+        std::vector<uint16> src(count);
+        for (auto& value : src) value = nextRandom(seed) & 0xFFFF;
+        std::vector<real32> ref(count), dst(count);
+
+        RefCopyArea16_R32(src.data(), ref.data(), rows, cols, planes, cols, 1, rows * cols, cols, 1, rows * cols, 65535);
+        DoCopyArea16_R32(src.data(), dst.data(), rows, cols, planes, cols, 1, rows * cols, cols, 1, rows * cols, 65535);
+        result("CopyArea16_R32", sameData(ref, dst));
+    }
+
+    {
+        std::vector<real32> src(3 * cols), ref(3 * cols), dst(3 * cols);
+        for (auto& value : src) value = randomReal(seed, -0.2f, 1.3f);
+
+        dng_vector cameraWhite(3);
+        cameraWhite[0] = 0.9; cameraWhite[1] = 1.0; cameraWhite[2] = 0.8;
+        dng_matrix cameraToRGB(3, 3);
+        for (uint32 i = 0; i < 9; i++) cameraToRGB[i / 3][i % 3] = randomReal(seed, -0.5f, 1.5f);
+
+        RefBaselineABCtoRGB(&src[0], &src[cols], &src[2 * cols], &ref[0], &ref[cols], &ref[2 * cols], cols, cameraWhite, cameraToRGB);
+        DoBaselineABCtoRGB(&src[0], &src[cols], &src[2 * cols], &dst[0], &dst[cols], &dst[2 * cols], cols, cameraWhite, cameraToRGB);
+        result("BaselineABCtoRGB", sameData(ref, dst));
+    }
+
+    {
+        std::vector<real32> src(3 * cols), ref(3 * cols), dst(3 * cols);
+        for (auto& value : src) value = randomReal(seed, -0.1f, 1.1f);
+        for (uint32 col = 0; col < cols; col += 7) src[cols + col] = src[2 * cols + col];  // g == b
+
+        dng_1d_table table;
+        table.Initialize(gDefaultDNGMemoryAllocator, dng_tone_curve_acr3_default::Get());
+
+        RefBaselineRGBTone(&src[0], &src[cols], &src[2 * cols], &ref[0], &ref[cols], &ref[2 * cols], cols, table);
+        DoBaselineRGBTone(&src[0], &src[cols], &src[2 * cols], &dst[0], &dst[cols], &dst[2 * cols], cols, table);
+        result("BaselineRGBTone", sameData(ref, dst));
+    }
+
+    {
+        std::vector<real32> src(3 * cols), ref(3 * cols), dst(3 * cols);
+        for (auto& value : src) value = randomReal(seed, 0.0f, 1.0f);
+        for (uint32 col = 0; col < cols; col += 5) src[col] = src[cols + col];  // r == g (or grey)
+
+        AutoPtr<dng_1d_table> encodeTable, decodeTable;
+        BuildHueSatMapEncodingTable(gDefaultDNGMemoryAllocator, encoding_sRGB, encodeTable, decodeTable, false);
+
+        bool ok = true;
+        for (uint32 valDivisions = 1; valDivisions <= 3; valDivisions += 2) {
+            dng_hue_sat_map map;
+            map.SetDivisions(7, 5, valDivisions);
+
+            dng_hue_sat_map::HSBModify *deltas = map.GetDeltas();
+            for (uint32 entry = 0; entry < map.DeltasCount(); entry++) {
+                deltas[entry].fHueShift = randomReal(seed, (entry % 11) ? -30.0f : -400.0f, (entry % 11) ? 30.0f : 400.0f);
+                deltas[entry].fSatScale = randomReal(seed, 0.0f, 2.0f);
+                deltas[entry].fValScale = randomReal(seed, 0.5f, 1.5f);
+            }
+            map.AssignNewUniqueRuntimeFingerprint();
+
+            const dng_1d_table *encode = (valDivisions > 1) ? encodeTable.Get() : NULL;
+            const dng_1d_table *decode = (valDivisions > 1) ? decodeTable.Get() : NULL;
+            RefBaselineHueSatMap(&src[0], &src[cols], &src[2 * cols], &ref[0], &ref[cols], &ref[2 * cols], cols, map, encode, decode);
+            DoBaselineHueSatMap(&src[0], &src[cols], &src[2 * cols], &dst[0], &dst[cols], &dst[2 * cols], cols, map, encode, decode);
+            ok = ok && sameData(ref, dst);
+        }
+        result("BaselineHueSatMap", ok);
+    }
+
+    {
+        const uint32 wCount = 7;
+        std::vector<real32> src(wCount * cols), ref(cols), dst(cols), weights(wCount);
+        for (auto& value : src) value = randomReal(seed, 0.0f, 1.0f);
+        for (auto& weight : weights) weight = randomReal(seed, -0.1f, 0.4f);
+
+        bool ok = true;
+        for (uint32 n = 1; n <= wCount; n++) {
+            RefResampleDown32(src.data(), ref.data(), cols, cols, weights.data(), n);
+            DoResampleDown32(src.data(), dst.data(), cols, cols, weights.data(), n);
+            ok = ok && sameData(ref, dst);
+        }
+        result("ResampleDown32", ok);
+    }
+
+    {
+        std::vector<int16> ref(count);
+        std::vector<uint16> mask(rows * cols);
+        for (auto& value : ref) value = static_cast<int16>(nextRandom(seed) & 0xFFFF);
+        for (auto& value : mask) value = nextRandom(seed) & 0xFFFF;
+        std::vector<int16> dst(ref);
+
+        RefVignette16(ref.data(), mask.data(), rows, cols, planes, cols, rows * cols, cols, 15);
+        DoVignette16(dst.data(), mask.data(), rows, cols, planes, cols, rows * cols, cols, 15);
+        result("Vignette16", sameData(ref, dst));
+    }
+
+    {
+        std::vector<uint16> map(0x10000), ref(count);
+        for (auto& value : map) value = nextRandom(seed) & 0xFFFF;
+        for (auto& value : ref) value = nextRandom(seed) & 0xFFFF;
+        ref[0] = 0xFFFF;
+        std::vector<uint16> dst(ref);
+
+        RefMapArea16(ref.data(), planes, rows, cols, rows * cols, cols, 1, map.data());
+        DoMapArea16(dst.data(), planes, rows, cols, rows * cols, cols, 1, map.data());
+        result("MapArea16", sameData(ref, dst));
+    }
+
+    {
+        std::vector<uint16> src(3 * cols);
+        for (auto& value : src) value = nextRandom(seed) & 0xFFFF;
+        for (uint32 col = 0; col < cols; col += 9) src[col] = src[cols + col] = src[2 * cols + col];  // grey
+
+        dng_vector cameraWhite(3);
+        cameraWhite[0] = 0.8; cameraWhite[1] = 1.0; cameraWhite[2] = 0.9;
+        dng_matrix cameraToRGB(3, 3), rgbToFinal(3, 3);
+        for (uint32 i = 0; i < 9; i++) cameraToRGB[i / 3][i % 3] = randomReal(seed, -0.3f, 1.2f);
+        for (uint32 i = 0; i < 9; i++) rgbToFinal[i / 3][i % 3] = randomReal(seed, -0.3f, 1.5f);
+
+        dng_hue_sat_map hueSatMap, lookTable;
+        hueSatMap.SetDivisions(6, 4, 1);
+        lookTable.SetDivisions(9, 5, 3);
+        for (dng_hue_sat_map *map : {&hueSatMap, &lookTable}) {
+            dng_hue_sat_map::HSBModify *deltas = map->GetDeltas();
+            for (uint32 entry = 0; entry < map->DeltasCount(); entry++) {
+                deltas[entry].fHueShift = randomReal(seed, -20.0f, 20.0f);
+                deltas[entry].fSatScale = randomReal(seed, 0.5f, 1.5f);
+                deltas[entry].fValScale = randomReal(seed, 0.7f, 1.3f);
+            }
+            map->AssignNewUniqueRuntimeFingerprint();
+        }
+
+        AutoPtr<dng_1d_table> lookEncode, lookDecode;
+        BuildHueSatMapEncodingTable(gDefaultDNGMemoryAllocator, encoding_sRGB, lookEncode, lookDecode, false);
+
+        dng_1d_table zeroOffsetRamp, exposureRamp, toneCurve, encodeGamma;
+        zeroOffsetRamp.Initialize(gDefaultDNGMemoryAllocator, dng_function_zero_offset(0.01));
+        exposureRamp.Initialize(gDefaultDNGMemoryAllocator, dng_function_exposure_ramp(0.7, 0.002, 0.002));
+        toneCurve.Initialize(gDefaultDNGMemoryAllocator, dng_tone_curve_acr3_default::Get());
+        encodeGamma.Initialize(gDefaultDNGMemoryAllocator, dng_function_GammaEncode_sRGB::Get());
+
+        dng_baseline_render_params params;
+        params.fSrcPixelRange = 0xFFFF;
+        params.fCameraWhite = &cameraWhite;
+        params.fCameraToRGB = &cameraToRGB;
+        params.fHueSatMapEncode = params.fHueSatMapDecode = NULL;
+        params.fExposureRamp = &exposureRamp;
+        params.fLookTableEncode = lookEncode.Get();
+        params.fLookTableDecode = lookDecode.Get();
+        params.fToneCurve = &toneCurve;
+        params.fRGBtoFinal = &rgbToFinal;
+        params.fEncodeGamma = &encodeGamma;
+
+        // with and without the optional steps, to both output types
+        bool ok = true;
+        for (uint32 variant = 0; variant < 4; variant++) {
+            const bool optional = variant & 1;
+            params.fZeroOffsetRamp = optional ? &zeroOffsetRamp : NULL;
+            params.fHueSatMap = optional ? &hueSatMap : NULL;
+            params.fLookTable = optional ? &lookTable : NULL;
+            params.fDstPixelType = (variant & 2) ? ttShort : ttByte;
+
+            std::vector<uint16> ref(3 * cols), dst(3 * cols);
+            if (params.fDstPixelType == ttByte) {
+                uint8 *refPtr = reinterpret_cast<uint8*>(ref.data()), *dstPtr = reinterpret_cast<uint8*>(dst.data());
+                RefBaselineRender16(&src[0], &src[cols], &src[2 * cols], refPtr, refPtr + cols, refPtr + 2 * cols, cols, params);
+                DoBaselineRender16(&src[0], &src[cols], &src[2 * cols], dstPtr, dstPtr + cols, dstPtr + 2 * cols, cols, params);
+            }
+            else {
+                RefBaselineRender16(&src[0], &src[cols], &src[2 * cols], &ref[0], &ref[cols], &ref[2 * cols], cols, params);
+                DoBaselineRender16(&src[0], &src[cols], &src[2 * cols], &dst[0], &dst[cols], &dst[2 * cols], cols, params);
+            }
+            ok = ok && sameData(ref, dst);
+        }
+        result("BaselineRender16", ok);
+    }
+
+    return allOk;
+}
+
+
+bool SimdSuite::verify(std::ostream &report) {
+    SimdLevel previous = installedLevel;
+    bool ok = true;
+
+    for (int level = simdSSE41; level <= supported(); level++) {
+        install(static_cast<SimdLevel>(level));
+        ok = verifyInstalled(report) && ok;
+    }
+
+    install(previous);
+    return ok;
+}
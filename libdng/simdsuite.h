@@ -0,0 +1,49 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <ostream>
+#include <string>
+
+#include "dng_types.h"
+
+// Vectorised replacements for the hottest routines of the DNG SDK's dng_suite table
+// (gDNGSuite, which holds the scalar Ref* routines by default). The kernels produce
+// bit-identical results to the Ref* routines, so the level only affects speed.
+enum SimdLevel {simdScalar = 0, simdSSE41, simdAVX2, simdAVX512};
+
+class SimdSuite {
+public:
+    // Highest level supported by both this build and the CPU
+    static SimdLevel supported();
+
+    // Swaps the kernels of the given level (capped to supported()) into gDNGSuite and returns
+    // the level installed; simdScalar restores the Ref* routines. Must not be called while
+    // images are being processed.
+    static SimdLevel install(SimdLevel level);
+    static SimdLevel installed();
+
+    static const char* name(SimdLevel level);
+    static bool parse(const std::string &name, SimdLevel &level);
+
+    // Runs the kernels of every supported level against the Ref* routines on random data and
+    // reports the outcome per routine. Returns false on any mismatch; the installed level
+    // is restored afterwards.
+    static bool verify(std::ostream &report);
+};
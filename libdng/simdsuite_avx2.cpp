@@ -0,0 +1,104 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+// Built with -mavx2 - only called once CPUID has confirmed support
+
+#define SIMD_KERNEL_TEMPLATES
+#include "simdkernels.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct AVX2Vec {
+    static const uint32 N = 8;
+    typedef __m256 F;
+    typedef __m256i I;
+    typedef __m256 M;
+
+    static F load(const real32 *p) {return _mm256_loadu_ps(p);}
+    static void store(real32 *p, F x) {_mm256_storeu_ps(p, x);}
+    static F set1(real32 x) {return _mm256_set1_ps(x);}
+
+    static F add(F a, F b) {return _mm256_add_ps(a, b);}
+    static F sub(F a, F b) {return _mm256_sub_ps(a, b);}
+    static F mul(F a, F b) {return _mm256_mul_ps(a, b);}
+    static F div(F a, F b) {return _mm256_div_ps(a, b);}
+    static F min(F a, F b) {return _mm256_min_ps(a, b);}
+    static F max(F a, F b) {return _mm256_max_ps(a, b);}
+
+    static M cmpGE(F a, F b) {return _mm256_cmp_ps(a, b, _CMP_GE_OS);}
+    static M cmpGT(F a, F b) {return _mm256_cmp_ps(a, b, _CMP_GT_OS);}
+    static M cmpEQ(F a, F b) {return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);}
+    static M mAnd(M a, M b) {return _mm256_and_ps(a, b);}
+    static M mOr(M a, M b) {return _mm256_or_ps(a, b);}
+    static M mAndNot(M a, M b) {return _mm256_andnot_ps(a, b);}
+    static F select(M m, F a, F b) {return _mm256_blendv_ps(b, a, m);}
+
+    static I truncate(F x) {return _mm256_cvttps_epi32(x);}
+    static F toFloat(I x) {return _mm256_cvtepi32_ps(x);}
+    static F gather(const real32 *table, I index) {return _mm256_i32gather_ps(table, index, 4);}
+
+    static I loadU16(const uint16 *p) {return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));}
+    static I loadS16(const int16 *p) {
+        return _mm256_add_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))), _mm256_set1_epi32(32768));
+    }
+    static void storeS16(int16 *p, I x) {
+        x = _mm256_sub_epi32(x, _mm256_set1_epi32(32768));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)));
+    }
+    static void storeU16(uint16 *p, I x) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packus_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)));
+    }
+    static void storeU8(uint8 *p, I x) {
+        __m128i x16 = _mm_packus_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(x16, x16));
+    }
+    static I set1i(uint32 x) {return _mm256_set1_epi32(x);}
+    static I addi(I a, I b) {return _mm256_add_epi32(a, b);}
+    static I mullo(I a, I b) {return _mm256_mullo_epi32(a, b);}
+    static I srl(I a, uint32 bits) {return _mm256_srl_epi32(a, _mm_cvtsi32_si128(bits));}
+    static I minu(I a, I b) {return _mm256_min_epu32(a, b);}
+    static I mini(I a, I b) {return _mm256_min_epi32(a, b);}
+    static M cmpEQi(I a, I b) {return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b));}
+    static F u16ToFloat(const uint16 *p) {return _mm256_cvtepi32_ps(loadU16(p));}
+
+    static I gatheri(const uint16 *table, I index) {
+        return _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index, 4);
+    }
+    // Picks the 16-bit entry addressed by index out of the 32-bit word read by gatheri()
+    static I srlOdd(I pair, I index) {
+        I shift = _mm256_slli_epi32(_mm256_and_si256(index, _mm256_set1_epi32(1)), 4);
+        return _mm256_and_si256(_mm256_srlv_epi32(pair, shift), _mm256_set1_epi32(0xFFFF));
+    }
+};
+
+}  // namespace
+
+
+void getAVX2Kernels(SimdKernels &kernels) {
+    kernels.copy16ToR32 = copy16ToR32<AVX2Vec>;
+    kernels.abcToRGB = abcToRGB<AVX2Vec>;
+    kernels.rgbTone = rgbTone<AVX2Vec>;
+    kernels.resampleDown32 = resampleDown32<AVX2Vec>;
+    kernels.vignette16 = vignette16<AVX2Vec>;
+    kernels.mapRow16 = mapRow16<AVX2Vec>;
+    kernels.hueSatMap = hueSatMap<AVX2Vec>;
+    kernels.render8 = render<AVX2Vec, uint8>;
+    kernels.render16 = render<AVX2Vec, uint16>;
+}
@@ -0,0 +1,102 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+// Built with -mavx512f - only called once CPUID has confirmed support
+
+#define SIMD_KERNEL_TEMPLATES
+#include "simdkernels.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct AVX512Vec {
+    static const uint32 N = 16;
+    typedef __m512 F;
+    typedef __m512i I;
+    typedef __mmask16 M;
+
+    static F load(const real32 *p) {return _mm512_loadu_ps(p);}
+    static void store(real32 *p, F x) {_mm512_storeu_ps(p, x);}
+    static F set1(real32 x) {return _mm512_set1_ps(x);}
+
+    static F add(F a, F b) {return _mm512_add_ps(a, b);}
+    static F sub(F a, F b) {return _mm512_sub_ps(a, b);}
+    static F mul(F a, F b) {return _mm512_mul_ps(a, b);}
+    static F div(F a, F b) {return _mm512_div_ps(a, b);}
+    static F min(F a, F b) {return _mm512_min_ps(a, b);}
+    static F max(F a, F b) {return _mm512_max_ps(a, b);}
+
+    static M cmpGE(F a, F b) {return _mm512_cmp_ps_mask(a, b, _CMP_GE_OS);}
+    static M cmpGT(F a, F b) {return _mm512_cmp_ps_mask(a, b, _CMP_GT_OS);}
+    static M cmpEQ(F a, F b) {return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ);}
+    static M mAnd(M a, M b) {return a & b;}
+    static M mOr(M a, M b) {return a | b;}
+    static M mAndNot(M a, M b) {return ~a & b;}
+    static F select(M m, F a, F b) {return _mm512_mask_blend_ps(m, b, a);}
+
+    static I truncate(F x) {return _mm512_cvttps_epi32(x);}
+    static F toFloat(I x) {return _mm512_cvtepi32_ps(x);}
+    static F gather(const real32 *table, I index) {return _mm512_i32gather_ps(index, table, 4);}
+
+    static I loadU16(const uint16 *p) {return _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));}
+    static I loadS16(const int16 *p) {
+        return _mm512_add_epi32(_mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))), _mm512_set1_epi32(32768));
+    }
+    static void storeS16(int16 *p, I x) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtepi32_epi16(_mm512_sub_epi32(x, _mm512_set1_epi32(32768))));
+    }
+    static void storeU16(uint16 *p, I x) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtepi32_epi16(x));
+    }
+    static void storeU8(uint8 *p, I x) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm512_cvtepi32_epi8(x));
+    }
+    static I set1i(uint32 x) {return _mm512_set1_epi32(x);}
+    static I addi(I a, I b) {return _mm512_add_epi32(a, b);}
+    static I mullo(I a, I b) {return _mm512_mullo_epi32(a, b);}
+    static I srl(I a, uint32 bits) {return _mm512_srl_epi32(a, _mm_cvtsi32_si128(bits));}
+    static I minu(I a, I b) {return _mm512_min_epu32(a, b);}
+    static I mini(I a, I b) {return _mm512_min_epi32(a, b);}
+    static M cmpEQi(I a, I b) {return _mm512_cmpeq_epi32_mask(a, b);}
+    static F u16ToFloat(const uint16 *p) {return _mm512_cvtepi32_ps(loadU16(p));}
+
+    static I gatheri(const uint16 *table, I index) {
+        return _mm512_i32gather_epi32(index, reinterpret_cast<const int*>(table), 4);
+    }
+    // Picks the 16-bit entry addressed by index out of the 32-bit word read by gatheri()
+    static I srlOdd(I pair, I index) {
+        I shift = _mm512_slli_epi32(_mm512_and_si512(index, _mm512_set1_epi32(1)), 4);
+        return _mm512_and_si512(_mm512_srlv_epi32(pair, shift), _mm512_set1_epi32(0xFFFF));
+    }
+};
+
+}  // namespace
+
+
+void getAVX512Kernels(SimdKernels &kernels) {
+    kernels.copy16ToR32 = copy16ToR32<AVX512Vec>;
+    kernels.abcToRGB = abcToRGB<AVX512Vec>;
+    kernels.rgbTone = rgbTone<AVX512Vec>;
+    kernels.resampleDown32 = resampleDown32<AVX512Vec>;
+    kernels.vignette16 = vignette16<AVX512Vec>;
+    kernels.mapRow16 = mapRow16<AVX512Vec>;
+    kernels.hueSatMap = hueSatMap<AVX512Vec>;
+    kernels.render8 = render<AVX512Vec, uint8>;
+    kernels.render16 = render<AVX512Vec, uint16>;
+}
@@ -0,0 +1,97 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+// Built with -msse4.1 - only called once CPUID has confirmed support
+
+#define SIMD_KERNEL_TEMPLATES
+#include "simdkernels.h"
+
+#include <smmintrin.h>
+
+namespace {
+
+struct SSE41Vec {
+    static const uint32 N = 4;
+    typedef __m128 F;
+    typedef __m128i I;
+    typedef __m128 M;
+
+    static F load(const real32 *p) {return _mm_loadu_ps(p);}
+    static void store(real32 *p, F x) {_mm_storeu_ps(p, x);}
+    static F set1(real32 x) {return _mm_set1_ps(x);}
+
+    static F add(F a, F b) {return _mm_add_ps(a, b);}
+    static F sub(F a, F b) {return _mm_sub_ps(a, b);}
+    static F mul(F a, F b) {return _mm_mul_ps(a, b);}
+    static F div(F a, F b) {return _mm_div_ps(a, b);}
+    static F min(F a, F b) {return _mm_min_ps(a, b);}
+    static F max(F a, F b) {return _mm_max_ps(a, b);}
+
+    static M cmpGE(F a, F b) {return _mm_cmpge_ps(a, b);}
+    static M cmpGT(F a, F b) {return _mm_cmpgt_ps(a, b);}
+    static M cmpEQ(F a, F b) {return _mm_cmpeq_ps(a, b);}
+    static M mAnd(M a, M b) {return _mm_and_ps(a, b);}
+    static M mOr(M a, M b) {return _mm_or_ps(a, b);}
+    static M mAndNot(M a, M b) {return _mm_andnot_ps(a, b);}
+    static F select(M m, F a, F b) {return _mm_blendv_ps(b, a, m);}
+
+    static I truncate(F x) {return _mm_cvttps_epi32(x);}
+    static F toFloat(I x) {return _mm_cvtepi32_ps(x);}
+    static F gather(const real32 *table, I index) {
+        return _mm_setr_ps(table[_mm_cvtsi128_si32(index)], table[_mm_extract_epi32(index, 1)],
+                           table[_mm_extract_epi32(index, 2)], table[_mm_extract_epi32(index, 3)]);
+    }
+
+    static I loadU16(const uint16 *p) {return _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));}
+    static I loadS16(const int16 *p) {
+        return _mm_add_epi32(_mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))), _mm_set1_epi32(32768));
+    }
+    static void storeS16(int16 *p, I x) {
+        x = _mm_sub_epi32(x, _mm_set1_epi32(32768));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(x, x));
+    }
+    static void storeU16(uint16 *p, I x) {_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi32(x, x));}
+    static void storeU8(uint8 *p, I x) {
+        x = _mm_packus_epi32(x, x);
+        _mm_store_ss(reinterpret_cast<float*>(p), _mm_castsi128_ps(_mm_packus_epi16(x, x)));
+    }
+    static I set1i(uint32 x) {return _mm_set1_epi32(x);}
+    static I addi(I a, I b) {return _mm_add_epi32(a, b);}
+    static I mullo(I a, I b) {return _mm_mullo_epi32(a, b);}
+    static I srl(I a, uint32 bits) {return _mm_srl_epi32(a, _mm_cvtsi32_si128(bits));}
+    static I minu(I a, I b) {return _mm_min_epu32(a, b);}
+    static I mini(I a, I b) {return _mm_min_epi32(a, b);}
+    static M cmpEQi(I a, I b) {return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b));}
+    static F u16ToFloat(const uint16 *p) {return _mm_cvtepi32_ps(loadU16(p));}
+};
+
+}  // namespace
+
+
+// No gathers before AVX2 - MapArea16 stays with the (already unrolled) Ref* routine
+void getSSE41Kernels(SimdKernels &kernels) {
+    kernels.copy16ToR32 = copy16ToR32<SSE41Vec>;
+    kernels.abcToRGB = abcToRGB<SSE41Vec>;
+    kernels.rgbTone = rgbTone<SSE41Vec>;
+    kernels.resampleDown32 = resampleDown32<SSE41Vec>;
+    kernels.vignette16 = vignette16<SSE41Vec>;
+    kernels.mapRow16 = NULL;
+    kernels.hueSatMap = hueSatMap<SSE41Vec>;
+    kernels.render8 = render<SSE41Vec, uint8>;
+    kernels.render16 = render<SSE41Vec, uint16>;
+}
@@ -0,0 +1,149 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <exception>
+
+static uint32 globalThreads = 0;
+
+
+// One call to run(): helpers claim worker indices until the caller closes the batch
+struct ThreadPool::Batch {
+    Batch(uint32 workers_, const std::function<void(uint32)> &function_)
+        : function(function_), workers(workers_), nextWorker(1), running(0), closed(false) {}
+
+    const std::function<void(uint32)> &function;
+    uint32 workers, nextWorker, running;
+    bool closed;
+    std::exception_ptr exception;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+
+ThreadPool::ThreadPool(uint32 threads) : m_threads(std::max(threads, 1u)), m_shutdown(false) {
+    for (uint32 i = 1; i < m_threads; i++) {
+        try { m_workers.push_back(std::thread(&ThreadPool::workerLoop, this)); }
+        catch (...) { break; }  // carry on with the threads we've got
+    }
+    m_threads = static_cast<uint32>(m_workers.size()) + 1;
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_wakeup.notify_all();
+
+    for (auto& worker : m_workers) worker.join();
+}
+
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool((globalThreads > 0) ? globalThreads : std::max(std::thread::hardware_concurrency(), 1u));
+    return pool;
+}
+
+
+void ThreadPool::setGlobalThreads(uint32 threads) {
+    globalThreads = threads;
+}
+
+
+void ThreadPool::run(uint32 workers, const std::function<void(uint32)> &function) {
+    workers = std::min(workers, m_threads);
+
+    if (workers <= 1) {
+        function(0);
+        return;
+    }
+
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>(workers, function);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (uint32 i = 1; i < workers; i++) m_queue.push_back(batch);
+    }
+    m_wakeup.notify_all();
+
+    try { function(0); }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        if (!batch->exception) batch->exception = std::current_exception();
+    }
+
+    // -----------------------------------------------------------------------------------------
+    // No more helpers may join once we're done (all work has been taken by then), wait for the
+    // ones that did and drop our requests that nobody has picked up yet
+
+    {
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->closed = true;
+        batch->finished.wait(lock, [&batch] { return batch->running == 0; });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), batch), m_queue.end());
+    }
+
+    if (batch->exception) std::rethrow_exception(batch->exception);
+}
+
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::shared_ptr<Batch> batch;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait(lock, [this] { return m_shutdown || !m_queue.empty(); });
+            if (m_shutdown) return;
+
+            batch = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        help(batch);
+    }
+}
+
+
+void ThreadPool::help(const std::shared_ptr<Batch> &batch) {
+    uint32 workerIndex;
+
+    {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        if (batch->closed || (batch->nextWorker >= batch->workers)) return;
+        workerIndex = batch->nextWorker++;
+        batch->running++;
+    }
+
+    std::exception_ptr exception;
+    try { batch->function(workerIndex); }
+    catch (...) { exception = std::current_exception(); }
+
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    if (exception && !batch->exception) batch->exception = exception;
+    if (--batch->running == 0) batch->finished.notify_all();
+}
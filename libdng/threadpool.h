@@ -0,0 +1,69 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "dng_types.h"
+
+// Process-wide pool of worker threads, shared by all DngHosts (and therefore by all
+// conversions running in parallel).
+//
+// run() executes a function on up to n workers: the calling thread always works as
+// worker 0 and idle pool threads join in as workers 1..n-1 as they become free. The
+// function is expected to pull its work from shared state (e.g., the next unprocessed
+// tile), so the call completes even if no pool thread is free - this also makes nested
+// calls from within pool threads safe.
+class ThreadPool {
+public:
+    explicit ThreadPool(uint32 threads);
+    ~ThreadPool();
+
+    // Number of threads that can work concurrently (including the calling thread)
+    uint32 threads() const {return m_threads;}
+
+    // Runs function(workerIndex) on up to 'workers' threads and returns once all have finished.
+    // The first exception thrown by any worker is re-thrown.
+    void run(uint32 workers, const std::function<void(uint32)> &function);
+
+    // Pool shared by the whole process. Its size is fixed on first use, setGlobalThreads()
+    // must be called before that (0 = number of hardware threads)
+    static ThreadPool& global();
+    static void setGlobalThreads(uint32 threads);
+
+private:
+    struct Batch;
+
+    void workerLoop();
+    void help(const std::shared_ptr<Batch> &batch);
+
+    uint32 m_threads;
+    std::vector<std::thread> m_workers;
+
+    std::deque<std::shared_ptr<Batch>> m_queue;
+    bool m_shutdown;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+};
@@ -0,0 +1,71 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "dng_image_writer.h"
+#include "dng_point.h"
+
+// Tile size of the raw image in DNG output. Small tiles spread compression over more threads
+// and keep each thread's buffers in its cache, big tiles compress a little better and need
+// fewer tile offsets and Huffman tables. The DNG SDK ignores all of this and aims for 128 KB
+// (lossless JPEG) or 512 KB (deflate) of raw data per tile.
+class TilePolicy {
+public:
+    enum Target {
+        targetDefault,   // the DNG SDK's tile size
+        targetFastest,   // fastest writing on the given number of threads
+        targetSmallest,  // smallest file, approximately (lossless JPEG: the default)
+        targetBalanced   // lossless JPEG: faster than the default, but enough tiles for all
+                         // threads (deflate: the default)
+    };
+
+    explicit TilePolicy(Target target = targetDefault) : m_target(target) {}
+    explicit TilePolicy(const dng_point &tileSize) : m_target(targetDefault), m_fixedSize(tileSize) {}
+
+    // Tile size for a raw image (zero: the SDK's default)
+    dng_point tileSize(uint32 width, uint32 height, uint32 bytesPerPixel, uint32 compression, uint32 threads) const;
+
+    // Target name or fixed size, as parsed
+    std::string name() const;
+
+    // "default", "fastest", "smallest", "balanced" or a fixed size "<width>x<height>"
+    static bool parse(const char *text, TilePolicy &policy);
+
+    // Tiles of at most about tileWidth x tileHeight, the same size all over the image, in
+    // multiples of 16 pixels
+    static dng_point fit(uint32 width, uint32 height, uint32 tileWidth, uint32 tileHeight);
+
+private:
+    Target m_target;
+    dng_point m_fixedSize;
+};
+
+
+// dng_image_writer that sizes the raw image's tiles by a TilePolicy
+class TilePolicyWriter : public dng_image_writer {
+public:
+    explicit TilePolicyWriter(const TilePolicy &policy) : m_policy(policy) {}
+
+    virtual void FindRawTileSize(dng_host &host, dng_ifd &info);
+
+private:
+    TilePolicy m_policy;
+};
@@ -0,0 +1,89 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "trackingallocator.h"
+
+#include <cstdint>
+
+#include "dng_auto_ptr.h"
+
+// Malloc() puts the size in front of the block, so Free() knows how much is released;
+// this keeps the returned pointer at malloc's alignment
+static const size_t mallocHeader = 16;
+
+
+// Memory block of the underlying allocator, accounted for while it lives
+class TrackingAllocator::Block : public dng_memory_block {
+public:
+    Block(TrackingAllocator &owner, uint32 size)
+        : dng_memory_block(size), m_owner(owner), m_block(owner.m_allocator.Allocate(size)) {
+        SetBuffer(m_block->Buffer());
+        m_owner.add(size);
+    }
+
+    virtual ~Block() {m_owner.remove(LogicalSize());}
+
+private:
+    TrackingAllocator &m_owner;
+    AutoPtr<dng_memory_block> m_block;
+};
+
+
+TrackingAllocator::TrackingAllocator(dng_memory_allocator &allocator)
+    : m_allocator(allocator), m_current(0), m_peak(0), m_allocations(0) {}
+
+
+dng_memory_block* TrackingAllocator::Allocate(uint32 size) {
+    return new Block(*this, size);
+}
+
+
+void* TrackingAllocator::Malloc(size_t size) {
+    if (size > SIZE_MAX - mallocHeader) return NULL;
+
+    uint8 *block = static_cast<uint8*>(m_allocator.Malloc(size + mallocHeader));
+    if (block == NULL) return NULL;
+
+    *reinterpret_cast<size_t*>(block) = size;
+    add(size);
+    return block + mallocHeader;
+}
+
+
+void TrackingAllocator::Free(void *ptr) {
+    if (ptr == NULL) return;
+
+    uint8 *block = static_cast<uint8*>(ptr) - mallocHeader;
+    remove(*reinterpret_cast<size_t*>(block));
+    m_allocator.Free(block);
+}
+
+
+void TrackingAllocator::resetPeak() {
+    m_peak = m_current.load();
+    m_allocations = 0;
+}
+
+
+void TrackingAllocator::add(uint64 bytes) {
+    m_allocations++;
+    uint64 current = m_current += bytes;
+
+    uint64 peak = m_peak;
+    while ((current > peak) && !m_peak.compare_exchange_weak(peak, current)) {}
+}
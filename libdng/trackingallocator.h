@@ -0,0 +1,55 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <atomic>
+
+#include "dng_memory.h"
+
+// Allocator that counts the memory handed out through it and passes the actual allocation
+// on to another allocator (by default the SDK's malloc-based one). Install it on a DngHost
+// to find the peak memory a conversion needs - all image buffers, tile buffers and streams
+// of the DNG SDK come from the host's allocator.
+class TrackingAllocator : public dng_memory_allocator {
+public:
+    explicit TrackingAllocator(dng_memory_allocator &allocator = gDefaultDNGMemoryAllocator);
+
+    virtual dng_memory_block* Allocate(uint32 size);
+    virtual void* Malloc(size_t size);
+    virtual void Free(void *ptr);
+
+    // Bytes currently allocated and the most that were allocated at any one time
+    uint64 current() const {return m_current;}
+    uint64 peak() const {return m_peak;}
+
+    // Number of allocations since construction or the last resetPeak()
+    uint64 allocations() const {return m_allocations;}
+
+    // Restarts peak tracking (and the allocation count) from the current usage
+    void resetPeak();
+
+private:
+    class Block;
+
+    void add(uint64 bytes);
+    void remove(uint64 bytes) {m_current -= bytes;}
+
+    dng_memory_allocator &m_allocator;
+    std::atomic<uint64> m_current, m_peak, m_allocations;
+};
@@ -0,0 +1,285 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "batchConverter.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <thread>
+
+#include "rawConverter.h"
+
+#include "dng_exceptions.h"
+
+
+// -----------------------------------------------------------------------------------------
+// Bounded FIFO between two pipeline stages: push blocks while full, pop blocks while empty
+// and returns false once the queue is closed and drained
+
+class BatchConverter::WorkQueue {
+public:
+    explicit WorkQueue(unsigned int depth) : m_depth(depth > 0 ? depth : 1), m_closed(false) {}
+
+    void push(const Work &work) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] {return m_queue.size() < m_depth;});
+        m_queue.push_back(work);
+        m_notEmpty.notify_one();
+    }
+
+    bool pop(Work &work) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] {return !m_queue.empty() || m_closed;});
+        if (m_queue.empty()) return false;
+        work = m_queue.front(); m_queue.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+    }
+
+private:
+    size_t m_depth;
+    bool m_closed;
+    std::deque<Work> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull, m_notEmpty;
+};
+
+
+BatchConverter::BatchConverter(unsigned int jobs)
+                             : m_reportFunction(NULL), m_workers(jobs > 0 ? jobs : 1),
+                               m_pipeline(false), m_queueDepths(stageCount - 1, 1), m_memoryLimit(0),
+                               m_nextJob(0), m_doneJobs(0), m_failedJobs(0),
+                               m_createdConverters(0), m_maxConverters(0), m_memoryInFlight(0) {}
+
+
+void BatchConverter::setPipeline(bool enabled, const std::vector<unsigned int> &queueDepths, uint64 memoryLimit) {
+    m_pipeline = enabled;
+    m_memoryLimit = memoryLimit;
+
+    // missing depths default to the last one given
+    for (size_t i = 0; i < m_queueDepths.size(); i++)
+        if (!queueDepths.empty()) m_queueDepths[i] = std::max(queueDepths[std::min(i, queueDepths.size() - 1)], 1u);
+}
+
+
+void BatchConverter::addFile(const std::string &rawFilename, const std::string &outFilename) {
+    Job job;
+    job.rawFilename = rawFilename;
+    job.outFilename = outFilename;
+    job.failed = false;
+    job.seconds = 0;
+    m_jobs.push_back(job);
+}
+
+
+size_t BatchConverter::run() {
+    m_nextJob = m_doneJobs = m_failedJobs = 0;
+
+    if (m_pipeline) {
+        runPipeline();
+        return m_failedJobs;
+    }
+
+    // -----------------------------------------------------------------------------------------
+    // Never start more workers than there are files; the calling thread is one of the workers
+
+    unsigned int workers = static_cast<unsigned int>(std::min(static_cast<size_t>(m_workers), m_jobs.size()));
+
+    std::vector<std::thread> workerThreads;
+    for (unsigned int i = 1; i < workers; i++) {
+        try {workerThreads.push_back(std::thread(&BatchConverter::workerLoop, this));}
+        catch (...) {break;}  // carry on with the workers we've got
+    }
+
+    workerLoop();
+    for (auto& workerThread : workerThreads) workerThread.join();
+
+    return m_failedJobs;
+}
+
+
+bool BatchConverter::runStage(Stage stage, RawConverter &converter, Job &job) {
+    if (!m_stageFunctions[stage]) return true;
+
+    try {m_stageFunctions[stage](converter, job); return true;}
+    catch (std::exception& e) {job.error = e.what();}
+    catch (dng_exception& e)  {job.error = getDngErrorMessage(e.ErrorCode());}
+    catch (...)               {job.error = "Unknown error";}
+
+    job.failed = true;
+    return false;
+}
+
+
+void BatchConverter::finishJob(Job &job) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_doneJobs++;
+    if (job.failed) m_failedJobs++;
+    if (m_reportFunction != NULL) m_reportFunction(job, m_doneJobs, m_jobs.size());
+}
+
+
+void BatchConverter::workerLoop() {
+    // -----------------------------------------------------------------------------------------
+    // One converter per worker, re-used for every file this worker picks up
+
+    RawConverter converter;
+
+    while (true) {
+        Job *job;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_nextJob >= m_jobs.size()) return;
+            job = &m_jobs[m_nextJob++];
+        }
+
+        std::chrono::steady_clock::time_point startTime(std::chrono::steady_clock::now());
+
+        for (int stage = stageDecode; stage < stageCount; stage++)
+            if (!runStage(static_cast<Stage>(stage), converter, *job)) break;
+
+        converter.reset();
+
+        job->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        finishJob(*job);
+    }
+}
+
+
+void BatchConverter::runPipeline() {
+    // -----------------------------------------------------------------------------------------
+    // Every file in flight needs its own converter: one per stage plus one per queue slot
+
+    m_maxConverters = stageCount;
+    for (unsigned int depth : m_queueDepths) m_maxConverters += depth;
+    m_createdConverters = 0;
+    m_memoryInFlight = 0;
+
+    std::vector<WorkQueue*> queues;
+    for (unsigned int depth : m_queueDepths) queues.push_back(new WorkQueue(depth));
+
+    std::vector<std::thread> stageThreads;
+    for (int stage = stageDecode; stage < stageCount; stage++) {
+        WorkQueue *input  = (stage == stageDecode) ? NULL : queues[stage - 1];
+        WorkQueue *output = (stage == stageWrite)  ? NULL : queues[stage];
+        stageThreads.push_back(std::thread(&BatchConverter::pipelineStage, this, static_cast<Stage>(stage), input, output));
+    }
+
+    for (auto& stageThread : stageThreads) stageThread.join();
+    for (WorkQueue *queue : queues) delete queue;
+
+    for (RawConverter *converter : m_freeConverters) delete converter;
+    m_freeConverters.clear();
+}
+
+
+void BatchConverter::pipelineStage(Stage stage, WorkQueue *input, WorkQueue *output) {
+    while (true) {
+        Work work;
+
+        if (input == NULL) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_nextJob >= m_jobs.size()) break;
+                work.job = &m_jobs[m_nextJob++];
+            }
+            work.memory = 0;
+            work.startTime = std::chrono::steady_clock::now();
+
+            try {work.converter = acquireConverter();}
+            catch (...) {
+                work.converter = NULL;
+                work.job->failed = true;
+                work.job->error = "Cannot create converter";
+            }
+        }
+        else if (!input->pop(work)) break;
+
+        // -----------------------------------------------------------------------------------------
+        // Failed files skip all remaining stages but still travel down the pipeline, so they are
+        // reported and their converter is recycled by the last stage
+
+        if (!work.job->failed && runStage(stage, *work.converter, *work.job) && (stage == stageDecode)) {
+            work.memory = work.converter->memoryEstimate();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_memoryInFlight += work.memory;
+        }
+
+        if (output != NULL) {
+            output->push(work);
+            continue;
+        }
+
+        work.job->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - work.startTime).count();
+        releaseConverter(work);
+        finishJob(*work.job);
+    }
+
+    if (output != NULL) output->close();
+}
+
+
+RawConverter* BatchConverter::acquireConverter() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // -----------------------------------------------------------------------------------------
+    // Don't start decoding another file while we're over the memory limit - unless nothing else
+    // is in flight, otherwise a single huge file would never get converted
+
+    m_resourcesFreed.wait(lock, [this] {
+        bool haveConverter = !m_freeConverters.empty() || (m_createdConverters < m_maxConverters);
+        bool haveMemory = (m_memoryLimit == 0) || (m_memoryInFlight < m_memoryLimit) ||
+                          (m_freeConverters.size() == m_createdConverters);
+        return haveConverter && haveMemory;
+    });
+
+    if (!m_freeConverters.empty()) {
+        RawConverter *converter = m_freeConverters.back();
+        m_freeConverters.pop_back();
+        return converter;
+    }
+
+    m_createdConverters++;
+    lock.unlock();
+
+    try {return new RawConverter();}
+    catch (...) {
+        lock.lock(); m_createdConverters--;
+        throw;
+    }
+}
+
+
+void BatchConverter::releaseConverter(Work &work) {
+    if (work.converter == NULL) return;
+
+    // free image data now rather than when the converter gets re-used
+    work.converter->reset();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_freeConverters.push_back(work.converter);
+    m_memoryInFlight -= work.memory;
+    m_resourcesFreed.notify_all();
+}
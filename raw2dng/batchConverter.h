@@ -0,0 +1,108 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "dng_types.h"
+
+class RawConverter;
+
+
+// Converts a list of files in one process. Every conversion is split into four stages
+// (decode, build negative, render, write) that are either
+//  - run back-to-back by a bounded pool of workers (each re-using one RawConverter), or
+//  - run as a pipeline: one thread per stage, connected by bounded queues, so that while
+//    file N is rendered, file N+1 is unpacked and file N-1 is written.
+class BatchConverter {
+public:
+   enum Stage {stageDecode = 0, stageBuild, stageRender, stageWrite, stageCount};
+
+   struct Job {
+      std::string rawFilename;
+      std::string outFilename;
+
+      bool failed;
+      std::string error;
+      double seconds;
+   };
+
+   typedef std::function<void(RawConverter&, const Job&)> StageFunction;
+   typedef std::function<void(const Job&, size_t done, size_t total)> ReportFunction;
+
+   explicit BatchConverter(unsigned int jobs);
+
+   void setStage(Stage stage, StageFunction function) {m_stageFunctions[stage] = function;}
+
+   // queueDepths holds one depth per queue between two stages (i.e., stageCount - 1 values),
+   // memoryLimit (bytes, 0 = none) stops decoding of further files while the estimated
+   // working set of all files in flight exceeds it
+   void setPipeline(bool enabled, const std::vector<unsigned int> &queueDepths, uint64 memoryLimit);
+
+   void addFile(const std::string &rawFilename, const std::string &outFilename);
+   size_t size() const {return m_jobs.size();}
+
+   void registerReporter(ReportFunction reporter) {m_reportFunction = reporter;}
+
+   // Runs all queued conversions and returns the number of failed files
+   size_t run();
+
+private:
+   struct Work {
+      Job *job;
+      RawConverter *converter;
+      uint64 memory;
+      std::chrono::steady_clock::time_point startTime;
+   };
+
+   class WorkQueue;
+
+   void workerLoop();
+
+   void runPipeline();
+   void pipelineStage(Stage stage, WorkQueue *input, WorkQueue *output);
+   RawConverter* acquireConverter();
+   void releaseConverter(Work &work);
+
+   bool runStage(Stage stage, RawConverter &converter, Job &job);
+   void finishJob(Job &job);
+
+   StageFunction m_stageFunctions[stageCount];
+   ReportFunction m_reportFunction;
+   unsigned int m_workers;
+
+   bool m_pipeline;
+   std::vector<unsigned int> m_queueDepths;
+   uint64 m_memoryLimit;
+
+   std::vector<Job> m_jobs;
+   size_t m_nextJob, m_doneJobs, m_failedJobs;
+   std::mutex m_mutex;
+
+   // pipeline mode: re-usable converters and memory accounting for files in flight
+   std::vector<RawConverter*> m_freeConverters;
+   unsigned int m_createdConverters, m_maxConverters;
+   uint64 m_memoryInFlight;
+   std::condition_variable m_resourcesFreed;
+};
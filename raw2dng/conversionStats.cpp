@@ -0,0 +1,86 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "conversionStats.h"
+
+#include <iomanip>
+#include <sstream>
+
+
+static std::string jsonString(const std::string &text) {
+    std::ostringstream json;
+    json << '"';
+    for (unsigned char c : text) {
+        if ((c == '"') || (c == '\\')) json << '\\' << c;
+        else if (c < 0x20) json << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<unsigned int>(c) << std::dec;
+        else json << c;
+    }
+    json << '"';
+    return json.str();
+}
+
+
+double ConversionStats::threadUtilisation() const {
+    if ((seconds <= 0.0) || (threads == 0)) return 0.0;
+
+    double busySeconds = 0.0;
+    for (const auto &task : areaTasks) busySeconds += task.second.busySeconds;
+    return busySeconds / (seconds * threads);
+}
+
+
+void ConversionStats::writeJson(std::ostream &out) const {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(4)
+         << "{\"raw_file\":" << jsonString(rawFilename) << ",\"out_file\":" << jsonString(outFilename)
+         << ",\"seconds\":" << seconds << ",\"stages\":[";
+
+    for (size_t index = 0; index < stages.size(); index++)
+        json << ((index == 0) ? "" : ",") << "{\"name\":" << jsonString(stages[index].name)
+             << ",\"seconds\":" << stages[index].seconds << "}";
+
+    json << "],\"area_tasks\":[";
+    bool first = true;
+    for (const auto &task : areaTasks) {
+        const AreaTaskStats &stats = task.second;
+        json << (first ? "" : ",") << "{\"name\":" << jsonString(task.first) << ",\"runs\":" << stats.runs
+             << ",\"threads\":" << stats.threads << ",\"seconds\":" << stats.seconds
+             << ",\"busy_seconds\":" << stats.busySeconds
+             << ",\"utilisation\":" << ((stats.threadSeconds > 0.0) ? stats.busySeconds / stats.threadSeconds : 0.0) << "}";
+        first = false;
+    }
+
+    json << "],\"bytes_read\":" << bytesRead << ",\"bytes_written\":" << bytesWritten
+         << ",\"peak_memory\":" << peakMemory << ",\"allocations\":" << allocations
+         << ",\"threads\":" << threads << ",\"thread_utilisation\":" << threadUtilisation() << "}\n";
+
+    // in one piece, so that lines of concurrent conversions don't get mixed up
+    out << json.str() << std::flush;
+}
+
+
+void ConversionStats::writeText(std::ostream &out) const {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(0) << "   ";
+    for (const Stage &stage : stages) text << " " << stage.name << " " << stage.seconds * 1000.0 << " ms,";
+    text << " peak memory " << peakMemory / (1024 * 1024) << " MB, " << bytesRead / (1024 * 1024) << " MB read, "
+         << bytesWritten / (1024 * 1024) << " MB written, threads " << std::setprecision(0)
+         << threadUtilisation() * 100.0 << "% busy\n";
+
+    out << text.str() << std::flush;
+}
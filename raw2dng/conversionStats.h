@@ -0,0 +1,67 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "dng_types.h"
+#include "dnghost.h"
+
+
+// Timing and counters of one conversion, from opening the raw file to writing the output
+struct ConversionStats {
+   struct Stage {
+      std::string name;
+      double seconds;
+   };
+
+   ConversionStats() : seconds(0.0), bytesRead(0), bytesWritten(0), peakMemory(0), allocations(0), threads(0) {}
+
+   std::string rawFilename, outFilename;
+   double seconds;
+
+   // Stages in the order they ran, and the DNG SDK's area tasks (by name) run during them
+   std::vector<Stage> stages;
+   std::map<std::string, AreaTaskStats> areaTasks;
+
+   uint64 bytesRead, bytesWritten;
+
+   // Memory allocated through the DNG SDK (LibRaw's raw buffer is not included)
+   uint64 peakMemory, allocations;
+
+   // Size of the worker pool and the share of it the area tasks kept busy over the whole conversion
+   uint32 threads;
+   double threadUtilisation() const;
+
+   // One line of JSON / a short human-readable summary
+   void writeJson(std::ostream &out) const;
+   void writeText(std::ostream &out) const;
+};
+
+
+// Structured counterpart to RawConverter's progress publisher. Both functions are called on
+// the converting thread, in batch mode possibly for several files at the same time
+struct StatsListener {
+   std::function<void(const std::string &rawFilename, const ConversionStats::Stage &stage)> stageDone;
+   std::function<void(const ConversionStats &stats)> conversionDone;
+};
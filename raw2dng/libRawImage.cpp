@@ -0,0 +1,176 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "libRawImage.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include <dng_auto_ptr.h>
+#include <dng_orientation.h>
+#include <dng_tag_types.h>
+#include <dng_tag_values.h>
+
+#include <libraw/libraw.h>
+
+
+static uint32 libRawPlanes(const LibRaw &rawProcessor) {
+    const libraw_rawdata_t &rawdata = rawProcessor.imgdata.rawdata;
+
+    if (rawdata.raw_image    != NULL) return 1;
+    if (rawdata.color3_image != NULL) return 3;
+    if (rawdata.color4_image != NULL) return 4;
+
+    throw std::runtime_error("LibRaw did not unpack any raw data!");
+}
+
+
+LibRawImage::LibRawImage(LibRaw &rawProcessor, dng_memory_allocator &allocator)
+                       : dng_image(dng_rect(rawProcessor.imgdata.sizes.raw_height, rawProcessor.imgdata.sizes.raw_width),
+                                   (libRawPlanes(rawProcessor) == 1) ? 1 : rawProcessor.imgdata.idata.colors,
+                                   ttShort),
+                         m_sharedData(std::make_shared<char>(0)),
+                         m_allocator(allocator) {
+    const libraw_rawdata_t &rawdata = rawProcessor.imgdata.rawdata;
+    const libraw_image_sizes_t &sizes = rawProcessor.imgdata.sizes;
+
+    uint32 inputPlanes = libRawPlanes(rawProcessor);
+    void *data = (inputPlanes == 1) ? static_cast<void*>(rawdata.raw_image) :
+                 (inputPlanes == 3) ? static_cast<void*>(rawdata.color3_image) : static_cast<void*>(rawdata.color4_image);
+
+    // -----------------------------------------------------------------------------------------
+    // Rows are raw_pitch bytes apart (if LibRaw tells us), pixels inputPlanes samples - we only
+    // expose the first Planes() of them, which is how 4-to-3 and 3-to-1 plane reduction works
+
+    int32 rowStep = (sizes.raw_pitch != 0) ? static_cast<int32>(sizes.raw_pitch / sizeof(uint16))
+                                           : static_cast<int32>(sizes.raw_width * inputPlanes);
+
+    m_buffer = dng_pixel_buffer(Bounds(), 0, Planes(), ttShort, pcInterleaved, data);
+    m_buffer.fRowStep   = rowStep;
+    m_buffer.fColStep   = static_cast<int32>(inputPlanes);
+    m_buffer.fPlaneStep = 1;
+}
+
+
+LibRawImage::LibRawImage(const LibRawImage &image)
+                       : dng_image(image.Bounds(), image.Planes(), image.PixelType()),
+                         m_allocator(image.m_allocator) {
+    std::lock_guard<std::mutex> lock(image.m_mutex);
+
+    m_buffer = image.m_buffer;
+
+    // a view of a detached image needs its own copy as well
+    if (image.m_sharedData) m_sharedData = image.m_sharedData;
+    else                    detach();
+}
+
+
+dng_image* LibRawImage::Clone() const {
+    return new LibRawImage(*this);
+}
+
+
+void LibRawImage::detach() const {
+    // -----------------------------------------------------------------------------------------
+    // Copy our view into memory of our own - needs m_mutex to be held (or not be needed yet)
+
+    uint32 bytes = ComputeBufferSize(PixelType(), Bounds().Size(), Planes(), padSIMDBytes);
+    AutoPtr<dng_memory_block> data(m_allocator.Allocate(bytes));
+
+    dng_pixel_buffer buffer(Bounds(), 0, Planes(), PixelType(), pcInterleaved, data->Buffer());
+    buffer.CopyArea(m_buffer, Bounds(), 0, Planes());
+
+    m_buffer = buffer;
+    m_ownData.Reset(data.Release());
+    m_sharedData.reset();
+}
+
+
+void LibRawImage::SetPixelType(uint32 pixelType) {
+    dng_image::SetPixelType(pixelType);
+    m_buffer.fPixelType = pixelType;
+}
+
+
+void LibRawImage::Trim(const dng_rect &r) {
+    // same as dng_simple_image: move the origin, keep the strides
+    fBounds.t = 0;
+    fBounds.l = 0;
+    fBounds.b = r.H();
+    fBounds.r = r.W();
+
+    m_buffer.fData = m_buffer.DirtyPixel(r.t, r.l);
+    m_buffer.fArea = fBounds;
+}
+
+
+void LibRawImage::Rotate(const dng_orientation &orientation) {
+    // same as dng_simple_image: re-interpret the strides
+    int32 originH = fBounds.l;
+    int32 originV = fBounds.t;
+
+    int32 colStep = m_buffer.fColStep;
+    int32 rowStep = m_buffer.fRowStep;
+
+    uint32 width  = fBounds.W();
+    uint32 height = fBounds.H();
+
+    if (orientation.FlipH()) {
+        originH += width - 1;
+        colStep = -colStep;
+    }
+
+    if (orientation.FlipV()) {
+        originV += height - 1;
+        rowStep = -rowStep;
+    }
+
+    if (orientation.FlipD()) {
+        std::swap(colStep, rowStep);
+        std::swap(width, height);
+    }
+
+    m_buffer.fData = m_buffer.DirtyPixel(originV, originH);
+    m_buffer.fColStep = colStep;
+    m_buffer.fRowStep = rowStep;
+
+    fBounds.r = fBounds.l + width;
+    fBounds.b = fBounds.t + height;
+    m_buffer.fArea = fBounds;
+}
+
+
+void LibRawImage::AcquireTileBuffer(dng_tile_buffer &buffer, const dng_rect &area, bool dirty) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // don't modify data other views still see
+    if (dirty && m_sharedData && (m_sharedData.use_count() > 1)) detach();
+
+    buffer.fArea = area;
+
+    buffer.fPlane     = m_buffer.fPlane;
+    buffer.fPlanes    = m_buffer.fPlanes;
+    buffer.fRowStep   = m_buffer.fRowStep;
+    buffer.fColStep   = m_buffer.fColStep;
+    buffer.fPlaneStep = m_buffer.fPlaneStep;
+    buffer.fPixelType = m_buffer.fPixelType;
+    buffer.fPixelSize = m_buffer.fPixelSize;
+
+    buffer.fData = const_cast<void*>(m_buffer.ConstPixel(buffer.fArea.t, buffer.fArea.l, buffer.fPlane));
+    buffer.fDirty = dirty;
+}
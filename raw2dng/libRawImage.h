@@ -0,0 +1,68 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include <dng_auto_ptr.h>
+#include <dng_image.h>
+#include <dng_memory.h>
+#include <dng_pixel_buffer.h>
+
+class LibRaw;
+
+
+// Stage 1 image that uses LibRaw's unpacked raw data in place instead of copying it. Mosaic
+// data (raw_image) is used as is; for 3/4-colour data (color3/4_image) the view simply skips
+// the planes LibRaw reserves but the camera doesn't have.
+//
+// Clones are further views on the same data (the DNG SDK clones stage 1 to keep the raw image
+// it writes), so tiles are only ever read from LibRaw's buffer when they're needed. A view
+// that is written to while other views exist first gets its own copy of the data.
+//
+// The LibRaw object must stay alive (and must not be recycled) as long as any view exists.
+class LibRawImage : public dng_image {
+public:
+   LibRawImage(LibRaw &rawProcessor, dng_memory_allocator &allocator);
+   virtual ~LibRawImage() {}
+
+   virtual dng_image* Clone() const;
+
+   virtual void SetPixelType(uint32 pixelType);
+   virtual void Trim(const dng_rect &r);
+   virtual void Rotate(const dng_orientation &orientation);
+
+protected:
+   virtual void AcquireTileBuffer(dng_tile_buffer &buffer, const dng_rect &area, bool dirty) const;
+
+private:
+   explicit LibRawImage(const LibRawImage &image);
+
+   void detach() const;
+
+   // views of the same LibRaw data share the m_sharedData token, its use count tells whether
+   // we're alone; it's empty once the view has its own data
+   mutable dng_pixel_buffer m_buffer;
+   mutable std::shared_ptr<char> m_sharedData;
+   mutable AutoPtr<dng_memory_block> m_ownData;
+   mutable std::mutex m_mutex;
+
+   dng_memory_allocator &m_allocator;
+};
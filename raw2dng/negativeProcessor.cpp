@@ -25,15 +25,23 @@
 #include "vendorProcessors/ILCE7processor.h"
 #include "vendorProcessors/FujiProcessor.h"
 #include "vendorProcessors/variousVendorProcessor.h"
+#include "libRawImage.h"
 
 #include <stdexcept>
 #include <iostream>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <sys/stat.h>
 
-#include <dng_simple_image.h>
 #include <dng_camera_profile.h>
 #include <dng_file_stream.h>
 #include <dng_memory_stream.h>
 #include <dng_xmp.h>
+#include <dng_safe_arithmetic.h>
 
 #include <zlib.h>
 
@@ -42,6 +50,8 @@
 #include <exiv2/xmp_exiv2.hpp>
 #include <libraw/libraw.h>
 
+#include "threadpool.h"
+
 const char* getDngErrorMessage(int errorCode) {
     switch (errorCode) {
         default:
@@ -65,11 +75,13 @@ const char* getDngErrorMessage(int errorCode) {
 
 NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, const char *filename) {
     // -----------------------------------------------------------------------------------------
-    // Open and parse rawfile with libraw...
+    // Read rawfile once and parse it from memory with libraw...
+
+    AutoPtr<RawFile> rawFile(new RawFile(filename));
 
     AutoPtr<LibRaw> rawProcessor(new LibRaw());
 
-    int ret = rawProcessor->open_file(filename);
+    int ret = rawProcessor->open_buffer(const_cast<uint8*>(rawFile->data()), static_cast<size_t>(rawFile->size()));
     if (ret != LIBRAW_SUCCESS) {
         rawProcessor->recycle();
         std::stringstream error; error << "LibRaw-error while opening rawFile: " << libraw_strerror(ret);
@@ -88,7 +100,7 @@ NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, c
 
     Exiv2::Image::AutoPtr rawImage;
     try {
-        rawImage = Exiv2::ImageFactory::open(filename);
+        rawImage = Exiv2::ImageFactory::open(rawFile->data(), static_cast<long>(rawFile->size()));
         rawImage->readMetadata();
     } 
     catch (Exiv2::Error& e) {
@@ -100,23 +112,23 @@ NegativeProcessor* NegativeProcessor::createProcessor(AutoPtr<dng_host> &host, c
     // Identify and create correct processor class
 
     if (rawProcessor->imgdata.idata.dng_version != 0) {
-        try {return new DNGprocessor(host, rawProcessor.Release(), rawImage);}
+        try {return new DNGprocessor(host, rawFile.Release(), rawProcessor.Release(), rawImage);}
         catch (dng_exception &e) {
             std::stringstream error; error << "Cannot parse source DNG-file (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
             throw std::runtime_error(error.str());
         }
     }
     else if (!strcmp(rawProcessor->imgdata.idata.model, "ILCE-7"))
-        return new ILCE7processor(host, rawProcessor.Release(), rawImage);
+        return new ILCE7processor(host, rawFile.Release(), rawProcessor.Release(), rawImage);
     else if (!strcmp(rawProcessor->imgdata.idata.make, "FUJIFILM"))
-        return new FujiProcessor(host, rawProcessor.Release(), rawImage);
+        return new FujiProcessor(host, rawFile.Release(), rawProcessor.Release(), rawImage);
 
-    return new VariousVendorProcessor(host, rawProcessor.Release(), rawImage);
+    return new VariousVendorProcessor(host, rawFile.Release(), rawProcessor.Release(), rawImage);
 }
 
 
-NegativeProcessor::NegativeProcessor(AutoPtr<dng_host> &host, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage)
-                                   : m_RawProcessor(rawProcessor), m_RawImage(rawImage),
+NegativeProcessor::NegativeProcessor(AutoPtr<dng_host> &host, RawFile *rawFile, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage)
+                                   : m_RawFile(rawFile), m_RawProcessor(rawProcessor), m_RawImage(rawImage),
                                      m_RawExif(m_RawImage->exifData()), m_RawXmp(m_RawImage->xmpData()),
                                      m_host(host) {
     m_negative.Reset(m_host->Make_dng_negative());
@@ -124,10 +136,23 @@ NegativeProcessor::NegativeProcessor(AutoPtr<dng_host> &host, LibRaw *rawProcess
 
 
 NegativeProcessor::~NegativeProcessor() {
+    // the negative's stage 1 image uses LibRaw's buffers, so it has to go first
+    m_negative.Reset();
 	m_RawProcessor->recycle();
 }
 
 
+uint64 NegativeProcessor::workingSetEstimate() {
+    libraw_image_sizes_t *sizes = &m_RawProcessor->imgdata.sizes;
+
+    uint64 pixels = static_cast<uint64>(sizes->raw_width) * sizes->raw_height;
+    uint64 planes = (m_RawProcessor->imgdata.idata.filters != 0) ? 1 : m_RawProcessor->imgdata.idata.colors;
+
+    // the mapped file, LibRaw's buffer (also used as stage 1), linearised stage 2 and demosaiced (3-colour) stage 3
+    return m_RawFile->size() + pixels * sizeof(uint16) * (planes + planes + 3);
+}
+
+
 ColorKeyCode colorKey(const char color) {
     switch (color) {
         case 'R': return colorKeyRed;
@@ -150,7 +175,7 @@ void NegativeProcessor::setDNGPropertiesFromRaw() {
     // -----------------------------------------------------------------------------------------
     // Raw filename
 
-    std::string file(m_RawImage->io().path());
+    std::string file(m_RawFile->path());
     size_t found = std::min(file.rfind("\\"), file.rfind("/"));
     if (found != std::string::npos) file = file.substr(found + 1, file.length() - found - 1);
     m_negative->SetOriginalRawFileName(file.c_str());
@@ -257,18 +282,70 @@ void NegativeProcessor::setDNGPropertiesFromRaw() {
 }
 
 
-void NegativeProcessor::setCameraProfile(const char *dcpFilename) {
-    AutoPtr<dng_camera_profile> prof(new dng_camera_profile);
+// -----------------------------------------------------------------------------------------
+// Parsed DCP files, keyed by path and invalidated when the file's mtime or size changes
 
-    if (strlen(dcpFilename) > 0) {
+namespace {
+    struct CachedProfile {
+        time_t mtime;
+        off_t size;
+        std::shared_ptr<const dng_camera_profile> profile;
+    };
+
+    std::mutex profileCacheMutex;
+    std::map<std::string, CachedProfile> profileCache;
+}
+
+
+dng_camera_profile* NegativeProcessor::loadCameraProfile(const char *dcpFilename) {
+    struct stat fileStat;
+    if (stat(dcpFilename, &fileStat) != 0)
+        throw std::runtime_error("Could not open supplied camera profile file!");
+
+    std::shared_ptr<const dng_camera_profile> cached;
+    {
+        std::lock_guard<std::mutex> lock(profileCacheMutex);
+        std::map<std::string, CachedProfile>::const_iterator it = profileCache.find(dcpFilename);
+        if ((it != profileCache.end()) && (it->second.mtime == fileStat.st_mtime) && (it->second.size == fileStat.st_size))
+            cached = it->second.profile;
+    }
+
+    if (!cached) {
+        // Parse outside the lock - concurrent first uses may parse twice, the last one wins
+        AutoPtr<dng_camera_profile> prof(new dng_camera_profile);
         dng_file_stream profStream(dcpFilename);
         if (!prof->ParseExtended(profStream))
             throw std::runtime_error("Could not parse supplied camera profile file!");
+
+        // The fingerprint is computed lazily into a mutable member - do it now, before the profile is shared.
+        // Copies carry it (and the tables' runtime fingerprints) along, so render tables built for one
+        // negative are reused for the next
+        prof->Fingerprint();
+
+        cached.reset(prof.Release());
+
+        CachedProfile entry = {fileStat.st_mtime, fileStat.st_size, cached};
+        std::lock_guard<std::mutex> lock(profileCacheMutex);
+        profileCache[dcpFilename] = entry;
+    }
+
+    // Every negative owns (and may modify) its profile - the copy shares the hue/sat table data
+    // with the cached profile until one of them writes to it (dng_ref_counted_block)
+    return new dng_camera_profile(*cached);
+}
+
+
+void NegativeProcessor::setCameraProfile(const char *dcpFilename) {
+    AutoPtr<dng_camera_profile> prof;
+
+    if (strlen(dcpFilename) > 0) {
+        prof.Reset(loadCameraProfile(dcpFilename));
     }
     else {
         // -----------------------------------------------------------------------------------------
         // Build our own minimal profile, based on one colour matrix provided by LibRaw
 
+        prof.Reset(new dng_camera_profile);
         dng_string profName;
         profName.Append(m_RawProcessor->imgdata.idata.make);
         profName.Append(" ");
@@ -578,59 +655,25 @@ dng_memory_stream* NegativeProcessor::createDNGPrivateTag() {
 
 
 void NegativeProcessor::buildDNGImage() {
-    libraw_image_sizes_t *sizes = &m_RawProcessor->imgdata.sizes;
-
-    // -----------------------------------------------------------------------------------------
-    // Select right data source from LibRaw
-
-    unsigned short *rawBuffer = (unsigned short*) m_RawProcessor->imgdata.rawdata.raw_image;
-    uint32 inputPlanes = 1;
-
-    if (rawBuffer == NULL) {
-        rawBuffer = (unsigned short*) m_RawProcessor->imgdata.rawdata.color3_image;
-        inputPlanes = 3;
-    }
-    if (rawBuffer == NULL) {
-        rawBuffer = (unsigned short*) m_RawProcessor->imgdata.rawdata.color4_image;
-        inputPlanes = 4;
-    }
-
-    uint32 outputPlanes = (inputPlanes == 1) ? 1 : m_RawProcessor->imgdata.idata.colors;
-
     // -----------------------------------------------------------------------------------------
-    // Create new dng_image and copy data
+    // Use LibRaw's data in place as stage 1 (no copy) - it stays valid as long as m_RawProcessor
 
-    dng_rect bounds = dng_rect(sizes->raw_height, sizes->raw_width);
-    dng_simple_image *image = new dng_simple_image(bounds, outputPlanes, ttShort, m_host->Allocator());
-
-    dng_pixel_buffer buffer; image->GetPixelBuffer(buffer);
-    unsigned short *imageBuffer = (unsigned short*)buffer.fData;
-
-    if (inputPlanes == outputPlanes)
-        memcpy(imageBuffer, rawBuffer, sizes->raw_height * sizes->raw_width * outputPlanes * sizeof(unsigned short));
-    else {
-        for (int i = 0; i < (sizes->raw_height * sizes->raw_width); i++) {
-            memcpy(imageBuffer, rawBuffer, outputPlanes * sizeof(unsigned short));
-            imageBuffer += outputPlanes;
-            rawBuffer += inputPlanes;
-        }
-    }
-
-    AutoPtr<dng_image> castImage(dynamic_cast<dng_image*>(image));
-    m_negative->SetStage1Image(castImage);
+    AutoPtr<dng_image> image(new LibRawImage(*m_RawProcessor, m_host->Allocator()));
+    m_negative->SetStage1Image(image);
 }
 
 
-void NegativeProcessor::embedOriginalRaw(const char *rawFilename) {
+void NegativeProcessor::embedOriginalRaw(int compressionLevel) {
     #define BLOCKSIZE 65536 // as per spec
 
     // -----------------------------------------------------------------------------------------
-    // Open input/output streams and write header with empty indices
+    // Compress straight from the mapped raw file; open output stream and write header with empty indices
 
-    dng_file_stream rawDataStream(rawFilename);
-    rawDataStream.SetReadPosition(0);
+    if (m_RawFile->size() > 0xFFFFFFFF)
+        throw std::runtime_error("Raw file is too big to be embedded!");
 
-    uint32 rawFileSize = static_cast<uint32>(rawDataStream.Length());
+    const uint8 *rawData = m_RawFile->data();
+    uint32 rawFileSize = static_cast<uint32>(m_RawFile->size());
     uint32 numberRawBlocks = static_cast<uint32>(floor((rawFileSize + 65535.0) / 65536.0));
 
     dng_memory_stream embeddedRawStream(m_host->Allocator());
@@ -643,31 +686,48 @@ void NegativeProcessor::embedOriginalRaw(const char *rawFilename) {
     uint32 indexOffset = 1 * sizeof(uint32);
     uint32 dataOffset = (numberRawBlocks + 1 + 1) * sizeof(uint32);
 
-    for (uint32 block = 0; block < numberRawBlocks; block++) {
+    // -----------------------------------------------------------------------------------------
+    // Blocks are compressed independently (as per spec), so the pool's threads each take the next
+    // block and compress it into that block's slot of a scratch buffer with their own, re-used
+    // z_stream. The slots are then copied out in order
 
-        // -----------------------------------------------------------------------------------------
-        // Read and compress one 64k block of data
+    const uint32 maxCompressedLength = static_cast<uint32>(compressBound(BLOCKSIZE));
+    AutoPtr<dng_memory_block> compressedBlocks(m_host->Allocate((dng_safe_uint32(numberRawBlocks) * maxCompressedLength).Get()));
+    std::vector<uint32> compressedBlockLengths(numberRawBlocks);
+
+    std::atomic<uint32> nextBlock(0);
+    uint32 threads = std::max(std::min(ThreadPool::global().threads(), numberRawBlocks), 1u);
 
+    ThreadPool::global().run(threads, [&] (uint32) {
         z_stream zstrm;
         zstrm.zalloc = Z_NULL;
         zstrm.zfree = Z_NULL;
         zstrm.opaque = Z_NULL;
-        if (deflateInit(&zstrm, Z_DEFAULT_COMPRESSION) != Z_OK) 
+        if (deflateInit(&zstrm, compressionLevel) != Z_OK) 
             throw std::runtime_error("Error initialising ZLib for embedding raw file!");
 
-        unsigned char inBuffer[BLOCKSIZE], outBuffer[BLOCKSIZE * 2];
-        uint32 currentRawBlockLength = 
-            static_cast<uint32>(std::min(static_cast<uint64>(BLOCKSIZE), rawFileSize - rawDataStream.Position()));
-        rawDataStream.Get(inBuffer, currentRawBlockLength);
-        zstrm.avail_in = currentRawBlockLength;
-        zstrm.next_in = inBuffer;
-        zstrm.avail_out = BLOCKSIZE * 2;
-        zstrm.next_out = outBuffer;
-        if (deflate(&zstrm, Z_FINISH) != Z_STREAM_END)
-            throw std::runtime_error("Error compressing chunk for embedding raw file!");
-
-        uint32 compressedBlockLength = zstrm.total_out;
+        for (uint32 block = nextBlock++; block < numberRawBlocks; block = nextBlock++) {
+            uint8 *outBuffer = compressedBlocks->Buffer_uint8() + static_cast<size_t>(block) * maxCompressedLength;
+            uint32 currentRawBlockLength = std::min(static_cast<uint32>(BLOCKSIZE), rawFileSize - block * BLOCKSIZE);
+
+            deflateReset(&zstrm);
+            zstrm.avail_in = currentRawBlockLength;
+            zstrm.next_in = const_cast<uint8*>(rawData + static_cast<size_t>(block) * BLOCKSIZE);
+            zstrm.avail_out = maxCompressedLength;
+            zstrm.next_out = outBuffer;
+            if (deflate(&zstrm, Z_FINISH) != Z_STREAM_END) {
+                nextBlock = numberRawBlocks;
+                deflateEnd(&zstrm);
+                throw std::runtime_error("Error compressing chunk for embedding raw file!");
+            }
+
+            compressedBlockLengths[block] = static_cast<uint32>(zstrm.total_out);
+        }
+
         deflateEnd(&zstrm);
+    });
+
+    for (uint32 block = 0; block < numberRawBlocks; block++) {
 
         // -----------------------------------------------------------------------------------------
         // Write index and data
@@ -677,8 +737,9 @@ void NegativeProcessor::embedOriginalRaw(const char *rawFilename) {
         indexOffset += sizeof(uint32);
 
         embeddedRawStream.SetWritePosition(dataOffset);
-        embeddedRawStream.Put(outBuffer, compressedBlockLength);
-        dataOffset += compressedBlockLength;
+        embeddedRawStream.Put(compressedBlocks->Buffer_uint8() + static_cast<size_t>(block) * maxCompressedLength,
+                              compressedBlockLengths[block]);
+        dataOffset += compressedBlockLengths[block];
     }
 
     embeddedRawStream.SetWritePosition(indexOffset);
@@ -21,8 +21,11 @@
 #include <dng_host.h>
 #include <dng_negative.h>
 #include <dng_exif.h>
+#include <dng_camera_profile.h>
 #include <exiv2/image.hpp>
 
+#include "rawFile.h"
+
 class LibRaw;
 
 const char* getDngErrorMessage(int errorCode);
@@ -34,6 +37,11 @@ public:
 
    dng_negative* getNegative() {return m_negative.Get();}
 
+   uint64 rawFileSize() const {return m_RawFile->size();}
+
+   // Estimated peak memory needed to convert this file (raw data and all image stages)
+   uint64 workingSetEstimate();
+
    // Different raw/DNG processing stages - usually called in this sequence
    virtual void setDNGPropertiesFromRaw();
    virtual void setCameraProfile(const char *dcpFilename);
@@ -41,13 +49,16 @@ public:
    virtual void setXmpFromRaw(const dng_date_time_info &dateTimeNow, const dng_string &appNameVersion);
    virtual void backupProprietaryData();
    virtual void buildDNGImage();
-   virtual void embedOriginalRaw(const char *rawFilename);
+   virtual void embedOriginalRaw(int compressionLevel);
 
 protected:
-   NegativeProcessor(AutoPtr<dng_host> &host, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage);
+   NegativeProcessor(AutoPtr<dng_host> &host, RawFile *rawFile, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage);
 
    virtual dng_memory_stream* createDNGPrivateTag();
 
+   // Parses each DCP file only once per process and returns a private copy of the shared profile
+   static dng_camera_profile* loadCameraProfile(const char *dcpFilename);
+
    // helper functions
    bool getInterpretedRawExifTag(const char* exifTagName, int32 component, uint32* value);
 
@@ -63,7 +74,8 @@ protected:
 
    bool getRawExifTag(const char* exifTagName, long* size, unsigned char** data);
 
-   // Source: Raw-file
+   // Source: Raw-file (mapped once, LibRaw and Exiv2 both parse the same buffer)
+   AutoPtr<RawFile> m_RawFile;
    AutoPtr<LibRaw> m_RawProcessor;
    Exiv2::Image::AutoPtr m_RawImage;
    Exiv2::ExifData m_RawExif;
@@ -18,9 +18,27 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <sstream>
+#include <vector>
+#include <atomic>
+
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include "raw2dng.h"
 #include "rawConverter.h"
+#include "batchConverter.h"
+#include "threadpool.h"
+#include "simdsuite.h"
+#include "poolallocator.h"
+#include "posixfilestream.h"
+
+#include "dng_exceptions.h"
+#include "dng_render.h"
 
 
 void publishProgressUpdate(const char *message) {std::cout << " - " << message << "...\n";}
@@ -29,14 +47,18 @@ void publishProgressUpdate(const char *message) {std::cout << " - " << message <
 void registerPublisher(std::function<void(const char*)> function) {RawConverter::registerPublisher(function);}
 
 
-void raw2dng(std::string rawFilename, std::string outFilename, std::string dcpFilename, bool embedOriginal) {
+void raw2dng(std::string rawFilename, std::string outFilename, std::string dcpFilename, bool embedOriginal, int embedLevel, PreviewMode previews,
+             unsigned int huffmanSampleTiles) {
     RawConverter converter;
     converter.openRawFile(rawFilename);
     converter.buildNegative(dcpFilename);
-    if (embedOriginal) converter.embedRaw(rawFilename);
-    converter.renderImage();
-    converter.renderPreviews();
-    converter.writeDng(outFilename);
+    if (embedOriginal) converter.embedRaw(embedLevel);
+    if (previews != previewNone) {
+        converter.renderImage(previews == previewFast);
+        converter.renderPreviews();
+    }
+    else converter.skipRendering();
+    converter.writeDng(outFilename, huffmanSampleTiles);
 }
 
 
@@ -59,17 +81,79 @@ void raw2jpeg(std::string rawFilename, std::string outFilename, std::string dcpF
 }
 
 
+void addInputFiles(const std::string &input, std::vector<std::string> &rawFilenames) {
+    // -----------------------------------------------------------------------------------------
+    // "-" reads a list of files from stdin, directories add all regular files they contain
+
+    if (input == "-") {
+        std::string line;
+        while (std::getline(std::cin, line))
+            if (!line.empty()) rawFilenames.push_back(line);
+        return;
+    }
+
+    struct stat info;
+    if ((stat(input.c_str(), &info) != 0) || !S_ISDIR(info.st_mode)) {
+        rawFilenames.push_back(input);
+        return;
+    }
+
+    DIR *dir = opendir(input.c_str());
+    if (dir == NULL) {
+        std::cerr << "Cannot read directory \"" << input << "\" - skipping\n";
+        return;
+    }
+
+    std::vector<std::string> dirFilenames;
+    for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+
+        std::string filename(input);
+        if (filename[filename.length() - 1] != '/') filename.append("/");
+        filename.append(entry->d_name);
+
+        if ((stat(filename.c_str(), &info) == 0) && S_ISREG(info.st_mode)) dirFilenames.push_back(filename);
+    }
+    closedir(dir);
+
+    std::sort(dirFilenames.begin(), dirFilenames.end());
+    rawFilenames.insert(rawFilenames.end(), dirFilenames.begin(), dirFilenames.end());
+}
+
+
 int main(int argc, const char* argv []) {  
     if (argc == 1) {
         std::cerr << "\n"
                      "raw2dng - DNG converter\n"
-                     "Usage: " << argv[0] << " [options] <rawfile>\n"
+                     "Usage: " << argv[0] << " [options] <rawfile|directory|-> [...]\n"
                      "Valid options:\n"
                      "  -dcp <filename>      use adobe camera profile\n"
                      "  -e                   embed original\n"
+                     "  -z <0-9>             compression level of embedded original (default: 6)\n"
                      "  -j                   convert to JPEG instead of DNG\n"
                      "  -t                   convert to TIFF instead of DNG\n"
-                     "  -o <filename>        specify output filename\n\n";
+                     "  -o <filename>        specify output filename (single file only)\n"
+                     "  -nopreview           DNG only: raw data only, skips demosaicing and preview rendering\n"
+                     "  -fastpreview         DNG only: render previews from a binned instead of a full-size image\n"
+                     "  -huffsample <n>      DNG only: encode raw tiles in one pass, Huffman tables from n sampled tiles\n"
+                     "  -tiles <policy>      DNG only: raw tile size, default|fastest|smallest|balanced or <w>x<h>\n"
+                     "                       (smallest: same as default for lossless JPEG, balanced: for deflate)\n"
+                     "  -jobs <n>            number of files converted concurrently in batch mode (default: 1)\n"
+                     "  -pipeline            batch mode: overlap decoding, rendering and writing of consecutive files\n"
+                     "  -queue <n>[,<n>,<n>] pipeline queue depth(s) between decode/build/render/write (default: 1)\n"
+                     "  -memcap <MB>         pipeline: don't decode more files while those in flight need more memory\n"
+                     "  -alloccap <MB>       hard limit on image processing memory, conversions needing more fail\n"
+                     "  -iobuffer <MB>       output file buffer size (default: 4)\n"
+                     "  -directio            write output files with O_DIRECT, bypassing the page cache\n"
+                     "  -writebehind <MB>    how far a writer thread may lag behind the conversion (default: 64, 0: no thread)\n"
+                     "  -hugepages <mode>    back image buffers with transparent|explicit (hugetlb) 2 MB pages\n"
+                     "  -threads <n>         worker threads shared by all conversions (default: number of CPUs)\n"
+                     "  -simd <level>        force scalar|sse4.1|avx2|avx512 image processing (default: best for CPU)\n"
+                     "  -simdcheck           check the SIMD routines against the scalar reference and exit\n"
+                     "  -stats json|text     per-file stage timings and counters: JSON lines on stderr or a summary line\n"
+                     "                       (--stats is accepted too)\n\n"
+                     "Several files, whole directories or a list of files on stdin (\"-\") are converted in one\n"
+                     "batch, output files are written next to their input files.\n\n";
         return -1;
     }
 
@@ -79,51 +163,228 @@ int main(int argc, const char* argv []) {
     std::string outFilename;
     std::string dcpFilename;
     bool embedOriginal = false, isJpeg = false, isTiff = false;
+    int embedLevel = -1;
+    PreviewMode previews = previewFull;
+    unsigned int huffmanSampleTiles = 0;
+    TilePolicy tilePolicy;
+    unsigned int jobs = 1;
+    bool pipeline = false;
+    std::vector<unsigned int> queueDepths;
+    uint64 memoryLimit = 0;
+    uint64 allocationLimit = 0;
+    PoolAllocator::LargePages largePages = PoolAllocator::largePagesOff;
+    uint32 outputBufferSize = PosixFileStream::defaultBufferSize;
+    bool directWrite = false;
+    uint64 writeBehind = 64ull << 20;
+    unsigned int threads = 0;
+    SimdLevel simdLevel = SimdSuite::supported();
+    bool simdCheck = false;
+    std::string statsFormat;
 
     int index;
-    for (index = 1; index < argc && argv [index][0] == '-'; index++) {
+    for (index = 1; index < argc && argv [index][0] == '-' && argv [index][1] != '\0'; index++) {
         std::string option = &argv[index][1];
-        if (0 == strcmp(option.c_str(), "o"))   outFilename = std::string(argv[++index]);
-        if (0 == strcmp(option.c_str(), "dcp")) dcpFilename = std::string(argv[++index]);
-        if (0 == strcmp(option.c_str(), "e"))   embedOriginal = true;
-        if (0 == strcmp(option.c_str(), "j"))   isJpeg = true;
-        if (0 == strcmp(option.c_str(), "t"))   isTiff = true;
+        if (0 == strcmp(option.c_str(), "o"))    outFilename = std::string(argv[++index]);
+        if (0 == strcmp(option.c_str(), "dcp"))  dcpFilename = std::string(argv[++index]);
+        if (0 == strcmp(option.c_str(), "e"))    embedOriginal = true;
+        if (0 == strcmp(option.c_str(), "nopreview"))   previews = previewNone;
+        if (0 == strcmp(option.c_str(), "fastpreview")) previews = previewFast;
+        if (0 == strcmp(option.c_str(), "huffsample")) huffmanSampleTiles = std::max(atoi(argv[++index]), 0);
+        if (0 == strcmp(option.c_str(), "z"))    embedLevel = std::min(std::max(atoi(argv[++index]), 0), 9);
+        if (0 == strcmp(option.c_str(), "j"))    isJpeg = true;
+        if (0 == strcmp(option.c_str(), "t"))    isTiff = true;
+        if (0 == strcmp(option.c_str(), "jobs")) jobs = std::max(atoi(argv[++index]), 1);
+        if (0 == strcmp(option.c_str(), "threads")) threads = std::max(atoi(argv[++index]), 0);
+        if (0 == strcmp(option.c_str(), "pipeline")) pipeline = true;
+        if (0 == strcmp(option.c_str(), "simdcheck")) simdCheck = true;
+        if ((0 == strcmp(option.c_str(), "simd")) && !SimdSuite::parse(argv[++index], simdLevel)) {
+            std::cerr << "Unknown SIMD level \"" << argv[index] << "\"\n";
+            return 1;
+        }
+        if ((0 == strcmp(option.c_str(), "tiles")) && !TilePolicy::parse(argv[++index], tilePolicy)) {
+            std::cerr << "Unknown tile policy \"" << argv[index] << "\"\n";
+            return 1;
+        }
+        if ((0 == strcmp(option.c_str(), "hugepages")) && !PoolAllocator::parse(argv[++index], largePages)) {
+            std::cerr << "Unknown huge page mode \"" << argv[index] << "\"\n";
+            return 1;
+        }
+        if ((0 == strcmp(option.c_str(), "stats")) || (0 == strcmp(option.c_str(), "-stats"))) {
+            statsFormat = std::string(argv[++index]);
+            if ((statsFormat != "json") && (statsFormat != "text")) {
+                std::cerr << "Unknown stats format \"" << statsFormat << "\"\n";
+                return 1;
+            }
+        }
+        if (0 == strcmp(option.c_str(), "memcap")) memoryLimit = static_cast<uint64>(std::max(atoi(argv[++index]), 0)) << 20;
+        if (0 == strcmp(option.c_str(), "alloccap")) allocationLimit = static_cast<uint64>(std::max(atoi(argv[++index]), 0)) << 20;
+        if (0 == strcmp(option.c_str(), "iobuffer")) outputBufferSize = static_cast<uint32>(std::min(std::max(atoi(argv[++index]), 1), 1024)) << 20;
+        if (0 == strcmp(option.c_str(), "directio")) directWrite = true;
+        if (0 == strcmp(option.c_str(), "writebehind")) writeBehind = static_cast<uint64>(std::max(atoi(argv[++index]), 0)) << 20;
+        if (0 == strcmp(option.c_str(), "queue")) {
+            std::stringstream depths(argv[++index]);
+            for (std::string depth; std::getline(depths, depth, ',');) queueDepths.push_back(std::max(atoi(depth.c_str()), 1));
+        }
+    }
+
+    // vectorised DNG SDK routines - results are identical at every level
+    if (SimdSuite::install(simdLevel) < simdLevel)
+        std::cerr << "SIMD level " << SimdSuite::name(simdLevel) << " not supported, using "
+                  << SimdSuite::name(SimdSuite::installed()) << "\n";
+
+    if (simdCheck) {
+        std::cout << "Checking SIMD routines against reference implementation:\n";
+        return SimdSuite::verify(std::cout) ? 0 : 1;
     }
 
-    if (index == argc) {
+    if (index >= argc) {
         std::cerr << "No file specified\n";
         return 1;
     }
 
-    std::string rawFilename(argv[index++]);
+    std::vector<std::string> rawFilenames;
+    while (index < argc) addInputFiles(std::string(argv[index++]), rawFilenames);
+
+    if (rawFilenames.empty()) {
+        std::cerr << "No file specified\n";
+        return 1;
+    }
+
+    if ((rawFilenames.size() > 1) && !outFilename.empty()) {
+        std::cerr << "Output filename can only be specified for a single file\n";
+        return 1;
+    }
 
     // set output filename: if not given in command line, replace raw file extension
-    if (outFilename.empty()) {
-        outFilename.assign(rawFilename, 0, rawFilename.find_last_of("."));
-        if (isJpeg)      outFilename.append(".jpg");
-        else if (isTiff) outFilename.append(".tif");
-        else             outFilename.append(".dng");
+    auto defaultOutFilename = [&](const std::string &rawFilename) {
+        std::string filename(rawFilename, 0, rawFilename.find_last_of("."));
+        if (isJpeg)      filename.append(".jpg");
+        else if (isTiff) filename.append(".tif");
+        else             filename.append(".dng");
+        return filename;
+    };
+
+    // all area tasks of all conversions share one pool of threads
+    ThreadPool::setGlobalThreads(threads);
+
+    // ...and all DNG SDK memory comes from one pool, so the buffers of one file are recycled
+    // for the next instead of going back to the system
+    PoolAllocator allocator(PoolAllocator::defaultCacheLimit, largePages);
+    allocator.setLimit(allocationLimit);
+    RawConverter::setAllocator(allocator);
+    RawConverter::setOutputFiles(outputBufferSize, directWrite, writeBehind);
+    RawConverter::setTilePolicy(tilePolicy);
+
+    // per-file statistics, reported once the output file is written
+    if (!statsFormat.empty()) {
+        StatsListener listener;
+        if (statsFormat == "json") listener.conversionDone = [](const ConversionStats &stats) {stats.writeJson(std::cerr);};
+        else                       listener.conversionDone = [](const ConversionStats &stats) {stats.writeText(std::cout);};
+        RawConverter::registerStatsListener(listener);
     }
 
+    // conversion times to the millisecond at most
+    std::cout.precision(3);
+
+    typedef std::chrono::steady_clock Clock;
+    auto secondsSince = [](const Clock::time_point &start) {return std::chrono::duration<double>(Clock::now() - start).count();};
+
     // -----------------------------------------------------------------------------------------
     // Call the conversion function
 
-    std::cout << "Starting conversion: \"" << rawFilename << "\n";
-    std::time_t startTime = std::time(NULL);
+    if (rawFilenames.size() == 1) {
+        std::string rawFilename(rawFilenames[0]);
+        if (outFilename.empty()) outFilename = defaultOutFilename(rawFilename);
+
+        std::cout << "Starting conversion: \"" << rawFilename << "\n";
+        Clock::time_point startTime(Clock::now());
+
+        RawConverter::registerPublisher(publishProgressUpdate);
 
-    RawConverter::registerPublisher(publishProgressUpdate);
+        try {
+            if (isJpeg)      raw2jpeg(rawFilename, outFilename, dcpFilename);
+            else if (isTiff) raw2tiff(rawFilename, outFilename, dcpFilename);
+            else             raw2dng (rawFilename, outFilename, dcpFilename, embedOriginal, embedLevel, previews, huffmanSampleTiles);
+        }
+        catch (std::exception& e) {
+            std::cerr << "--> Error! (" << e.what() << ")\n\n";
+            return -1;
+        }
+        catch (dng_exception& e) {
+            std::cerr << "--> Error! (" << getDngErrorMessage(e.ErrorCode()) << ")\n\n";
+            return -1;
+        }
 
-    try {
-        if (isJpeg)      raw2jpeg(rawFilename, outFilename, dcpFilename);
-        else if (isTiff) raw2tiff(rawFilename, outFilename, dcpFilename);
-        else             raw2dng (rawFilename, outFilename, dcpFilename, embedOriginal);
+        std::cout << "--> Done (" << secondsSince(startTime) << " seconds)\n\n";
+
+        return 0;
     }
-    catch (std::exception& e) {
-        std::cerr << "--> Error! (" << e.what() << ")\n\n";
-        return -1;
+
+    // -----------------------------------------------------------------------------------------
+    // Batch mode: one process, a pool of converters working through all files
+
+    BatchConverter batch(jobs);
+    batch.setPipeline(pipeline, queueDepths, memoryLimit);
+
+    batch.setStage(BatchConverter::stageDecode, [](RawConverter &converter, const BatchConverter::Job &job) {
+        converter.openRawFile(job.rawFilename);
+    });
+    batch.setStage(BatchConverter::stageBuild, [&](RawConverter &converter, const BatchConverter::Job &job) {
+        converter.buildNegative(dcpFilename);
+        if (embedOriginal && !isJpeg && !isTiff) converter.embedRaw(embedLevel);
+    });
+    std::atomic<uint64> skippedPixels(0);
+
+    batch.setStage(BatchConverter::stageRender, [&](RawConverter &converter, const BatchConverter::Job &job) {
+        if ((previews == previewNone) && !isJpeg && !isTiff) {
+            converter.skipRendering();
+            skippedPixels += converter.rawPixels();
+            return;
+        }
+        // TIFF and JPEG are rendered from stage 3 as well, so that needs to stay full-size for those
+        converter.renderImage((previews == previewFast) && !isJpeg && !isTiff);
+        if (!isJpeg) converter.renderPreviews();
+    });
+    batch.setStage(BatchConverter::stageWrite, [&](RawConverter &converter, const BatchConverter::Job &job) {
+        if (isJpeg)      converter.writeJpeg(job.outFilename);
+        else if (isTiff) converter.writeTiff(job.outFilename);
+        else             converter.writeDng(job.outFilename, huffmanSampleTiles);
+    });
+
+    for (const std::string &rawFilename : rawFilenames) {
+        std::string batchOutFilename(defaultOutFilename(rawFilename));
+        if (batchOutFilename == rawFilename) {
+            std::cerr << "Skipping \"" << rawFilename << "\" - output would overwrite input\n";
+            continue;
+        }
+        batch.addFile(rawFilename, batchOutFilename);
     }
 
-    std::cout << "--> Done (" << std::difftime(std::time(NULL), startTime) << " seconds)\n\n";
+    batch.registerReporter([](const BatchConverter::Job &job, size_t done, size_t total) {
+        if (job.failed) std::cerr << "[" << done << "/" << total << "] \"" << job.rawFilename << "\" --> Error! (" << job.error << ")\n";
+        else            std::cout << "[" << done << "/" << total << "] \"" << job.rawFilename << "\" --> Done (" << job.seconds << " seconds)\n";
+    });
+
+    // progress messages of concurrent conversions would be interleaved, so only show them for a single worker
+    if ((jobs == 1) && !pipeline) RawConverter::registerPublisher(publishProgressUpdate);
+
+    std::cout << "Starting batch conversion: " << batch.size() << " files, ";
+    if (pipeline) std::cout << "pipelined\n";
+    else          std::cout << jobs << " concurrent\n";
+    Clock::time_point startTime(Clock::now());
+
+    size_t failed = batch.run();
+
+    std::cout << "--> Done (" << batch.size() - failed << " converted, " << failed << " failed, "
+              << secondsSince(startTime) << " seconds";
+    if (skippedPixels > 0) std::cout << ", demosaicing of " << skippedPixels / 1000000 << " MP skipped";
+    PoolAllocator::Stats memory = allocator.stats();
+    if (memory.allocations > 0)
+        std::cout << ", memory peak " << (memory.highWater >> 20) << " MB, " << memory.recycled * 100 / memory.allocations
+                  << "% of allocations recycled";
+    if (dng_render_table_cache::Hits() > 0)
+        std::cout << ", render tables built " << dng_render_table_cache::Misses() << "x, reused " << dng_render_table_cache::Hits() << "x";
+    std::cout << ")\n\n";
 
-    return 0;
+    return (failed == 0) ? 0 : -1;
 }
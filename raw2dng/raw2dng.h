@@ -21,7 +21,12 @@
 #include <string>
 #include <functional>
 
-void raw2dng(std::string rawFilename, std::string outFilename, std::string dcpFilename, bool embedOriginal);
+// full: previews rendered from full-size demosaiced image, fast: from a binned one, none: raw-only DNG
+enum PreviewMode {previewFull = 0, previewFast, previewNone};
+
+// huffmanSampleTiles: lossless JPEG Huffman tables from this many sampled tiles (0: optimal per tile)
+void raw2dng(std::string rawFilename, std::string outFilename, std::string dcpFilename, bool embedOriginal,
+             int embedLevel = -1, PreviewMode previews = previewFull, unsigned int huffmanSampleTiles = 0);
 void raw2tiff(std::string rawFilename, std::string outFilename, std::string dcpFilename);
 void raw2jpeg(std::string rawFilename, std::string outFilename, std::string dcpFilename);
 
@@ -19,14 +19,18 @@
 #include "config.h"
 #include "rawConverter.h"
 
+#include <algorithm>
 #include <stdexcept>
+#include <mutex>
+
+#include <exiv2/xmp_exiv2.hpp>
 
 #include "dng_negative.h"
 #include "dng_preview.h"
 #include "dng_xmp_sdk.h"
 #include "dng_memory_stream.h"
-#include "dng_file_stream.h"
 #include "dng_render.h"
+#include "dng_resample.h"
 #include "dng_image_writer.h"
 #include "dng_color_space.h"
 #include "dng_exceptions.h"
@@ -37,13 +41,37 @@
 
 #include "negativeProcessor.h"
 #include "dnghost.h"
+#include "posixfilestream.h"
 
 
 std::function<void(const char*)> RawConverter::m_publishFunction = NULL;
+StatsListener RawConverter::m_statsListener;
+dng_memory_allocator *RawConverter::m_baseAllocator = &gDefaultDNGMemoryAllocator;
+uint32 RawConverter::m_outputBufferSize = PosixFileStream::defaultBufferSize;
+bool RawConverter::m_directWrite = false;
+uint64 RawConverter::m_writeBehind = 0;
+TilePolicy RawConverter::m_tilePolicy;
+
+static std::mutex sdkMutex;
+static unsigned int sdkUsers = 0;
+
+static std::mutex exiv2XmpMutex;
 
+static const uint32 previewSize = 1024, thumbnailSize = 256;
+
+
+static void exiv2XmpLock(void *mutex, bool lock) {
+    if (lock) static_cast<std::mutex*>(mutex)->lock();
+    else      static_cast<std::mutex*>(mutex)->unlock();
+}
 
-dng_file_stream* openFileStream(const std::string &outFilename) {
-    try {return new dng_file_stream(outFilename.c_str(), true);}
+
+PosixFileStream* openFileStream(const std::string &outFilename, uint32 bufferSize, bool directWrite, uint64 writeBehind) {
+    try {
+        AutoPtr<PosixFileStream> stream(new PosixFileStream(outFilename.c_str(), true, bufferSize, directWrite));
+        stream->setWriteBehind(writeBehind);
+        return stream.Release();
+    }
     catch (dng_exception& e) {
         std::stringstream error; error << "Error opening output file! (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
         throw std::runtime_error(error.str());
@@ -51,25 +79,70 @@ dng_file_stream* openFileStream(const std::string &outFilename) {
 }
 
 
-RawConverter::RawConverter() {
+void RawConverter::initializeSDK() {
     // -----------------------------------------------------------------------------------------
-    // Init XMP SDK and some global variables we will need
+    // XMP SDK (ours and Exiv2's) are process-global, so only the first converter
+    // initialises them and only the last one tears them down. Exiv2 needs a lock
+    // function, otherwise its XMP toolkit is not safe to use from several threads
+
+    std::lock_guard<std::mutex> lock(sdkMutex);
+    if (sdkUsers++ > 0) return;
 
     dng_xmp_sdk::InitializeSDK();
+    Exiv2::XmpParser::initialize(exiv2XmpLock, &exiv2XmpMutex);
+}
+
+
+void RawConverter::terminateSDK() {
+    std::lock_guard<std::mutex> lock(sdkMutex);
+    if (--sdkUsers > 0) return;
+
+    Exiv2::XmpParser::terminate();
+    dng_xmp_sdk::TerminateSDK();
+}
+
+
+RawConverter::RawConverter() : m_allocator(*m_baseAllocator) {
+    // -----------------------------------------------------------------------------------------
+    // Init XMP SDK and some global variables we will need
+
+    initializeSDK();
 
-    m_host.Reset(dynamic_cast<dng_host*>(new DngHost()));
+    DngHost *host = new DngHost(&m_allocator);
+    host->setCollectStats(true);
+    m_host.Reset(host);
     m_host->SetSaveDNGVersion(dngVersion_SaveDefault);
     m_host->SetSaveLinearDNG(false);
     m_host->SetKeepOriginalFile(true);
 
     m_appName.Set("raw2dng");
     m_appVersion.Set(RAW2DNG_VERSION_STR);
-    CurrentDateTimeAndZone(m_dateTimeNow);
 }
 
 
 RawConverter::~RawConverter() {
-    dng_xmp_sdk::TerminateSDK();
+    // make sure all SDK objects are gone before the SDK goes
+    reset();
+    m_host.Reset();
+
+    terminateSDK();
+}
+
+
+void RawConverter::reset() {
+    m_previewList.Reset();
+    m_negProcessor.Reset();
+}
+
+
+uint64 RawConverter::memoryEstimate() const {
+    return (m_negProcessor.Get() != NULL) ? m_negProcessor->workingSetEstimate() : 0;
+}
+
+
+uint64 RawConverter::rawPixels() const {
+    const dng_image &rawImage = m_negProcessor->getNegative()->RawImage();
+    return static_cast<uint64>(rawImage.Width()) * rawImage.Height();
 }
 
 
@@ -78,13 +151,70 @@ void RawConverter::registerPublisher(std::function<void(const char*)> publisher)
 }
 
 
+void RawConverter::registerStatsListener(const StatsListener &listener) {
+    m_statsListener = listener;
+}
+
+
+void RawConverter::setAllocator(dng_memory_allocator &allocator) {
+    m_baseAllocator = &allocator;
+}
+
+
+void RawConverter::setOutputFiles(uint32 bufferSize, bool directWrite, uint64 writeBehind) {
+    m_outputBufferSize = bufferSize;
+    m_directWrite = directWrite;
+    m_writeBehind = writeBehind;
+}
+
+
+void RawConverter::setTilePolicy(const TilePolicy &policy) {
+    m_tilePolicy = policy;
+}
+
+
+void RawConverter::stageDone(const char *name, const Clock::time_point &start) {
+    ConversionStats::Stage stage = {name, std::chrono::duration<double>(Clock::now() - start).count()};
+    m_stats.stages.push_back(stage);
+
+    if (m_statsListener.stageDone) m_statsListener.stageDone(m_stats.rawFilename, stage);
+}
+
+
+void RawConverter::conversionDone(const std::string &outFilename, uint64 bytesWritten) {
+    m_stats.outFilename = outFilename;
+    m_stats.seconds = std::chrono::duration<double>(Clock::now() - m_startTime).count();
+    m_stats.bytesWritten = bytesWritten;
+    m_stats.areaTasks = static_cast<DngHost*>(m_host.Get())->areaTaskStats();
+    m_stats.peakMemory = m_allocator.peak();
+    m_stats.allocations = m_allocator.allocations();
+    m_stats.threads = m_host->PerformAreaTaskThreads();
+
+    if (m_statsListener.conversionDone) m_statsListener.conversionDone(m_stats);
+}
+
+
 void RawConverter::openRawFile(const std::string rawFilename) {
     // -----------------------------------------------------------------------------------------
     // Create processor and parse raw files
 
     if (m_publishFunction != NULL) m_publishFunction("parsing raw file");
 
+    // converters are re-used in batch mode: drop the previous file before reading the next one
+    reset();
+
+    m_stats = ConversionStats();
+    m_stats.rawFilename = rawFilename;
+    static_cast<DngHost*>(m_host.Get())->resetStats();
+    m_allocator.resetPeak();
+    m_startTime = Clock::now();
+
+    CurrentDateTimeAndZone(m_dateTimeNow);
+
     m_negProcessor.Reset(NegativeProcessor::createProcessor(m_host, rawFilename.c_str()));
+
+    m_stats.bytesRead = m_negProcessor->rawFileSize();
+    stageDone("decode", m_startTime);
 }
 
 
@@ -94,6 +224,8 @@ void RawConverter::buildNegative(const std::string dcpFilename) {
 
     if (m_publishFunction != NULL) m_publishFunction("processing metadata");
 
+    Clock::time_point start(Clock::now());
+
     m_negProcessor->setDNGPropertiesFromRaw();
     m_negProcessor->setCameraProfile(dcpFilename.c_str());
 
@@ -105,35 +237,57 @@ void RawConverter::buildNegative(const std::string dcpFilename) {
 
     m_negProcessor->backupProprietaryData();
 
+    stageDone("metadata", start);
+
     // -----------------------------------------------------------------------------------------
     // Copy raw sensor data
 
     if (m_publishFunction != NULL) m_publishFunction("reading raw image data");
 
+    start = Clock::now();
     m_negProcessor->buildDNGImage();
+    stageDone("stage1", start);
 }
 
 
-void RawConverter::embedRaw(const std::string rawFilename) {
+void RawConverter::embedRaw(int compressionLevel) {
     if (m_publishFunction != NULL) m_publishFunction("embedding raw file");
-    m_negProcessor->embedOriginalRaw(rawFilename.c_str());
+
+    Clock::time_point start(Clock::now());
+    m_negProcessor->embedOriginalRaw(compressionLevel);
+    stageDone("embed", start);
 }
 
 
-void RawConverter::renderImage() {
+void RawConverter::renderImage(bool fastPreview) {
     // -----------------------------------------------------------------------------------------
-    // Render image
+    // Render image - for previews only, the SDK's fast-save mode makes the mosaic interpolation
+    // work on binned cells and produce a stage 3 image just above preview size, while the raw
+    // image is still kept at full resolution
+
+    m_host->SetForFastSaveToDNG(fastPreview, fastPreview ? previewSize : 0);
+    m_host->SetMinimumSize(fastPreview ? previewSize : 0);
 
     try {
         if (m_publishFunction != NULL) m_publishFunction("building preview - linearising");
 
+        Clock::time_point start(Clock::now());
         m_negProcessor->getNegative()->BuildStage2Image(*m_host);   // Compute linearized and range-mapped image
+        stageDone("linearize", start);
 
         if (m_publishFunction != NULL) m_publishFunction("building preview - demosaicing");
 
+        start = Clock::now();
         m_negProcessor->getNegative()->BuildStage3Image(*m_host);   // Compute demosaiced image (used by preview and thumbnail)
+        stageDone("demosaic", start);
+
+        m_host->SetForFastSaveToDNG(false, 0);
+        m_host->SetMinimumSize(0);
     }
     catch (dng_exception& e) {
+        m_host->SetForFastSaveToDNG(false, 0);
+        m_host->SetMinimumSize(0);
+
         std::stringstream error; error << "Error while rendering image from raw! (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
         throw std::runtime_error(error.str());
     }
@@ -144,6 +298,8 @@ void RawConverter::renderPreviews() {
     // -----------------------------------------------------------------------------------------
     // Render JPEG and thumbnail previews
 
+    Clock::time_point start(Clock::now());
+
     m_previewList.Reset(new dng_preview_list());
     dng_render negRender(*m_host, *m_negProcessor->getNegative());
 
@@ -155,13 +311,17 @@ void RawConverter::renderPreviews() {
     jpeg_preview->fInfo.fDateTime = m_dateTimeNow.Encode_ISO_8601();
     jpeg_preview->fInfo.fColorSpace = previewColorSpace_sRGB;
 
-    negRender.SetMaximumSize(1024);
+    negRender.SetMaximumSize(previewSize);
     AutoPtr<dng_image> negImage(negRender.Render());
     dng_image_writer jpegWriter; jpegWriter.EncodeJPEGPreview(*m_host, *negImage.Get(), *jpeg_preview, 5);
     AutoPtr<dng_preview> jp(dynamic_cast<dng_preview*>(jpeg_preview));
     m_previewList->Append(jp);
 
-    if (m_publishFunction != NULL) m_publishFunction("building preview - rendering thumbnail");
+    stageDone("preview", start);
+
+    if (m_publishFunction != NULL) m_publishFunction("building preview - scaling thumbnail");
+
+    start = Clock::now();
 
     dng_image_preview *thumbnail = new dng_image_preview();
     thumbnail->fInfo.fApplicationName    = jpeg_preview->fInfo.fApplicationName;
@@ -169,28 +329,65 @@ void RawConverter::renderPreviews() {
     thumbnail->fInfo.fDateTime           = jpeg_preview->fInfo.fDateTime;
     thumbnail->fInfo.fColorSpace         = jpeg_preview->fInfo.fColorSpace;
 
-    negRender.SetMaximumSize(256);
-    thumbnail->fImage.Reset(negRender.Render());
+    // the thumbnail is just the rendered preview scaled down, no need to render stage 3 again
+    dng_point previewDimensions(negImage->Size());
+    real64 scale = std::min(1.0, static_cast<real64>(thumbnailSize) / std::max(previewDimensions.h, previewDimensions.v));
+    dng_rect thumbnailBounds(std::max(1, Round_int32(previewDimensions.v * scale)), std::max(1, Round_int32(previewDimensions.h * scale)));
+
+    thumbnail->fImage.Reset(m_host->Make_dng_image(thumbnailBounds, negImage->Planes(), negImage->PixelType()));
+    ResampleImage(*m_host, *negImage.Get(), *thumbnail->fImage.Get(), negImage->Bounds(), thumbnailBounds, dng_resample_bicubic::Get());
     AutoPtr<dng_preview> tn(dynamic_cast<dng_preview*>(thumbnail));
     m_previewList->Append(tn);
+
+    stageDone("thumbnail", start);
 }
 
 
-void RawConverter::writeDng(const std::string outFilename) {
+void RawConverter::skipRendering() {
+    // -----------------------------------------------------------------------------------------
+    // Nothing to render: the DNG will hold just the raw image (in IFD 0, as there's no thumbnail)
+
+    if (m_publishFunction != NULL) {
+        std::stringstream message; message << "skipping previews - no demosaicing of " << rawPixels() / 1000000.0 << " MP";
+        m_publishFunction(message.str().c_str());
+    }
+
+    m_previewList.Reset();
+}
+
+
+void RawConverter::writeDng(const std::string outFilename, uint32 huffmanSampleTiles) {
     // -----------------------------------------------------------------------------------------
     // Write DNG-image to file
 
     if (m_publishFunction != NULL) m_publishFunction("writing DNG file");
 
-    AutoPtr<dng_file_stream> targetFile(openFileStream(outFilename));
+    Clock::time_point start(Clock::now());
+
+    // Previews are done, so unless the stage 3 image is what we're saving (linear DNG), free it
+    // now: the writer only pulls tiles from the raw image, which is LibRaw's unpacked data
+    dng_negative *negative = m_negProcessor->getNegative();
+    if ((negative->Stage3Image() != NULL) && (&negative->RawImage() != negative->Stage3Image()) &&
+        negative->EnhanceParams().IsEmpty()) {
+        AutoPtr<dng_image> noImage;
+        negative->SetStage3Image(noImage);
+    }
+
+    AutoPtr<PosixFileStream> targetFile(openFileStream(outFilename, m_outputBufferSize, m_directWrite, m_writeBehind));
 
     try {
-        dng_image_writer dngWriter; dngWriter.WriteDNG(*m_host, *targetFile, *m_negProcessor->getNegative(), m_previewList.Get());
+        TilePolicyWriter dngWriter(m_tilePolicy);
+        dngWriter.SetLosslessJPEGSampleTiles(huffmanSampleTiles);
+        dngWriter.WriteDNG(*m_host, *targetFile, *negative, m_previewList.Get());
+        targetFile->finish();
     }
     catch (dng_exception& e) {
         std::stringstream error; error << "Error while writing DNG-file! (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
         throw std::runtime_error(error.str());
     }
+
+    stageDone("write", start);
+    conversionDone(outFilename, targetFile->Length());
 }
 
 
@@ -200,26 +397,34 @@ void RawConverter::writeTiff(const std::string outFilename) {
 
     if (m_publishFunction != NULL) m_publishFunction("rendering TIFF");
 
+    Clock::time_point start(Clock::now());
     dng_render negRender(*m_host, *m_negProcessor->getNegative());
     AutoPtr<dng_image> negImage(negRender.Render());
+    stageDone("render", start);
 
     // -----------------------------------------------------------------------------------------
     // Write Tiff-image to file
 
-    AutoPtr<dng_file_stream> targetFile(openFileStream(outFilename));
+    AutoPtr<PosixFileStream> targetFile(openFileStream(outFilename, m_outputBufferSize, m_directWrite, m_writeBehind));
 
     if (m_publishFunction != NULL) m_publishFunction("writing TIFF file");
 
+    start = Clock::now();
+
     try {
         dng_image_writer tiffWriter; 
         tiffWriter.WriteTIFF(*m_host, *targetFile, *negImage.Get(), piRGB, ccUncompressed,
                              m_negProcessor->getNegative(), &dng_space_sRGB::Get(), NULL,
                              dynamic_cast<const dng_jpeg_preview*>(&m_previewList->Preview(1)));
+        targetFile->finish();
     }
     catch (dng_exception& e) {
         std::stringstream error; error << "Error while writing TIFF-file! (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
         throw std::runtime_error(error.str());
     }
+
+    stageDone("write", start);
+    conversionDone(outFilename, targetFile->Length());
 }
 
 
@@ -231,8 +436,12 @@ void RawConverter::writeJpeg(const std::string outFilename) {
 
     if (m_publishFunction != NULL) m_publishFunction("rendering JPEG");
 
+    Clock::time_point start(Clock::now());
     dng_render negRender(*m_host, *m_negProcessor->getNegative());
     AutoPtr<dng_image> negImage(negRender.Render());
+    stageDone("render", start);
+
+    start = Clock::now();
 
     AutoPtr<dng_jpeg_preview> jpeg(new dng_jpeg_preview());
     jpeg->fInfo.fApplicationName.Set_ASCII(m_appName.Get());
@@ -241,13 +450,16 @@ void RawConverter::writeJpeg(const std::string outFilename) {
     jpeg->fInfo.fColorSpace = previewColorSpace_sRGB;
 
     dng_image_writer jpegWriter; jpegWriter.EncodeJPEGPreview(*m_host, *negImage.Get(), *jpeg.Get(), 8);
+    stageDone("encode", start);
 
     // -----------------------------------------------------------------------------------------
     // Write JPEG-image to file
 
     if (m_publishFunction != NULL) m_publishFunction("writing JPEG file");
 
-    AutoPtr<dng_file_stream> targetFile(openFileStream(outFilename));
+    start = Clock::now();
+
+    AutoPtr<PosixFileStream> targetFile(openFileStream(outFilename, m_outputBufferSize, m_directWrite, m_writeBehind));
 
     const uint8 soiTag[]         = {0xff, 0xd8};
     const uint8 app1Tag[]        = {0xff, 0xe1};
@@ -340,10 +552,13 @@ void RawConverter::writeJpeg(const std::string outFilename) {
         // write remaining JPEG structure/data from libjpeg minus the JFIF-header
         targetFile->Put((uint8*) jpeg->fCompressedData->Buffer() + jfifHeaderLength, jpeg->fCompressedData->LogicalSize() - jfifHeaderLength);
 
-        targetFile->Flush();
+        targetFile->finish();
     }
     catch (dng_exception& e) {
         std::stringstream error; error << "Error while writing JPEG-file! (" << e.ErrorCode() << ": " << getDngErrorMessage(e.ErrorCode()) << ")";
         throw std::runtime_error(error.str());
     }
+
+    stageDone("write", start);
+    conversionDone(outFilename, targetFile->Length());
 }
@@ -19,7 +19,11 @@
 #pragma once
 
 #include "negativeProcessor.h"
+#include "conversionStats.h"
+#include "trackingallocator.h"
+#include "tilepolicy.h"
 
+#include <chrono>
 #include <functional>
 #include <string>
 
@@ -36,17 +40,54 @@ public:
 
    void openRawFile(const std::string rawFilename);
    void buildNegative(const std::string dcpFilename);
-   void embedRaw(const std::string rawFilename);
-   void renderImage();
+   void embedRaw(int compressionLevel = -1);  // zlib level 0-9, -1: zlib's default
+   // fastPreview: stage 3 is only needed for previews, so demosaic it at about preview size
+   void renderImage(bool fastPreview = false);
    void renderPreviews();
 
-   void writeDng (const std::string outFilename);
+   // Raw-only DNG: instead of renderImage() and renderPreviews(), no stage 2/3, no previews
+   void skipRendering();
+
+   // huffmanSampleTiles: encode raw tiles in one pass, with Huffman tables from that many sampled tiles
+   void writeDng (const std::string outFilename, uint32 huffmanSampleTiles = 0);
    void writeTiff(const std::string outFilename);
    void writeJpeg(const std::string outFilename);
 
+   // Drops all data of the current file, the converter can then be re-used for the next one
+   void reset();
+
+   // Rough size of the working set (raw data plus all rendering stages) of the current file
+   uint64 memoryEstimate() const;
+
+   // Pixel count of the current file's raw image
+   uint64 rawPixels() const;
+
+   // Timing and counters of the current file, complete once its output has been written
+   const ConversionStats& stats() const {return m_stats;}
+
    static void registerPublisher(std::function<void(const char*)> function);
+   static void registerStatsListener(const StatsListener &listener);
+
+   // Allocator for all DNG SDK memory of converters created from now on (default: malloc)
+   static void setAllocator(dng_memory_allocator &allocator);
+
+   // Output file buffer size, whether writes bypass the page cache (O_DIRECT) and how many bytes
+   // a writer thread may lag behind the conversion (0: the converting threads write themselves)
+   static void setOutputFiles(uint32 bufferSize, bool directWrite, uint64 writeBehind = 0);
+
+   // Tile size of the raw image in DNG output (default: the DNG SDK's)
+   static void setTilePolicy(const TilePolicy &policy);
 
 private:
+   typedef std::chrono::steady_clock Clock;
+
+   static void initializeSDK();
+   static void terminateSDK();
+
+   void stageDone(const char *name, const Clock::time_point &start);
+   void conversionDone(const std::string &outFilename, uint64 bytesWritten);
+
+   TrackingAllocator m_allocator;
    AutoPtr<dng_host> m_host;
    AutoPtr<NegativeProcessor> m_negProcessor;
    AutoPtr<dng_preview_list> m_previewList;
@@ -54,5 +95,14 @@ private:
    dng_string m_appName, m_appVersion;
    dng_date_time_info m_dateTimeNow;
 
+   ConversionStats m_stats;
+   Clock::time_point m_startTime;
+
    static std::function<void(const char*)> m_publishFunction;
+   static StatsListener m_statsListener;
+   static dng_memory_allocator *m_baseAllocator;
+   static uint32 m_outputBufferSize;
+   static bool m_directWrite;
+   static uint64 m_writeBehind;
+   static TilePolicy m_tilePolicy;
 };
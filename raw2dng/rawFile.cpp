@@ -0,0 +1,84 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "rawFile.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+RawFile::RawFile(const std::string &filename) : m_path(filename), m_data(NULL), m_size(0), m_mapped(false) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::stringstream error; error << "Cannot open raw file: " << strerror(errno);
+        throw std::runtime_error(error.str());
+    }
+
+    struct stat fileStat;
+    if ((fstat(fd, &fileStat) != 0) || !S_ISREG(fileStat.st_mode) || (fileStat.st_size <= 0)) {
+        close(fd);
+        throw std::runtime_error("Raw file is empty or not a regular file");
+    }
+    m_size = static_cast<uint64>(fileStat.st_size);
+
+    // -----------------------------------------------------------------------------------------
+    // Map the file and have the kernel start reading all of it - we'll need every byte anyway.
+    // If mapping isn't possible (e.g., some network filesystems), fall back to reading it in
+
+    void *mapping = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+        madvise(mapping, m_size, MADV_WILLNEED);
+        m_data = static_cast<uint8*>(mapping);
+        m_mapped = true;
+        close(fd);
+        return;
+    }
+
+    m_data = static_cast<uint8*>(malloc(m_size));
+    if (m_data == NULL) {
+        close(fd);
+        throw std::runtime_error("Not enough memory to read raw file");
+    }
+
+    for (uint64 done = 0; done < m_size;) {
+        ssize_t bytes = read(fd, m_data + done, m_size - done);
+        if ((bytes < 0) && (errno == EINTR)) continue;
+        if (bytes <= 0) {
+            close(fd);
+            free(m_data);
+            throw std::runtime_error("Error reading raw file");
+        }
+        done += bytes;
+    }
+
+    close(fd);
+}
+
+
+RawFile::~RawFile() {
+    if (m_mapped) munmap(m_data, m_size);
+    else          free(m_data);
+}
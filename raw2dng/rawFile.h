@@ -0,0 +1,44 @@
+/* Copyright (C) 2026 Fimagena
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "dng_types.h"
+#include "dng_uncopyable.h"
+
+
+// Read-only view of a whole raw file. The file is opened once and memory-mapped (or read
+// into memory if it cannot be mapped); LibRaw, Exiv2, the DNG SDK and the raw embedder all
+// work on this one buffer, so every byte is fetched from storage only once.
+class RawFile : private dng_uncopyable {
+public:
+   explicit RawFile(const std::string &filename);
+   ~RawFile();
+
+   const std::string& path() const {return m_path;}
+   const uint8* data() const {return m_data;}
+   uint64 size() const {return m_size;}
+
+private:
+   std::string m_path;
+   uint8 *m_data;
+   uint64 m_size;
+   bool m_mapped;
+};
@@ -28,15 +28,16 @@
 #include <exiv2/image.hpp>
 
 
-DNGprocessor::DNGprocessor(AutoPtr<dng_host> &host, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage)
-                             : NegativeProcessor(host, rawProcessor, rawImage) {
+DNGprocessor::DNGprocessor(AutoPtr<dng_host> &host, RawFile *rawFile, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage)
+                             : NegativeProcessor(host, rawFile, rawProcessor, rawImage) {
     // -----------------------------------------------------------------------------------------
-    // Re-read source DNG using DNG SDK - we're ignoring the LibRaw/Exiv2 data structures from now on
+    // Re-read source DNG using DNG SDK - we're ignoring the LibRaw/Exiv2 data structures from now on.
+    // The SDK parses the already mapped file rather than opening it again
 
-    std::string file(m_RawImage->io().path());
+    if (m_RawFile->size() > 0xFFFFFFFF) throw dng_exception(dng_error_image_too_big_dng);
 
     try {
-        dng_file_stream stream(file.c_str());
+        dng_stream stream(m_RawFile->data(), static_cast<uint32>(m_RawFile->size()));
 
         dng_info info;
         info.Parse(*(m_host.Get()), stream);
@@ -58,7 +59,7 @@ void DNGprocessor::setDNGPropertiesFromRaw() {
     // -----------------------------------------------------------------------------------------
     // Raw filename
 
-    std::string file(m_RawImage->io().path());
+    std::string file(m_RawFile->path());
     size_t found = std::min(file.rfind("\\"), file.rfind("/"));
     if (found != std::string::npos) file = file.substr(found + 1, file.length() - found - 1);
     m_negative->SetOriginalRawFileName(file.c_str());
@@ -66,12 +67,8 @@ void DNGprocessor::setDNGPropertiesFromRaw() {
 
 
 void DNGprocessor::setCameraProfile(const char *dcpFilename) {
-    AutoPtr<dng_camera_profile> prof(new dng_camera_profile);
-
     if (strlen(dcpFilename) > 0) {
-        dng_file_stream profStream(dcpFilename);
-        if (!prof->ParseExtended(profStream))
-            throw std::runtime_error("Could not parse supplied camera profile file!");
+        AutoPtr<dng_camera_profile> prof(loadCameraProfile(dcpFilename));
         m_negative->AddProfile(prof);
     }
     else {
@@ -29,8 +29,8 @@
 
 // TODO/FIXME: Fuji support is currently broken!
 
-FujiProcessor::FujiProcessor(AutoPtr<dng_host> &host, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage)
-                           : NegativeProcessor(host, rawProcessor, rawImage) {
+FujiProcessor::FujiProcessor(AutoPtr<dng_host> &host, RawFile *rawFile, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage)
+                           : NegativeProcessor(host, rawFile, rawProcessor, rawImage) {
     m_fujiRotate90 = (2 == m_RawProcessor->COLOR(0, 1)) && (1 == m_RawProcessor->COLOR(1, 0));
 }
 
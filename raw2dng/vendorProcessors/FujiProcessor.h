@@ -31,7 +31,7 @@ public:
    void buildDNGImage();
 
 protected:
-   FujiProcessor(AutoPtr<dng_host> &host, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage);
+   FujiProcessor(AutoPtr<dng_host> &host, RawFile *rawFile, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage);
 
    bool m_fujiRotate90;
 };
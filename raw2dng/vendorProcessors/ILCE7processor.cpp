@@ -161,8 +161,8 @@ public:
 };
 
 
-ILCE7processor::ILCE7processor(AutoPtr<dng_host> &host, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage)
-                             : NegativeProcessor(host, rawProcessor, rawImage) {}
+ILCE7processor::ILCE7processor(AutoPtr<dng_host> &host, RawFile *rawFile, LibRaw *rawProcessor, Exiv2::Image::AutoPtr &rawImage)
+                             : NegativeProcessor(host, rawFile, rawProcessor, rawImage) {}
 
 
 void ILCE7processor::setDNGPropertiesFromRaw() {